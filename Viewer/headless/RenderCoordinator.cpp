@@ -0,0 +1,468 @@
+#include <chrono>
+#include <poll.h>
+#include <unistd.h>
+#include "RenderCoordinator.h"
+
+using namespace std;
+
+RenderCoordinator::RenderCoordinator(BatchScene& scene, int tileSize /*= -1*/, double unitTimeout /*= COORDINATOR_UNIT_TIMEOUT*/) :
+    m_scene(scene), m_tileSize(tileSize), m_unitTimeout(unitTimeout), m_stats()
+{
+    const BATCH_SETTINGS& settings = scene.GetSettings();
+
+    // Command line overrides of the coordinator are appended, later lines of a description win
+    string description = scene.GetDescription() + "\nsize " + to_string(settings.width) + " " + to_string(settings.height) +
+                                                   "\nframes " + to_string(settings.frames) + "\n";
+
+    m_scenePayload.PutString(description);
+    m_scenePayload.Put<uint32_t>((uint32_t)scene.GetMeshCache().size());
+    for (const auto& mesh : scene.GetMeshCache())
+    {
+        m_scenePayload.PutString(mesh.first);
+        m_scenePayload.PutString(mesh.second);
+    }
+}
+
+RETURN_CODE RenderCoordinator::AddWorker(NetChannel&& channel)
+{
+    WORKER worker;
+    worker.channel = move(channel);
+    worker.bReady  = false;
+    worker.bAlive  = true;
+
+    RETURN_CODE rc = worker.channel.Send(NM_SCENE, m_scenePayload);
+    if (rc != RC_SUCCESS)
+    {
+        return rc;
+    }
+
+    m_workers.push_back(move(worker));
+    return RC_SUCCESS;
+}
+
+void RenderCoordinator::splitWork()
+{
+    const BATCH_SETTINGS& settings   = m_scene.GetSettings();
+    unsigned              frameCount = (unsigned)m_scene.GetCameras().size() * settings.frames;
+    int                   tileSize   = m_tileSize;
+
+    if (tileSize < 0)
+    {
+        tileSize = (frameCount < m_workers.size() * COORDINATOR_PIPELINE_DEPTH) ? COORDINATOR_AUTO_TILE_SIZE : 0;
+    }
+    if (settings.postEffect != NONE)
+    {
+        tileSize = 0;
+    }
+
+    int tileWidth  = tileSize > 0 ? tileSize : settings.width;
+    int tileHeight = tileSize > 0 ? tileSize : settings.height;
+
+    m_units.clear();
+    m_frames.clear();
+    for (unsigned key = 0; key < frameCount; key++)
+    {
+        unsigned unitsBefore = (unsigned)m_units.size();
+        for (int y = 0; y < settings.height; y += tileHeight)
+        {
+            for (int x = 0; x < settings.width; x += tileWidth)
+            {
+                NET_WORK_UNIT unit = { (uint32_t)m_units.size(), key / settings.frames, key % settings.frames,
+                                       x, y, MIN(x + tileWidth, settings.width), MIN(y + tileHeight, settings.height) };
+                m_units.push_back(unit);
+            }
+        }
+        m_frames[key].missingUnits = (unsigned)m_units.size() - unitsBefore;
+    }
+    m_unitDone.assign(m_units.size(), false);
+
+    // Neighbouring units go to the same worker, it then mostly renders tiles of the same frame
+    vector<size_t> alive;
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        m_workers[i].queue.clear();
+        m_workers[i].inFlight.clear();
+        if (m_workers[i].bAlive)
+        {
+            alive.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < alive.size(); i++)
+    {
+        size_t first = m_units.size() * i / alive.size();
+        size_t last  = m_units.size() * (i + 1) / alive.size();
+        for (size_t unit = first; unit < last; unit++)
+        {
+            m_workers[alive[i]].queue.push_back((unsigned)unit);
+        }
+    }
+
+    m_stats       = COORDINATOR_STATS();
+    m_stats.units = (unsigned)m_units.size();
+}
+
+bool RenderCoordinator::nextUnit(size_t workerIdx, unsigned& unit)
+{
+    WORKER& worker = m_workers[workerIdx];
+    if (!worker.queue.empty())
+    {
+        unit = worker.queue.front();
+        worker.queue.pop_front();
+        return true;
+    }
+
+    // Steal from the far end of the longest queue, dead workers' queues included
+    WORKER* pVictim = nullptr;
+    for (WORKER& other : m_workers)
+    {
+        if (!other.queue.empty() && (pVictim == nullptr || other.queue.size() > pVictim->queue.size()))
+        {
+            pVictim = &other;
+        }
+    }
+    if (pVictim == nullptr)
+    {
+        return false;
+    }
+
+    unit = pVictim->queue.back();
+    pVictim->queue.pop_back();
+    m_stats.stolen++;
+    return true;
+}
+
+RETURN_CODE RenderCoordinator::feed(size_t workerIdx)
+{
+    WORKER&  worker = m_workers[workerIdx];
+    unsigned unit;
+
+    while (worker.bAlive && worker.bReady && worker.inFlight.size() < COORDINATOR_PIPELINE_DEPTH && nextUnit(workerIdx, unit))
+    {
+        NetPayload payload;
+        payload.Put(m_units[unit]);
+        if (worker.inFlight.empty())
+        {
+            // an idle worker's silence did not count, the wait for an answer starts now
+            worker.lastHeard = chrono::steady_clock::now();
+        }
+        worker.inFlight.push_back(unit);
+
+        if (worker.channel.Send(NM_WORK, payload) != RC_SUCCESS)
+        {
+            loseWorker(workerIdx);
+            return RC_IO_ERROR;
+        }
+    }
+    return RC_SUCCESS;
+}
+
+void RenderCoordinator::loseWorker(size_t workerIdx)
+{
+    WORKER& worker = m_workers[workerIdx];
+    if (!worker.bAlive)
+    {
+        return;
+    }
+
+    worker.bAlive = false;
+    worker.channel.Close();
+    m_stats.workersLost++;
+
+    // Its unanswered units go back first in line, the remaining workers steal them
+    while (!worker.inFlight.empty())
+    {
+        worker.queue.push_front(worker.inFlight.back());
+        worker.inFlight.pop_back();
+        m_stats.retried++;
+    }
+}
+
+RETURN_CODE RenderCoordinator::handleMessage(size_t workerIdx, const FRAME_SINK& sink)
+{
+    WORKER&      worker = m_workers[workerIdx];
+    NET_MSG_TYPE type;
+    NetPayload   payload;
+
+    if (worker.channel.Receive(type, payload) != RC_SUCCESS)
+    {
+        loseWorker(workerIdx);
+        return RC_SUCCESS;
+    }
+    worker.lastHeard = chrono::steady_clock::now();
+
+    if (type == NM_READY)
+    {
+        worker.bReady = true;
+        return feed(workerIdx);
+    }
+    if (type != NM_RESULT)
+    {
+        loseWorker(workerIdx);
+        return RC_SUCCESS;
+    }
+
+    NET_WORK_UNIT unit;
+    size_t        pixelBytes;
+    if (!payload.Get(unit) || unit.unit >= m_units.size())
+    {
+        loseWorker(workerIdx);
+        return RC_SUCCESS;
+    }
+    const char* pixels = payload.Remaining(pixelBytes);
+
+    for (auto it = worker.inFlight.begin(); it != worker.inFlight.end(); it++)
+    {
+        if (*it == unit.unit)
+        {
+            worker.inFlight.erase(it);
+            break;
+        }
+    }
+
+    const NET_WORK_UNIT& expected = m_units[unit.unit];
+    size_t rowBytes = static_cast<size_t>(expected.x1 - expected.x0) * 4;
+    if (pixelBytes != rowBytes * (expected.y1 - expected.y0))
+    {
+        loseWorker(workerIdx);
+        return RC_SUCCESS;
+    }
+
+    if (!m_unitDone[unit.unit])
+    {
+        const BATCH_SETTINGS& settings = m_scene.GetSettings();
+        unsigned              key      = expected.cameraIdx * settings.frames + expected.frame;
+        FRAME_ASSEMBLY&       frame    = m_frames[key];
+
+        m_unitDone[unit.unit] = true;
+        frame.pixels.resize(static_cast<size_t>(settings.width) * settings.height * 4);
+        for (int y = expected.y0; y < expected.y1; y++)
+        {
+            memcpy(&frame.pixels[(static_cast<size_t>(y) * settings.width + expected.x0) * 4], pixels + (y - expected.y0) * rowBytes, rowBytes);
+        }
+
+        if (--frame.missingUnits == 0)
+        {
+            RETURN_CODE rc = sink ? sink(expected.cameraIdx, expected.frame, frame.pixels) : RC_SUCCESS;
+            m_frames.erase(key);
+            if (rc != RC_SUCCESS)
+            {
+                return rc;
+            }
+        }
+    }
+
+    feed(workerIdx);
+    return RC_SUCCESS;
+}
+
+void RenderCoordinator::expireWorkers()
+{
+    auto now = chrono::steady_clock::now();
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        WORKER& worker = m_workers[i];
+        if (worker.bAlive && !worker.inFlight.empty() && chrono::duration<double>(now - worker.lastHeard).count() > m_unitTimeout)
+        {
+            fprintf(stderr, "render worker %zu did not answer for %.0f s, dropping it and retrying its units\n", i, m_unitTimeout);
+            m_stats.workersTimedOut++;
+            loseWorker(i);
+        }
+    }
+}
+
+RETURN_CODE RenderCoordinator::Render(const FRAME_SINK& sink)
+{
+    auto start = chrono::steady_clock::now();
+
+    splitWork();
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        feed(i);
+    }
+
+    size_t         remaining = m_units.size();
+    vector<pollfd> fds;
+    vector<size_t> fdWorkers;
+
+    while (remaining > 0)
+    {
+        fds.clear();
+        fdWorkers.clear();
+        for (size_t i = 0; i < m_workers.size(); i++)
+        {
+            if (m_workers[i].bAlive)
+            {
+                pollfd fd = { m_workers[i].channel.GetFd(), POLLIN, 0 };
+                fds.push_back(fd);
+                fdWorkers.push_back(i);
+            }
+        }
+        if (fds.empty())
+        {
+            fprintf(stderr, "all render workers are gone, %zu of %zu units left\n", remaining, m_units.size());
+            return RC_FAILURE;
+        }
+
+        // wake up regularly even when nobody answers, a hung worker would otherwise stall the render forever
+        int pollMs = static_cast<int>(MIN(m_unitTimeout * 1000.0 / 4, (double)COORDINATOR_POLL_MS));
+        if (poll(fds.data(), fds.size(), MAX(pollMs, 1)) < 0)
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < fds.size(); i++)
+        {
+            if (fds[i].revents == 0)
+            {
+                continue;
+            }
+            RETURN_CODE rc = handleMessage(fdWorkers[i], sink);
+            if (rc != RC_SUCCESS && rc != RC_IO_ERROR)
+            {
+                return rc;
+            }
+        }
+
+        expireWorkers();
+
+        // Workers without work may steal the retried units of a lost one
+        for (size_t i = 0; i < m_workers.size(); i++)
+        {
+            feed(i);
+        }
+
+        remaining = 0;
+        for (bool bDone : m_unitDone)
+        {
+            remaining += bDone ? 0 : 1;
+        }
+    }
+
+    m_stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return RC_SUCCESS;
+}
+
+void RenderCoordinator::Shutdown()
+{
+    NetPayload empty;
+    for (WORKER& worker : m_workers)
+    {
+        if (worker.bAlive)
+        {
+            worker.channel.Send(NM_QUIT, empty);
+            worker.channel.Close();
+            worker.bAlive = false;
+        }
+    }
+    m_workers.clear();
+}
+
+uint64_t RenderCoordinator::Checksum(const std::vector<unsigned char>& pixels)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char byte : pixels)
+    {
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+    return hash;
+}
+
+int RenderCoordinator::SpawnLocalWorker(const std::string& executable, const std::string& address, unsigned failAfter /*= 0*/,
+                                        bool bHang /*= false*/)
+{
+    string failAfterArg = to_string(failAfter);
+    string failOption   = bHang ? "--hang-after" : "--fail-after";
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        execl(executable.c_str(), executable.c_str(), "--worker", address.c_str(), failOption.c_str(), failAfterArg.c_str(), (char*)nullptr);
+        _exit(RC_FAILURE);
+    }
+    return (int)pid;
+}
+
+//////////////////// RenderWorker ////////////////////////
+
+RETURN_CODE RenderWorker::Run(const std::string& address, unsigned failAfter /*= 0*/, bool bHang /*= false*/)
+{
+    NetChannel   channel;
+    NET_MSG_TYPE type;
+    NetPayload   payload;
+
+    RETURN_CODE rc = channel.Connect(address);
+    if (rc != RC_SUCCESS)
+    {
+        return rc;
+    }
+
+    rc = channel.Receive(type, payload);
+    if (rc != RC_SUCCESS || type != NM_SCENE)
+    {
+        return RC_IO_ERROR;
+    }
+
+    BatchScene scene;
+    string     description;
+    uint32_t   meshCount = 0;
+
+    payload.GetString(description);
+    payload.Get(meshCount);
+    for (uint32_t i = 0; i < meshCount; i++)
+    {
+        string path, objData;
+        if (!payload.GetString(path) || !payload.GetString(objData))
+        {
+            return RC_FAILURE;
+        }
+        scene.AddMesh(path, objData);
+    }
+
+    rc = scene.LoadFromMemory(description, "coordinator scene");
+    if (rc != RC_SUCCESS)
+    {
+        return rc;
+    }
+
+    const BATCH_SETTINGS& settings = scene.GetSettings();
+    BatchRenderer         renderer(settings);
+    unsigned              unitsDone = 0;
+
+    rc = channel.Send(NM_READY, NetPayload());
+    while (rc == RC_SUCCESS && channel.Receive(type, payload) == RC_SUCCESS && type == NM_WORK)
+    {
+        NET_WORK_UNIT unit;
+        if (!payload.Get(unit))
+        {
+            return RC_FAILURE;
+        }
+
+        if (failAfter != 0 && unitsDone == failAfter)
+        {
+            // simulated hang: swallow work until the coordinator gives up on us and disconnects
+            while (bHang && channel.Receive(type, payload) == RC_SUCCESS)
+            {
+            }
+            // simulated crash, the coordinator has to hand this unit to someone else
+            return RC_FAILURE;
+        }
+
+        NetPayload result;
+        result.Put(unit);
+        if (unit.x0 == 0 && unit.y0 == 0 && unit.x1 == settings.width && unit.y1 == settings.height)
+        {
+            renderer.RenderFrame(scene, unit.cameraIdx, unit.frame);
+            result.PutBytes(renderer.GetPixels().data(), renderer.GetPixels().size());
+        }
+        else
+        {
+            renderer.RenderTile(scene, unit.cameraIdx, unit.frame, unit.x0, unit.y0, unit.x1, unit.y1);
+            result.PutBytes(renderer.GetTilePixels().data(), renderer.GetTilePixels().size());
+        }
+
+        rc = channel.Send(NM_RESULT, result);
+        unitsDone++;
+    }
+
+    return rc;
+}
@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "RenderNet.h"
+
+using namespace std;
+
+#ifdef MSG_NOSIGNAL
+#define NET_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define NET_SEND_FLAGS 0
+#endif
+
+static bool sendAll(int fd, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0)
+    {
+        ssize_t sent = send(fd, bytes, size, NET_SEND_FLAGS);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            return false;
+        }
+        bytes += sent;
+        size  -= static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+static bool recvAll(int fd, void* data, size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    while (size > 0)
+    {
+        ssize_t received = recv(fd, bytes, size, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        bytes += received;
+        size  -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+// Splits "unix:/path" and "tcp:host:port" into a socket address
+static bool parseAddress(const std::string& address, sockaddr_storage& storage, socklen_t& length, string& unixPath)
+{
+    memset(&storage, 0, sizeof(storage));
+    unixPath.clear();
+
+    if (address.compare(0, 5, "unix:") == 0)
+    {
+        sockaddr_un* un = reinterpret_cast<sockaddr_un*>(&storage);
+        unixPath = address.substr(5);
+        if (unixPath.empty() || unixPath.size() >= sizeof(un->sun_path))
+        {
+            return false;
+        }
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, unixPath.c_str(), unixPath.size() + 1);
+        length = sizeof(sockaddr_un);
+        return true;
+    }
+
+    if (address.compare(0, 4, "tcp:") == 0)
+    {
+        sockaddr_in* in    = reinterpret_cast<sockaddr_in*>(&storage);
+        size_t       colon = address.rfind(':');
+        if (colon <= 4)
+        {
+            return false;
+        }
+        string host = address.substr(4, colon - 4);
+        in->sin_family = AF_INET;
+        in->sin_port   = htons(static_cast<uint16_t>(atoi(address.c_str() + colon + 1)));
+        if (inet_pton(AF_INET, host.c_str(), &in->sin_addr) != 1)
+        {
+            return false;
+        }
+        length = sizeof(sockaddr_in);
+        return true;
+    }
+
+    return false;
+}
+
+//////////////////// NetChannel ////////////////////////
+
+NetChannel& NetChannel::operator=(NetChannel&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_fd = other.m_fd;
+        other.m_fd = -1;
+    }
+    return *this;
+}
+
+RETURN_CODE NetChannel::Connect(const std::string& address)
+{
+    sockaddr_storage storage;
+    socklen_t        length;
+    string           unixPath;
+
+    Close();
+    if (!parseAddress(address, storage, length, unixPath))
+    {
+        fprintf(stderr, "bad address %s\n", address.c_str());
+        return RC_FAILURE;
+    }
+
+    m_fd = socket(storage.ss_family, SOCK_STREAM, 0);
+    if (m_fd < 0 || connect(m_fd, reinterpret_cast<sockaddr*>(&storage), length) != 0)
+    {
+        fprintf(stderr, "connecting to %s failed: %s\n", address.c_str(), strerror(errno));
+        Close();
+        return RC_IO_ERROR;
+    }
+
+    if (storage.ss_family == AF_INET)
+    {
+        // work units are small and latency bound
+        int noDelay = 1;
+        setsockopt(m_fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    }
+    return RC_SUCCESS;
+}
+
+RETURN_CODE NetChannel::Send(NET_MSG_TYPE type, const NetPayload& payload)
+{
+    NET_MSG_HEADER header = { static_cast<uint32_t>(type), 0, payload.Data().size() };
+
+    if (header.size > NET_MAX_PAYLOAD_SIZE)
+    {
+        fprintf(stderr, "message of %llu bytes exceeds the %llu byte limit\n", (unsigned long long)header.size, NET_MAX_PAYLOAD_SIZE);
+        return RC_IO_ERROR;
+    }
+    if (!IsOpen() || !sendAll(m_fd, &header, sizeof(header)) || !sendAll(m_fd, payload.Data().data(), payload.Data().size()))
+    {
+        return RC_IO_ERROR;
+    }
+    return RC_SUCCESS;
+}
+
+RETURN_CODE NetChannel::Receive(NET_MSG_TYPE& type, NetPayload& payload)
+{
+    NET_MSG_HEADER header;
+
+    payload.Clear();
+    if (!IsOpen() || !recvAll(m_fd, &header, sizeof(header)))
+    {
+        return RC_IO_ERROR;
+    }
+
+    if (header.size > NET_MAX_PAYLOAD_SIZE)
+    {
+        fprintf(stderr, "peer announced a %llu byte message, the limit is %llu\n", (unsigned long long)header.size, NET_MAX_PAYLOAD_SIZE);
+        Close();
+        return RC_IO_ERROR;
+    }
+    payload.Data().resize(static_cast<size_t>(header.size));
+    if (!recvAll(m_fd, payload.Data().data(), payload.Data().size()))
+    {
+        return RC_IO_ERROR;
+    }
+
+    type = static_cast<NET_MSG_TYPE>(header.type);
+    return RC_SUCCESS;
+}
+
+void NetChannel::Close()
+{
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+        m_fd = -1;
+    }
+}
+
+//////////////////// NetListener ////////////////////////
+
+NetListener::~NetListener()
+{
+    if (m_fd >= 0)
+    {
+        close(m_fd);
+    }
+    if (!m_unixPath.empty())
+    {
+        unlink(m_unixPath.c_str());
+    }
+}
+
+RETURN_CODE NetListener::Listen(const std::string& address)
+{
+    sockaddr_storage storage;
+    socklen_t        length;
+
+    if (!parseAddress(address, storage, length, m_unixPath))
+    {
+        fprintf(stderr, "bad address %s\n", address.c_str());
+        return RC_FAILURE;
+    }
+
+    if (!m_unixPath.empty())
+    {
+        // a socket file left behind by an earlier run
+        unlink(m_unixPath.c_str());
+    }
+
+    m_fd = socket(storage.ss_family, SOCK_STREAM, 0);
+    if (m_fd < 0)
+    {
+        return RC_IO_ERROR;
+    }
+
+    int reuse = 1;
+    setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    if (bind(m_fd, reinterpret_cast<sockaddr*>(&storage), length) != 0 || listen(m_fd, SOMAXCONN) != 0)
+    {
+        fprintf(stderr, "listening on %s failed: %s\n", address.c_str(), strerror(errno));
+        return RC_IO_ERROR;
+    }
+
+    m_address = address;
+    if (storage.ss_family == AF_INET)
+    {
+        sockaddr_in bound;
+        socklen_t   boundLength = sizeof(bound);
+        char        host[INET_ADDRSTRLEN];
+        getsockname(m_fd, reinterpret_cast<sockaddr*>(&bound), &boundLength);
+        inet_ntop(AF_INET, &bound.sin_addr, host, sizeof(host));
+        m_address = string("tcp:") + host + ":" + to_string(ntohs(bound.sin_port));
+    }
+    return RC_SUCCESS;
+}
+
+RETURN_CODE NetListener::Accept(NetChannel& channel)
+{
+    int fd;
+    do
+    {
+        fd = accept(m_fd, nullptr, nullptr);
+    } while (fd < 0 && errno == EINTR);
+
+    if (fd < 0)
+    {
+        return RC_IO_ERROR;
+    }
+
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+    channel = NetChannel(fd);
+    return RC_SUCCESS;
+}
@@ -0,0 +1,456 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "RenderServer.h"
+
+using namespace std;
+
+//////////////////// SharedFrameRing ////////////////////////
+
+RETURN_CODE SharedFrameRing::Create(const std::string& name, unsigned slotCount, unsigned width, unsigned height)
+{
+    size_t page       = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t frameBytes = static_cast<size_t>(width) * height * 4;
+    size_t stride     = (frameBytes + page - 1) / page * page;
+
+    Close();
+    // a ring left behind by a server that was killed
+    shm_unlink(name.c_str());
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0)
+    {
+        fprintf(stderr, "creating shared memory %s failed: %s\n", name.c_str(), strerror(errno));
+        return RC_IO_ERROR;
+    }
+
+    m_size  = page + stride * slotCount;
+    m_pBase = (ftruncate(fd, static_cast<off_t>(m_size)) == 0) ?
+              static_cast<unsigned char*>(mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) : nullptr;
+    close(fd);
+
+    m_name   = name;
+    m_bOwner = true;
+    if (m_pBase == nullptr || m_pBase == MAP_FAILED)
+    {
+        m_pBase = nullptr;
+        Close();
+        return RC_IO_ERROR;
+    }
+
+    FRAME_RING_HEADER* pHeader = reinterpret_cast<FRAME_RING_HEADER*>(m_pBase);
+    pHeader->magic      = SERVER_RING_MAGIC;
+    pHeader->slotCount  = slotCount;
+    pHeader->width      = width;
+    pHeader->height     = height;
+    pHeader->slotOffset = page;
+    pHeader->slotStride = stride;
+    return RC_SUCCESS;
+}
+
+RETURN_CODE SharedFrameRing::Open(const std::string& name)
+{
+    struct stat info;
+
+    Close();
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0 || fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(FRAME_RING_HEADER))
+    {
+        fprintf(stderr, "opening shared memory %s failed\n", name.c_str());
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return RC_IO_ERROR;
+    }
+
+    m_size  = static_cast<size_t>(info.st_size);
+    void* pBase = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (pBase == MAP_FAILED)
+    {
+        return RC_IO_ERROR;
+    }
+
+    m_pBase = static_cast<unsigned char*>(pBase);
+    m_name  = name;
+    if (GetHeader().magic != SERVER_RING_MAGIC || GetHeader().slotOffset + GetHeader().slotStride * GetHeader().slotCount > m_size)
+    {
+        Close();
+        return RC_FAILURE;
+    }
+    return RC_SUCCESS;
+}
+
+void SharedFrameRing::Close()
+{
+    if (m_pBase != nullptr)
+    {
+        munmap(m_pBase, m_size);
+        m_pBase = nullptr;
+    }
+    if (m_bOwner)
+    {
+        shm_unlink(m_name.c_str());
+        m_bOwner = false;
+    }
+    m_name.clear();
+    m_size = 0;
+}
+
+//////////////////// RenderServer ////////////////////////
+
+RenderServer::RenderServer(BatchScene& scene, unsigned threads /*= 0*/) : m_scene(scene), m_pool(threads), m_inFlight(0), m_bQuit(false)
+{
+    for (unsigned i = 0; i < m_pool.GetThreadCount(); i++)
+    {
+        m_renderers.emplace_back(new BatchRenderer(scene.GetSettings()));
+    }
+    m_wakeFds[0] = m_wakeFds[1] = -1;
+}
+
+RenderServer::~RenderServer()
+{
+    m_pool.Wait();
+    for (int fd : m_wakeFds)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+}
+
+RETURN_CODE RenderServer::Run(const std::string& address)
+{
+    const BATCH_SETTINGS& settings = m_scene.GetSettings();
+    // enough slots to keep every thread busy while the client still holds a few frames
+    unsigned slotCount = MAX(SERVER_RING_SLOTS, 2 * m_pool.GetThreadCount());
+
+    RETURN_CODE rc = m_ring.Create("/meshviewer-" + to_string(getpid()) + "-frames", slotCount, settings.width, settings.height);
+    if (rc != RC_SUCCESS)
+    {
+        return rc;
+    }
+    if (pipe(m_wakeFds) != 0)
+    {
+        return RC_IO_ERROR;
+    }
+    reclaimSlots();
+
+    NetListener listener;
+    rc = listener.Listen(address);
+    if (rc != RC_SUCCESS)
+    {
+        return rc;
+    }
+    fprintf(stdout, "serving %dx%d frames on %s, %u threads, %u ring slots\n", settings.width, settings.height,
+        listener.GetAddress().c_str(), m_pool.GetThreadCount(), slotCount);
+    fflush(stdout);
+
+    m_bQuit = false;
+    while (!m_bQuit)
+    {
+        NetChannel client;
+        if (listener.Accept(client) != RC_SUCCESS)
+        {
+            return RC_IO_ERROR;
+        }
+        serveClient(client);
+    }
+    return RC_SUCCESS;
+}
+
+RETURN_CODE RenderServer::serveClient(NetChannel& client)
+{
+    NetPayload hello;
+    hello.PutString(m_ring.GetName());
+    if (client.Send(NM_HELLO, hello) != RC_SUCCESS)
+    {
+        return RC_IO_ERROR;
+    }
+    m_pending.clear();
+
+    RETURN_CODE rc = RC_SUCCESS;
+    while (rc == RC_SUCCESS && !m_bQuit)
+    {
+        pollfd fds[2] = { { client.GetFd(), POLLIN, 0 }, { m_wakeFds[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0)
+        {
+            rc = (errno == EINTR) ? RC_SUCCESS : RC_IO_ERROR;
+            continue;
+        }
+
+        if (fds[1].revents != 0)
+        {
+            char wakeBytes[64];
+            if (read(m_wakeFds[0], wakeBytes, sizeof(wakeBytes)) < 0)
+            {
+                rc = RC_IO_ERROR;
+                continue;
+            }
+            rc = sendFinished(client);
+        }
+
+        if (rc == RC_SUCCESS && fds[0].revents != 0)
+        {
+            NET_MSG_TYPE    type;
+            NetPayload      payload;
+            PENDING_REQUEST request;
+            uint32_t        slot;
+
+            // a client that disconnects ends the session
+            rc = client.Receive(type, payload);
+            if (rc != RC_SUCCESS)
+            {
+                continue;
+            }
+
+            request.type = type;
+            if      (type == NM_QUIT)                                            m_bQuit = true;
+            else if (type == NM_COMMAND && payload.GetString(request.command))   m_pending.push_back(request);
+            else if (type == NM_RENDER  && payload.Get(request.render))          m_pending.push_back(request);
+            else if (type == NM_RELEASE && payload.Get(slot))                    releaseSlot(slot);
+            else rc = RC_FAILURE;
+        }
+
+        if (rc == RC_SUCCESS)
+        {
+            rc = dispatch(client);
+        }
+    }
+
+    // nothing may still write the ring when the next client gets all slots
+    m_pool.Wait();
+    m_inFlight = 0;
+    m_done.clear();
+    reclaimSlots();
+    return rc;
+}
+
+void RenderServer::releaseSlot(uint32_t slot)
+{
+    // a double release would put the slot into the free list twice and two renders would share it
+    if (slot >= m_slotHeld.size() || !m_slotHeld[slot])
+    {
+        fprintf(stderr, "client released slot %u, which it does not hold\n", slot);
+        return;
+    }
+    m_slotHeld[slot] = false;
+    m_freeSlots.push_back(slot);
+}
+
+void RenderServer::reclaimSlots()
+{
+    m_freeSlots.clear();
+    for (unsigned slot = m_ring.GetHeader().slotCount; slot > 0; slot--)
+    {
+        m_freeSlots.push_back(slot - 1);
+    }
+    m_slotHeld.assign(m_ring.GetHeader().slotCount, false);
+}
+
+RETURN_CODE RenderServer::dispatch(NetChannel& client)
+{
+    while (!m_pending.empty())
+    {
+        PENDING_REQUEST& request = m_pending.front();
+
+        if (request.type == NM_COMMAND)
+        {
+            // the renders sent before the command have to see the scene as it was
+            if (m_inFlight > 0)
+            {
+                break;
+            }
+
+            istringstream issLine(request.command);
+            string        lineType;
+            issLine >> lineType;
+
+            RETURN_CODE rc = (lineType == "size") ? RC_FAILURE : m_scene.ApplyLine(request.command);
+            for (unique_ptr<BatchRenderer>& renderer : m_renderers)
+            {
+                renderer->ApplySettings(m_scene.GetSettings());
+            }
+
+            NetPayload payload;
+            payload.Put<uint32_t>(rc);
+            if (client.Send(NM_COMMAND_DONE, payload) != RC_SUCCESS)
+            {
+                return RC_IO_ERROR;
+            }
+        }
+        else if (request.render.cameraIdx >= m_scene.GetCameras().size())
+        {
+            SERVER_FRAME frame = { request.render.requestId, SERVER_NO_SLOT, RC_FAILURE };
+            NetPayload   payload;
+            payload.Put(frame);
+            if (client.Send(NM_FRAME, payload) != RC_SUCCESS)
+            {
+                return RC_IO_ERROR;
+            }
+        }
+        else
+        {
+            // the client has to release a slot first
+            if (m_freeSlots.empty())
+            {
+                break;
+            }
+
+            unsigned              slot   = m_freeSlots.back();
+            SERVER_RENDER_REQUEST render = request.render;
+            m_freeSlots.pop_back();
+            m_inFlight++;
+
+            m_pool.Submit([this, render, slot](unsigned workerIdx)
+            {
+                m_renderers[workerIdx]->RenderFrame(m_scene, render.cameraIdx, render.frame, m_ring.GetSlot(slot));
+
+                SERVER_FRAME frame = { render.requestId, slot, RC_SUCCESS };
+                {
+                    lock_guard<mutex> lock(m_doneMutex);
+                    m_done.push_back(frame);
+                }
+                char wakeByte = 0;
+                ssize_t written = write(m_wakeFds[1], &wakeByte, 1);
+                (void)written;
+            });
+        }
+
+        m_pending.pop_front();
+    }
+    return RC_SUCCESS;
+}
+
+RETURN_CODE RenderServer::sendFinished(NetChannel& client)
+{
+    vector<SERVER_FRAME> done;
+    {
+        lock_guard<mutex> lock(m_doneMutex);
+        done.swap(m_done);
+    }
+
+    for (const SERVER_FRAME& frame : done)
+    {
+        NetPayload payload;
+        payload.Put(frame);
+        m_inFlight--;
+        if (frame.slot != SERVER_NO_SLOT)
+        {
+            m_slotHeld[frame.slot] = true;
+        }
+        if (client.Send(NM_FRAME, payload) != RC_SUCCESS)
+        {
+            return RC_IO_ERROR;
+        }
+    }
+    return RC_SUCCESS;
+}
+
+//////////////////// RenderServerClient ////////////////////////
+
+RETURN_CODE RenderServerClient::Connect(const std::string& address)
+{
+    NET_MSG_TYPE type;
+    NetPayload   payload;
+    string       ringName;
+
+    RETURN_CODE rc = m_channel.Connect(address);
+    if (rc != RC_SUCCESS)
+    {
+        return rc;
+    }
+    if (m_channel.Receive(type, payload) != RC_SUCCESS || type != NM_HELLO || !payload.GetString(ringName))
+    {
+        return RC_IO_ERROR;
+    }
+    return m_ring.Open(ringName);
+}
+
+RETURN_CODE RenderServerClient::Command(const std::string& line)
+{
+    NET_MSG_TYPE type;
+    NetPayload   payload;
+
+    payload.PutString(line);
+    if (m_channel.Send(NM_COMMAND, payload) != RC_SUCCESS)
+    {
+        return RC_IO_ERROR;
+    }
+
+    while (m_channel.Receive(type, payload) == RC_SUCCESS)
+    {
+        SERVER_FRAME frame;
+        uint32_t     rc;
+
+        if (type == NM_FRAME && payload.Get(frame))
+        {
+            m_frames.push_back(frame);
+        }
+        else if (type == NM_COMMAND_DONE && payload.Get(rc))
+        {
+            return static_cast<RETURN_CODE>(rc);
+        }
+        else
+        {
+            break;
+        }
+    }
+    return RC_IO_ERROR;
+}
+
+RETURN_CODE RenderServerClient::RequestFrame(unsigned cameraIdx, unsigned frame, uint32_t& requestId)
+{
+    SERVER_RENDER_REQUEST request = { m_nextRequestId++, cameraIdx, frame };
+    NetPayload            payload;
+
+    requestId = request.requestId;
+    payload.Put(request);
+    return m_channel.Send(NM_RENDER, payload);
+}
+
+RETURN_CODE RenderServerClient::WaitFrame(SERVER_FRAME& frame)
+{
+    NET_MSG_TYPE type;
+    NetPayload   payload;
+
+    if (!m_frames.empty())
+    {
+        frame = m_frames.front();
+        m_frames.pop_front();
+        return RC_SUCCESS;
+    }
+
+    if (m_channel.Receive(type, payload) != RC_SUCCESS || type != NM_FRAME || !payload.Get(frame))
+    {
+        return RC_IO_ERROR;
+    }
+    return RC_SUCCESS;
+}
+
+RETURN_CODE RenderServerClient::Release(unsigned slot)
+{
+    NetPayload payload;
+    payload.Put<uint32_t>(slot);
+    return m_channel.Send(NM_RELEASE, payload);
+}
+
+RETURN_CODE RenderServerClient::Quit()
+{
+    NetPayload payload;
+    RETURN_CODE rc = m_channel.Send(NM_QUIT, payload);
+    m_channel.Close();
+    return rc;
+}
+
+void RenderServerClient::Disconnect()
+{
+    m_channel.Close();
+    m_ring.Close();
+    m_frames.clear();
+}
@@ -0,0 +1,1482 @@
+// Headless batch renderer. Renders a scene description with the software renderer and writes PNG frames,
+// no window, GL context or imgui involved, so it runs on machines without a GPU or display.
+//
+// usage: MeshViewerHeadless <scene file> [-w width] [-h height] [-n frames] [-o output prefix] [-j threads]
+//        Frames and cameras are rendered in parallel, -j 0 (default) uses every hardware thread. More threads than
+//        hardware threads only interleave the frames, they do not render any faster.
+//        See BatchRenderer.h for the scene description format.
+//        [--video <file>|-] [--video-format y4m|rgb] [--fps n]
+//            Streams the frames as Y4M or raw rgb24 to a file or stdout instead of writing PNGs, e.g.
+//            MeshViewerHeadless scene.txt --video - | ffmpeg -i - out.mp4
+//        [--format png|pngfast|qoi]
+//            Image format of the frames, overrides the one of the 'output' line.
+//        --bench-image <repeats> [-j threads]
+//            Renders the first frame and compares PNG, fast PNG and QOI encode/decode speed, checking the round trips.
+//            The fast PNG encode uses -j threads.
+//        --bench-framebuffer <frames>
+//            Renders the first camera with every color/depth target format, e.g. at -w 3840 -h 2160, and compares
+//            the target memory, the post effect traffic, the time of each stage and the largest channel difference
+//            to the float targets.
+//        MeshViewerHeadless --bench-decode <directory or png> [repeats]
+//            Decodes every PNG of the directory to RGBA8 like the texture loader does and reports the throughput
+//            per file, with a checksum of the pixels to compare decoder versions with.
+//        MeshViewerHeadless --test-decode [images]
+//            Encodes that many generated images (default 200) in every color type and bit depth, with every filter,
+//            deflate block type and interlacing, plus one through encodeFast, and decodes them again. Fails unless
+//            each decodes to exactly the pixels it was encoded from.
+//        MeshViewerHeadless --bench-normals <triangles> [repeats]
+//            Generates smooth normals for a sphere of about that many triangles on 1 thread up to every hardware
+//            thread, and checks that every thread count gives the same normals.
+//        MeshViewerHeadless --bench-import <directory or obj> [frames]
+//            Loads every obj file as is and with the import pass (see MeshOptimizer.h), and compares the
+//            vertex and triangle counts, the memory of the mesh and the raster time of a turntable. The memory of
+//            the levels of detail the pass adds is listed apart, the turntable renders the full meshes.
+//        MeshViewerHeadless --bench-lod <obj> [error pixels] [frames]
+//            Renders the model from further and further away in full and with the levels of detail of the given
+//            error (default MESH_LOD_ERROR_PIXELS), and compares the triangles drawn and the raster time.
+//        MeshViewerHeadless --bench-progressive <obj>
+//            Times the voxel preview of a progressive load (see AsyncMeshLoader.h) against parsing the whole file.
+//        MeshViewerHeadless --test-simplify [triangles]
+//            Simplifies a closed sphere of about that many triangles (default 100000) level by level like the
+//            levels of detail are built. Fails if a level misses its triangle target or is no longer closed.
+//        MeshViewerHeadless --test-arena [resizes]
+//            Sizes the renderer to 4K, then resizes it randomly and switches target formats that many times
+//            (default 2000), rendering and reading back each size. Fails if the frame arena's block moves or grows.
+//        MeshViewerHeadless --bench-vertex-format <directory or obj>
+//            Builds the GPU buffers of every obj file, levels of detail included, and compares their size with the
+//            float layout; checks the largest position and normal error of the quantized vertices (see VertexCodec.h).
+//
+// Distributed rendering (POSIX builds):
+//        MeshViewerHeadless <scene file> ... --distribute <workers> [--listen <address>] [--tile <size>] [--unit-timeout <seconds>]
+//            Renders on worker processes. Without --listen the workers are started locally on a Unix socket,
+//            with it the coordinator waits for that many workers to connect to the address, e.g. tcp:0.0.0.0:7000.
+//            A worker that does not answer for --unit-timeout seconds (default COORDINATOR_UNIT_TIMEOUT) is dropped.
+//        MeshViewerHeadless --worker <address> [--fail-after <units> | --hang-after <units>]
+//            Runs a worker for the coordinator at address.
+//        MeshViewerHeadless <scene file> ... --bench-distributed <max workers> [--transport unix|tcp] [--tile <size>]
+//                                            [--fail-after <units> | --hang-after <units>] [--unit-timeout <seconds>]
+//            Renders the scene in this process, then with 1 to max local workers, and compares the frame checksums.
+//            --fail-after makes the first worker of every multi-worker run die after that many units,
+//            --hang-after makes it stop answering instead.
+//
+// Render server (POSIX builds):
+//        MeshViewerHeadless <scene file> ... --serve <address> [-j threads]
+//            Loads the scene and takes edit and render requests from clients, see RenderServer.h.
+//        MeshViewerHeadless <scene file> ... --bench-server <frames> [-j threads]
+//            Starts a server on the scene and renders frames through it, one at a time and pipelined.
+//        MeshViewerHeadless --test-server
+//            Starts a server on an empty scene and checks the ring slot bookkeeping: a double release or the release
+//            of a slot that was never handed out must not let two frames share a slot, and the slots a client holds
+//            when it disconnects must be free for the next client.
+
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <random>
+#include <thread>
+#include "BatchRenderer.h"
+#include "VideoSink.h"
+#include "QoiImage.h"
+#include "MeshNormals.h"
+#include "MeshSimplifier.h"
+#include "VertexCodec.h"
+#include "lodepng_util.h"
+#include "Defs.h"
+#ifdef DISTRIBUTED_RENDERING
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "RenderCoordinator.h"
+#include "RenderServer.h"
+#endif
+
+#define PATH_TO_PROGRAM	   1
+#define PATH_TO_SCENE      1 + PATH_TO_PROGRAM
+
+typedef struct _HEADLESS_OPTIONS
+{
+	unsigned     threads;
+	unsigned     distributedWorkers;
+	unsigned     benchWorkers;
+	std::string  listenAddress;
+	std::string  transport;
+	int          tileSize;
+	unsigned     failAfter;
+	bool         bHang;           // the failing worker hangs instead of exiting
+	double       unitTimeout;     // 0 keeps COORDINATOR_UNIT_TIMEOUT
+	std::string  serveAddress;
+	unsigned     benchServerFrames;
+	std::string  videoPath;
+	VIDEO_FORMAT videoFormat;
+	unsigned     fps;
+	unsigned     benchImageRepeats;
+	unsigned     benchFrameBufferFrames;
+}HEADLESS_OPTIONS, *PHEADLESS_OPTIONS;
+
+// Process cmdline args, values given here override the ones of the scene description
+RETURN_CODE processCmdLineOptions(BATCH_SETTINGS& settings, HEADLESS_OPTIONS& options, int argCount, char **argVec);
+// Prints frames per second and the average time of each rendering stage
+void PrintTimings(FILE* out, const STAGE_TIMINGS& timings, double wallSeconds, unsigned threads);
+// PNG vs. QOI encode and decode MB/s on a rendered frame
+RETURN_CODE BenchmarkImageFormats(BatchScene& scene, unsigned repeats, unsigned threads);
+// Target memory and stage times of the software renderer per frame buffer format
+RETURN_CODE BenchmarkFrameBufferFormats(BatchScene& scene, unsigned frames);
+// Decode speed of the PNGs in a directory
+RETURN_CODE BenchmarkPngDecode(const char* path, unsigned repeats);
+// PNGs of every color type, filter and block type must decode to exactly the pixels they were encoded from
+RETURN_CODE TestPngDecode(unsigned images);
+// Smooth normal generation speed per thread count
+RETURN_CODE BenchmarkNormals(size_t triangleCount, unsigned repeats);
+// Mesh memory and raster time without and with the import pass
+RETURN_CODE BenchmarkImport(const char* path, unsigned frames);
+// Triangles and raster time over the camera distance, full meshes vs. levels of detail
+RETURN_CODE BenchmarkLod(const char* path, float errorPixels, unsigned frames);
+// Time to the preview of a progressive load vs. time to the full mesh
+RETURN_CODE BenchmarkProgressive(const char* path);
+// GPU buffer size and round trip error of the quantized vertices vs. floats
+RETURN_CODE BenchmarkVertexFormat(const char* path);
+// Every level simplified from a closed mesh must hit its triangle target and stay closed
+RETURN_CODE TestSimplify(size_t triangleCount);
+// Random resizes below 4K must reuse the render target memory of the first 4K frame
+RETURN_CODE TestFrameArena(unsigned resizes);
+#ifdef DISTRIBUTED_RENDERING
+// Renders on worker processes and writes the frames
+RETURN_CODE RenderDistributed(BatchScene& scene, const HEADLESS_OPTIONS& options, const char* executable);
+// Single process render vs. distributed renders with 1 to options.benchWorkers workers
+RETURN_CODE BenchmarkDistributed(BatchScene& scene, const HEADLESS_OPTIONS& options, const char* executable);
+// Frames/sec through a render server, waiting for every frame vs. keeping the ring full
+RETURN_CODE BenchmarkServer(BatchScene& scene, const HEADLESS_OPTIONS& options);
+// Bad releases and disconnects must not corrupt the server's ring slot bookkeeping
+RETURN_CODE TestRenderServer();
+#endif
+
+int main(int argc, char **argv)
+{
+#ifdef DISTRIBUTED_RENDERING
+	if (argc >= 3 && !strcmp(argv[1], "--worker"))
+	{
+		bool     bHang     = argc >= 5 && !strcmp(argv[3], "--hang-after");
+		unsigned failAfter = (argc >= 5 && (bHang || !strcmp(argv[3], "--fail-after"))) ? (unsigned)atoi(argv[4]) : 0;
+		return RenderWorker::Run(argv[2], failAfter, bHang);
+	}
+	if (argc >= 2 && !strcmp(argv[1], "--test-server"))
+	{
+		return TestRenderServer();
+	}
+#endif
+	if (argc >= 3 && !strcmp(argv[1], "--bench-decode"))
+	{
+		return BenchmarkPngDecode(argv[2], (argc >= 4) ? (unsigned)atoi(argv[3]) : 3);
+	}
+	if (argc >= 2 && !strcmp(argv[1], "--test-decode"))
+	{
+		return TestPngDecode((argc >= 3) ? (unsigned)atoi(argv[2]) : 200);
+	}
+	if (argc >= 3 && !strcmp(argv[1], "--bench-normals"))
+	{
+		return BenchmarkNormals((size_t)atoll(argv[2]), (argc >= 4) ? (unsigned)atoi(argv[3]) : 3);
+	}
+	if (argc >= 3 && !strcmp(argv[1], "--bench-import"))
+	{
+		return BenchmarkImport(argv[2], (argc >= 4) ? (unsigned)atoi(argv[3]) : 12);
+	}
+	if (argc >= 3 && !strcmp(argv[1], "--bench-progressive"))
+	{
+		return BenchmarkProgressive(argv[2]);
+	}
+	if (argc >= 3 && !strcmp(argv[1], "--bench-vertex-format"))
+	{
+		return BenchmarkVertexFormat(argv[2]);
+	}
+	if (argc >= 2 && !strcmp(argv[1], "--test-simplify"))
+	{
+		return TestSimplify((argc >= 3) ? (size_t)atoll(argv[2]) : 100000);
+	}
+	if (argc >= 2 && !strcmp(argv[1], "--test-arena"))
+	{
+		return TestFrameArena((argc >= 3) ? (unsigned)atoi(argv[2]) : 2000);
+	}
+	if (argc >= 3 && !strcmp(argv[1], "--bench-lod"))
+	{
+		return BenchmarkLod(argv[2], (argc >= 4) ? (float)atof(argv[3]) : MESH_LOD_ERROR_PIXELS, (argc >= 5) ? (unsigned)atoi(argv[4]) : 12);
+	}
+
+	if (argc < PATH_TO_SCENE)
+	{
+		fprintf(stderr, "usage: %s <scene file> [-w width] [-h height] [-n frames] [-o output prefix] [-j threads]\n", argv[0]);
+		return RC_FAILURE;
+	}
+
+	BatchScene scene;
+	RETURN_CODE rc = scene.Load(argv[1]);
+	if (rc != RC_SUCCESS)
+	{
+		return rc;
+	}
+
+	BATCH_SETTINGS& settings = scene.GetSettings();
+	HEADLESS_OPTIONS options = { 0, 0, 0, "", "unix", -1, 0, false, 0, "", 0, "", VF_Y4M, 30, 0, 0 };
+	rc = processCmdLineOptions(settings, options, argc, argv);
+	if (rc != RC_SUCCESS)
+	{
+		return rc;
+	}
+
+	if (options.benchImageRepeats > 0)
+	{
+		return BenchmarkImageFormats(scene, options.benchImageRepeats, options.threads);
+	}
+	if (options.benchFrameBufferFrames > 0)
+	{
+		return BenchmarkFrameBufferFormats(scene, options.benchFrameBufferFrames);
+	}
+
+#ifdef DISTRIBUTED_RENDERING
+	if (!options.serveAddress.empty())
+	{
+		RenderServer server(scene, options.threads);
+		return server.Run(options.serveAddress);
+	}
+	if (options.benchServerFrames > 0)
+	{
+		return BenchmarkServer(scene, options);
+	}
+	if (options.benchWorkers > 0)
+	{
+		return BenchmarkDistributed(scene, options, argv[0]);
+	}
+	if (options.distributedWorkers > 0)
+	{
+		return RenderDistributed(scene, options, argv[0]);
+	}
+#endif
+
+	ParallelBatchRenderer batchRenderer(scene, options.threads);
+	VideoSink             videoSink;
+	// the video may go to stdout, the report then goes to stderr
+	FILE*                 report = (options.videoPath == "-") ? stderr : stdout;
+
+	if (!options.videoPath.empty())
+	{
+		rc = videoSink.Open(options.videoPath, options.videoFormat, settings.width, settings.height, options.fps);
+		if (rc != RC_SUCCESS)
+		{
+			return rc;
+		}
+	}
+
+	MESH_ASSET_STATS meshStats = MeshAssetRegistry::Instance().GetStats();
+	fprintf(report, "Rendering %zu models, %zu lights, %zu cameras x %u frames at %dx%d on %u threads\n",
+		scene.GetModels().size(), scene.GetLights().size(), scene.GetCameras().size(), settings.frames, settings.width, settings.height,
+		batchRenderer.GetThreadCount());
+	fprintf(report, "%u mesh files parsed, %u more models got an already parsed one\n", meshStats.loads, meshStats.shared);
+
+	auto start = std::chrono::steady_clock::now();
+	if (options.videoPath.empty())
+	{
+		rc = batchRenderer.Render(true);
+	}
+	else
+	{
+		// frames reach the sink in order, cameras one after the other
+		rc = batchRenderer.Render(false, [&videoSink](unsigned, unsigned, const std::vector<unsigned char>& pixels)
+		{
+			return videoSink.WriteFrame(pixels.data());
+		});
+		RETURN_CODE closeRc = videoSink.Close();
+		rc = (rc == RC_SUCCESS) ? closeRc : rc;
+	}
+	double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	if (rc != RC_SUCCESS)
+	{
+		return rc;
+	}
+	PrintTimings(report, batchRenderer.GetTimings(), wallSeconds, batchRenderer.GetThreadCount());
+	POST_TRAFFIC traffic = batchRenderer.GetPostEffectTraffic();
+	if (traffic.fullFrameBytes > 0)
+	{
+		fprintf(report, "post effect %d, kernel %dx%d: %.2f MB per frame (unfused passes: %.2f MB), %.1f KB row scratch\n", settings.postEffect,
+			settings.blurX, settings.blurY, traffic.fullFrameBytes / 1048576.0, traffic.legacyBytes / 1048576.0, traffic.scratchBytes / 1024.0);
+	}
+	if (!options.videoPath.empty())
+	{
+		const VIDEO_SINK_STATS& stats = videoSink.GetStats();
+		fprintf(report, "video: %u frames, %.1f MB, convert %.3f ms/frame, write %.3f ms/frame on its own thread, "
+			"render loop waited %.3f s, %u buffers\n", stats.frames, stats.bytes / 1e6, 1000.0 * stats.convertSeconds / stats.frames,
+			1000.0 * stats.writeSeconds / stats.frames, stats.stallSeconds, stats.buffers);
+	}
+
+	return RC_SUCCESS;
+}
+
+RETURN_CODE processCmdLineOptions(BATCH_SETTINGS& settings, HEADLESS_OPTIONS& options, int argCount, char **argVec)
+{
+	for (int i = PATH_TO_SCENE; i < argCount; i += 2)
+	{
+		if (i + 1 >= argCount)
+		{
+			fprintf(stderr, "missing value for %s\n", argVec[i]);
+			return RC_FAILURE;
+		}
+
+		if      (!strcmp(argVec[i], "-w"))                  settings.width             = atoi(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "-h"))                  settings.height            = atoi(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "-n"))                  settings.frames            = (unsigned)atoi(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "-o"))                  settings.outputPrefix      = argVec[i + 1];
+		else if (!strcmp(argVec[i], "-j"))                  options.threads            = (unsigned)atoi(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "--distribute"))        options.distributedWorkers = (unsigned)atoi(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "--bench-distributed")) options.benchWorkers       = (unsigned)atoi(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "--listen"))            options.listenAddress      = argVec[i + 1];
+		else if (!strcmp(argVec[i], "--transport"))         options.transport          = argVec[i + 1];
+		else if (!strcmp(argVec[i], "--tile"))              options.tileSize           = atoi(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "--fail-after"))        options.failAfter          = (unsigned)atoi(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "--hang-after"))
+		{
+			options.failAfter = (unsigned)atoi(argVec[i + 1]);
+			options.bHang     = true;
+		}
+		else if (!strcmp(argVec[i], "--unit-timeout"))      options.unitTimeout        = atof(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "--serve"))             options.serveAddress       = argVec[i + 1];
+		else if (!strcmp(argVec[i], "--bench-server"))      options.benchServerFrames  = (unsigned)atoi(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "--video"))             options.videoPath          = argVec[i + 1];
+		else if (!strcmp(argVec[i], "--video-format"))      options.videoFormat        = !strcmp(argVec[i + 1], "rgb") ? VF_RGB : VF_Y4M;
+		else if (!strcmp(argVec[i], "--fps"))               options.fps                = (unsigned)atoi(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "--format"))
+		{
+			if      (!strcmp(argVec[i + 1], "png"))     settings.imageFormat = IF_PNG;
+			else if (!strcmp(argVec[i + 1], "pngfast")) settings.imageFormat = IF_PNG_FAST;
+			else if (!strcmp(argVec[i + 1], "qoi"))     settings.imageFormat = IF_QOI;
+			else
+			{
+				fprintf(stderr, "unknown image format %s\n", argVec[i + 1]);
+				return RC_FAILURE;
+			}
+		}
+		else if (!strcmp(argVec[i], "--bench-image"))       options.benchImageRepeats  = (unsigned)atoi(argVec[i + 1]);
+		else if (!strcmp(argVec[i], "--bench-framebuffer")) options.benchFrameBufferFrames = (unsigned)atoi(argVec[i + 1]);
+		else
+		{
+			fprintf(stderr, "unknown option %s\n", argVec[i]);
+			return RC_FAILURE;
+		}
+	}
+
+	//stills for print go up to 8k, the interactive viewer stays at 4k
+	if (settings.width <= 0 || settings.width > MAX_WIDTH_8K || settings.height <= 0 || settings.height > MAX_HEIGHT_8K)
+	{
+		fprintf(stderr, "height and/or width exceed 8k resolution\n");
+		return RC_FAILURE;
+	}
+
+	return RC_SUCCESS;
+}
+
+void PrintTimings(FILE* out, const STAGE_TIMINGS& timings, double wallSeconds, unsigned threads)
+{
+	static const char* stageNames[RS_COUNT] = { "clear", "lighting", "raster", "post", "readback", "encode" };
+
+	if (timings.frames == 0)
+	{
+		return;
+	}
+
+	double cpuSeconds = 0;
+	for (int stage = 0; stage < RS_COUNT; stage++)
+	{
+		cpuSeconds += timings.seconds[stage];
+	}
+
+	fprintf(out, "%u frames in %.3f s, %.2f frames/sec, %.0f triangles/frame\n", timings.frames, wallSeconds, timings.frames / wallSeconds,
+		(double)timings.triangles / timings.frames);
+	// how far from linear scaling the workers were, 1.0 means every thread rendered all the time. The stage times
+	// are wall clock per worker, with more threads than cores they include waiting for a core and always add up to 1.0.
+	unsigned hardwareThreads = MAX(std::thread::hardware_concurrency(), 1u);
+	if (threads > hardwareThreads)
+	{
+		fprintf(out, "parallel efficiency unknown, %u threads on %u hardware threads\n", threads, hardwareThreads);
+	}
+	else
+	{
+		fprintf(out, "parallel efficiency %.2f on %u threads\n", cpuSeconds / (wallSeconds * threads), threads);
+	}
+	for (int stage = 0; stage < RS_COUNT; stage++)
+	{
+		fprintf(out, "  %-9s %9.3f ms/frame\n", stageNames[stage], 1000.0 * timings.seconds[stage] / timings.frames);
+	}
+}
+
+RETURN_CODE BenchmarkFrameBufferFormats(BatchScene& scene, unsigned frames)
+{
+	static const struct { COLOR_FORMAT color; DEPTH_FORMAT depth; const char* name; } formats[] =
+	{
+		{ CF_RGB32F, DF_32F, "RGB32F + D32F" },
+		{ CF_RGB16F, DF_32F, "RGB16F + D32F" },
+		{ CF_RGB16F, DF_24,  "RGB16F + D24"  },
+		{ CF_RGBA8,  DF_24,  "RGBA8  + D24"  },
+		{ CF_RGBA8,  DF_16,  "RGBA8  + D16"  },
+	};
+	const BATCH_SETTINGS&      settings = scene.GetSettings();
+	std::vector<unsigned char> reference;
+
+	printf("%u frames at %dx%d, post effect %d\n", frames, settings.width, settings.height, settings.postEffect);
+	printf("%-14s %10s %10s %9s %9s %9s %9s %9s %9s\n", "format", "targets MB", "post MB", "clear", "raster", "post", "readback", "ms/frame",
+		"max diff");
+	for (const auto& format : formats)
+	{
+		BatchRenderer batchRenderer(settings);
+		batchRenderer.GetRenderer().SetFrameBufferFormat(format.color, format.depth);
+
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned frame = 0; frame < frames; frame++)
+		{
+			batchRenderer.RenderFrame(scene, 0, frame % settings.frames);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// compare the last frame with the one of the float targets
+		const std::vector<unsigned char>& pixels = batchRenderer.GetPixels();
+		int maxDiff = 0;
+		if (reference.empty())
+		{
+			reference = pixels;
+		}
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			maxDiff = MAX(maxDiff, abs(pixels[i] - reference[i]));
+		}
+
+		const STAGE_TIMINGS& timings = batchRenderer.GetTimings();
+		printf("%-14s %10.1f %10.1f %9.2f %9.2f %9.2f %9.2f %9.2f %9d\n", format.name, batchRenderer.GetRenderer().GetFrameBufferBytes() / 1048576.0,
+			batchRenderer.GetRenderer().GetPostEffectTraffic().fullFrameBytes / 1048576.0, 1000.0 * timings.seconds[RS_CLEAR] / frames, 1000.0 * timings.seconds[RS_RASTER] / frames, 1000.0 * timings.seconds[RS_POST] / frames,
+			1000.0 * timings.seconds[RS_READBACK] / frames, 1000.0 * seconds / frames, maxDiff);
+	}
+
+	return RC_SUCCESS;
+}
+
+RETURN_CODE BenchmarkImageFormats(BatchScene& scene, unsigned repeats, unsigned threads)
+{
+	const BATCH_SETTINGS& settings = scene.GetSettings();
+	BatchRenderer         batchRenderer(settings);
+	unsigned              width    = (unsigned)settings.width;
+	unsigned              height   = (unsigned)settings.height;
+	size_t                rowBytes = static_cast<size_t>(width) * 4;
+
+	batchRenderer.RenderFrame(scene, 0, 0);
+	const std::vector<unsigned char>& pixels = batchRenderer.GetPixels();
+	std::vector<unsigned char>        image(pixels.size());
+	for (unsigned y = 0; y < height; y++)
+	{
+		memcpy(&image[(height - 1 - y) * rowBytes], &pixels[y * rowBytes], rowBytes);
+	}
+
+	unsigned char*             png        = nullptr;
+	size_t                     pngSize    = 0;
+	unsigned char*             pngDecoded = nullptr;
+	std::vector<unsigned char> pngFast, pngFastDecoded;
+	std::vector<unsigned char> qoi, qoiDecoded;
+	unsigned                   decodedWidth, decodedHeight;
+	double                     seconds[6] = { 0 };     // encode and decode of png, fast png and qoi
+	bool                       bPngMatch     = true;
+	bool                       bPngFastMatch = true;
+	bool                       bQoiMatch     = true;
+
+	for (unsigned i = 0; i < repeats; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		free(png);
+		lodepng_encode32(&png, &pngSize, image.data(), width, height);
+		auto encoded = std::chrono::steady_clock::now();
+		free(pngDecoded);
+		unsigned error = lodepng_decode32(&pngDecoded, &decodedWidth, &decodedHeight, png, pngSize);
+		auto decoded = std::chrono::steady_clock::now();
+		seconds[0] += std::chrono::duration<double>(encoded - start).count();
+		seconds[1] += std::chrono::duration<double>(decoded - encoded).count();
+		bPngMatch   = bPngMatch && !error && memcmp(pngDecoded, image.data(), image.size()) == 0;
+
+		// a standard PNG, lodepng's own decoder has to read it back
+		start = std::chrono::steady_clock::now();
+		error = lodepng::encodeFast(pngFast, image.data(), width, height, threads);
+		encoded = std::chrono::steady_clock::now();
+		// lodepng::decode appends to its output
+		pngFastDecoded.clear();
+		error = error ? error : lodepng::decode(pngFastDecoded, decodedWidth, decodedHeight, pngFast);
+		decoded = std::chrono::steady_clock::now();
+		seconds[2]   += std::chrono::duration<double>(encoded - start).count();
+		seconds[3]   += std::chrono::duration<double>(decoded - encoded).count();
+		bPngFastMatch = bPngFastMatch && !error && pngFastDecoded == image;
+
+		start = std::chrono::steady_clock::now();
+		QoiImage::Encode(image.data(), width, height, qoi);
+		encoded = std::chrono::steady_clock::now();
+		RETURN_CODE rc = QoiImage::Decode(qoi.data(), qoi.size(), qoiDecoded, decodedWidth, decodedHeight);
+		decoded = std::chrono::steady_clock::now();
+		seconds[4] += std::chrono::duration<double>(encoded - start).count();
+		seconds[5] += std::chrono::duration<double>(decoded - encoded).count();
+		// QOI has to give back exactly what lodepng does
+		bQoiMatch   = bQoiMatch && rc == RC_SUCCESS && bPngMatch && memcmp(qoiDecoded.data(), pngDecoded, image.size()) == 0;
+	}
+
+	// the bottom-up encode the frame dumps use has to agree with the flipped one
+	std::vector<unsigned char> qoiBottomUp;
+	QoiImage::Encode(pixels.data(), width, height, qoiBottomUp, true);
+	bQoiMatch = bQoiMatch && qoiBottomUp == qoi;
+
+	double megabytes = image.size() * repeats / 1e6;
+	fprintf(stdout, "%ux%u RGBA8 frame, %.2f MB raw, %u repeats\n", width, height, image.size() / 1e6, repeats);
+	fprintf(stdout, "format     size MB   encode MB/s   decode MB/s   round trip\n");
+	fprintf(stdout, "png     %10.3f %13.1f %13.1f   %s\n", pngSize / 1e6, megabytes / seconds[0], megabytes / seconds[1], bPngMatch ? "ok" : "MISMATCH");
+	fprintf(stdout, "pngfast %10.3f %13.1f %13.1f   %s\n", pngFast.size() / 1e6, megabytes / seconds[2], megabytes / seconds[3], bPngFastMatch ? "ok" : "MISMATCH");
+	fprintf(stdout, "qoi     %10.3f %13.1f %13.1f   %s\n", qoi.size() / 1e6, megabytes / seconds[4], megabytes / seconds[5], bQoiMatch ? "ok" : "MISMATCH");
+
+	free(png);
+	free(pngDecoded);
+	return (bPngMatch && bPngFastMatch && bQoiMatch) ? RC_SUCCESS : RC_FAILURE;
+}
+
+RETURN_CODE BenchmarkPngDecode(const char* path, unsigned repeats)
+{
+	std::vector<std::string> files;
+	std::error_code          error;
+
+	if (std::filesystem::is_directory(path, error))
+	{
+		for (const auto& entry : std::filesystem::directory_iterator(path, error))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".png")
+			{
+				files.push_back(entry.path().string());
+			}
+		}
+		std::sort(files.begin(), files.end());
+	}
+	else
+	{
+		files.push_back(path);
+	}
+	if (files.empty() || repeats == 0)
+	{
+		fprintf(stderr, "no PNG files in %s\n", path);
+		return RC_FAILURE;
+	}
+
+	double totalSeconds = 0;
+	double totalMegabytes = 0;
+	fprintf(stdout, "%-40s %11s %9s %11s %9s  %s\n", "file", "size", "MB raw", "ms/decode", "MB/s", "checksum");
+	for (const std::string& file : files)
+	{
+		std::vector<unsigned char> png, rgba;
+		unsigned                   width = 0, height = 0;
+		if (lodepng::load_file(png, file) != 0)
+		{
+			fprintf(stderr, "Loading %s failed\n", file.c_str());
+			return RC_IO_ERROR;
+		}
+
+		auto     start = std::chrono::steady_clock::now();
+		unsigned err   = 0;
+		for (unsigned i = 0; i < repeats && !err; i++)
+		{
+			rgba.clear();
+			err = lodepng::decode(rgba, width, height, png);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+		if (err)
+		{
+			fprintf(stderr, "Decoding %s failed: %s\n", file.c_str(), lodepng_error_text(err));
+			return RC_FAILURE;
+		}
+
+		// FNV-1a over the pixels, identical for every correct decoder
+		uint64_t checksum = 14695981039346656037ull;
+		for (unsigned char byte : rgba)
+		{
+			checksum = (checksum ^ byte) * 1099511628211ull;
+		}
+
+		double megabytes = rgba.size() / 1e6;
+		totalSeconds   += seconds;
+		totalMegabytes += megabytes;
+		char size[32];
+		snprintf(size, sizeof(size), "%ux%u", width, height);
+		fprintf(stdout, "%-40s %11s %9.2f %11.3f %9.1f  %016llx\n", std::filesystem::path(file).filename().string().c_str(), size,
+			megabytes, 1000.0 * seconds, megabytes / seconds, (unsigned long long)checksum);
+	}
+	fprintf(stdout, "%zu files, %.2f MB raw, %.3f ms per pass, %.1f MB/s\n", files.size(), totalMegabytes, 1000.0 * totalSeconds,
+		totalMegabytes / totalSeconds);
+	return RC_SUCCESS;
+}
+
+RETURN_CODE TestPngDecode(unsigned images)
+{
+	// color type / bit depth pairs the decoder has to reproduce bit for bit, sub-byte depths included
+	static const struct { LodePNGColorType type; unsigned channels; unsigned bitDepth; } modes[] = {
+		{ LCT_GREY, 1, 1 }, { LCT_GREY, 1, 2 }, { LCT_GREY, 1, 4 }, { LCT_GREY, 1, 8 }, { LCT_GREY, 1, 16 }, { LCT_GREY_ALPHA, 2, 8 },
+		{ LCT_GREY_ALPHA, 2, 16 }, { LCT_RGB, 3, 8 }, { LCT_RGB, 3, 16 }, { LCT_RGBA, 4, 8 }, { LCT_RGBA, 4, 16 } };
+	static const unsigned modeCount = sizeof(modes) / sizeof(modes[0]);
+
+	std::mt19937 random(1234);
+	unsigned     failures = 0;
+	size_t       totalBytes = 0;
+	for (unsigned image = 0; image <= images; image++)
+	{
+		// the last image goes through encodeFast: an RGBA8 frame large enough to be split into sync flushed parts
+		bool     bFast    = (image == images);
+		unsigned mode     = bFast ? 9 : image % modeCount;
+		unsigned width    = bFast ? 640 : 1 + random() % 300;
+		unsigned height   = bFast ? 480 : 1 + random() % 200;
+		unsigned bitDepth = modes[mode].bitDepth;
+		size_t   bits     = (size_t)width * height * modes[mode].channels * bitDepth;
+
+		// noise, gradients and flat runs, so literals, short and long matches all show up
+		std::vector<unsigned char> pixels((bits + 7) / 8);
+		unsigned content = (image / modeCount) % 3;
+		for (size_t i = 0; i < pixels.size(); i++)
+		{
+			pixels[i] = (content == 0) ? (unsigned char)random() : (content == 1) ? (unsigned char)(i * 7 + i / 97) : (unsigned char)((i / 53) * 31);
+		}
+
+		std::vector<unsigned char> png;
+		unsigned                   error;
+		if (bFast)
+		{
+			error = lodepng::encodeFast(png, pixels.data(), width, height, 4);
+		}
+		else
+		{
+			// every filter type on every image, one per scanline in turn
+			std::vector<unsigned char> filters(height);
+			for (unsigned row = 0; row < height; row++)
+			{
+				filters[row] = (unsigned char)((row + image) % 5);
+			}
+			lodepng::State state;
+			state.info_raw.colortype                 = modes[mode].type;
+			state.info_raw.bitdepth                  = bitDepth;
+			state.info_png.color.colortype           = modes[mode].type;
+			state.info_png.color.bitdepth            = bitDepth;
+			state.info_png.interlace_method          = (image / 2) % 2;
+			state.encoder.auto_convert               = 0;
+			state.encoder.filter_palette_zero        = 0;
+			state.encoder.filter_strategy            = state.info_png.interlace_method ? LFS_MINSUM : LFS_PREDEFINED;
+			state.encoder.predefined_filters         = filters.data();
+			state.encoder.zlibsettings.btype         = image % 3;
+			state.encoder.zlibsettings.windowsize    = (image % 4 < 2) ? 32768 : 256;
+			state.encoder.zlibsettings.lazymatching  = image % 2;
+			error = lodepng::encode(png, pixels, width, height, state);
+		}
+		if (error)
+		{
+			fprintf(stderr, "image %u: encoding failed: %s\n", image, lodepng_error_text(error));
+			return RC_FAILURE;
+		}
+
+		std::vector<unsigned char> decoded;
+		unsigned                   decodedWidth = 0, decodedHeight = 0;
+		error = lodepng::decode(decoded, decodedWidth, decodedHeight, png, modes[mode].type, bitDepth);
+		// the bits after the last pixel of a sub-byte image are padding
+		unsigned char lastMask = (bits % 8) ? (unsigned char)(0xFF << (8 - bits % 8)) : 0xFF;
+		bool bMatch = !error && decodedWidth == width && decodedHeight == height && decoded.size() == pixels.size() &&
+		              std::equal(pixels.begin(), pixels.end() - 1, decoded.begin()) && ((pixels.back() ^ decoded.back()) & lastMask) == 0;
+		if (!bMatch)
+		{
+			fprintf(stderr, "image %u (%ux%u, color type %d, %u bit, %s): %s\n", image, width, height, (int)modes[mode].type, bitDepth,
+				bFast ? "encodeFast" : "lodepng::encode", error ? lodepng_error_text(error) : "pixels differ");
+			failures++;
+		}
+		totalBytes += png.size();
+	}
+
+	fprintf(stdout, "%u PNGs (%.1f KB), %u decoded differently from their source\n", images + 1, totalBytes / 1024.0, failures);
+	return failures ? RC_FAILURE : RC_SUCCESS;
+}
+
+RETURN_CODE BenchmarkNormals(size_t triangleCount, unsigned repeats)
+{
+	// A latitude/longitude sphere, 2 * rows * columns triangles with columns = 2 * rows
+	unsigned rows    = MAX((unsigned)sqrt(triangleCount / 4.0), 2u);
+	unsigned columns = 2 * rows;
+	if (repeats == 0)
+	{
+		fprintf(stderr, "repeats must be at least 1\n");
+		return RC_FAILURE;
+	}
+
+	std::vector<glm::vec3> vertices;
+	std::vector<GLuint>    triangles;
+	vertices.reserve((size_t)(rows + 1) * (columns + 1));
+	triangles.reserve((size_t)rows * columns * 2 * FACE_ELEMENTS);
+	for (unsigned row = 0; row <= rows; row++)
+	{
+		float theta = (float)PI * row / rows;
+		for (unsigned column = 0; column <= columns; column++)
+		{
+			float phi = 2.f * (float)PI * column / columns;
+			vertices.push_back(glm::vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi)));
+		}
+	}
+	for (unsigned row = 0; row < rows; row++)
+	{
+		for (unsigned column = 0; column < columns; column++)
+		{
+			GLuint v = row * (columns + 1) + column;
+			triangles.insert(triangles.end(), { v, v + columns + 1, v + 1, v + 1, v + columns + 1, v + columns + 2 });
+		}
+	}
+	size_t faceCount = triangles.size() / FACE_ELEMENTS;
+
+	unsigned hardwareThreads = MAX(std::thread::hardware_concurrency(), 1u);
+	uint64_t firstChecksum   = 0;
+	bool     bIdentical      = true;
+	fprintf(stdout, "%zu triangles, %zu vertices\n%8s %11s %12s  %s\n", faceCount, vertices.size(), "threads", "ms/pass", "Mtri/s", "checksum");
+	for (unsigned threads = 1; ; threads = MIN(2 * threads, hardwareThreads))
+	{
+		std::vector<glm::vec3> vertexNormals, cornerNormals;
+		ThreadPool             pool(threads);
+		auto start = std::chrono::steady_clock::now();
+		for (unsigned i = 0; i < repeats; i++)
+		{
+			MeshNormals::Generate(vertices, triangles, NW_ANGLE, MESH_NORMALS_CREASE_ANGLE, vertexNormals, cornerNormals,
+				threads == 1 ? nullptr : &pool);
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / repeats;
+
+		// FNV-1a over the corner normals' bits, the reduction order does not depend on the thread count
+		uint64_t             checksum = 14695981039346656037ull;
+		const unsigned char* bytes    = (const unsigned char*)cornerNormals.data();
+		for (size_t i = 0; i < cornerNormals.size() * sizeof(glm::vec3); i++)
+		{
+			checksum = (checksum ^ bytes[i]) * 1099511628211ull;
+		}
+		firstChecksum = (threads == 1) ? checksum : firstChecksum;
+		bIdentical    = bIdentical && checksum == firstChecksum;
+
+		fprintf(stdout, "%8u %11.3f %12.2f  %016llx\n", threads, 1000.0 * seconds, faceCount / seconds / 1e6, (unsigned long long)checksum);
+		if (threads == hardwareThreads)
+		{
+			break;
+		}
+	}
+	fprintf(stdout, "normals %s across thread counts\n", bIdentical ? "identical" : "DIFFER");
+	return bIdentical ? RC_SUCCESS : RC_FAILURE;
+}
+
+// The obj files of a directory, sorted, or the file itself
+static std::vector<std::string> listObjFiles(const char* path)
+{
+	std::vector<std::string> files;
+	std::error_code          error;
+
+	if (std::filesystem::is_directory(path, error))
+	{
+		for (const auto& entry : std::filesystem::directory_iterator(path, error))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == ".obj")
+			{
+				files.push_back(entry.path().string());
+			}
+		}
+		std::sort(files.begin(), files.end());
+	}
+	else
+	{
+		files.push_back(path);
+	}
+	return files;
+}
+
+RETURN_CODE BenchmarkImport(const char* path, unsigned frames)
+{
+	std::vector<std::string> files = listObjFiles(path);
+	if (files.empty() || frames == 0)
+	{
+		fprintf(stderr, "no obj files in %s\n", path);
+		return RC_FAILURE;
+	}
+
+	double totalRaster[2] = { 0, 0 };
+	size_t totalBytes[2]  = { 0, 0 };
+	size_t totalLodBytes  = 0;
+	// KB is the full mesh only, the levels of detail the import pass adds are listed apart
+	fprintf(stdout, "%-24s %17s %17s %17s %8s %21s\n", "file", "vertices", "triangles", "KB", "LOD KB", "raster ms/frame");
+	for (const std::string& file : files)
+	{
+		MESH_IMPORT_STATS importStats = MESH_IMPORT_STATS();
+		size_t            bytes[2];
+		size_t            lodBytes = 0;
+		double            raster[2];
+
+		// 0: as in the file, 1: with the import pass
+		for (int pass = 0; pass < 2; pass++)
+		{
+			MeshAssetRegistry::Instance().SetImportOptimization(pass == 1);
+
+			std::ostringstream description;
+			// lod 0: the import pass also builds levels of detail, the timing compares the full meshes
+			description << "size 640 480\nshading phong\nlod 0\n"
+				<< "material grey 0.6 0.6 0.6 0.2 0.6 0.6 0.6 0.8 1 1 1 0.4 16\nuse grey\n"
+				<< "light point 0 2 4 1 1 1 0.2 1 1 1 0.8 1 1 1 0.5\n"
+				<< "model " << file << "\nframes " << frames << "\nspin " << 360.f / frames << "\n";
+			BatchScene scene;
+			if (scene.LoadFromMemory(description.str(), "bench-import") != RC_SUCCESS || scene.GetModels().empty())
+			{
+				fprintf(stderr, "Loading %s failed\n", file.c_str());
+				return RC_FAILURE;
+			}
+			const PMeshAsset& asset = static_cast<MeshModel*>(scene.GetModels()[0])->GetAsset();
+			importStats = asset->m_importStats;
+			bytes[pass] = asset->GetMemoryBytes(false);
+			lodBytes    = asset->GetMemoryBytes() - bytes[pass];
+
+			BatchRenderer batchRenderer(scene.GetSettings());
+			for (unsigned frame = 0; frame < frames; frame++)
+			{
+				batchRenderer.RenderFrame(scene, 0, frame);
+			}
+			raster[pass] = batchRenderer.GetTimings().seconds[RS_RASTER] / frames;
+			totalRaster[pass] += raster[pass];
+			totalBytes[pass]  += bytes[pass];
+		}
+		totalLodBytes += lodBytes;
+		MeshAssetRegistry::Instance().SetImportOptimization(true);
+
+		char vertices[32], triangles[32], kilobytes[48], times[32];
+		snprintf(vertices, sizeof(vertices), "%u -> %u", importStats.verticesIn, importStats.verticesOut);
+		snprintf(triangles, sizeof(triangles), "%u -> %u", importStats.trianglesIn, importStats.trianglesOut);
+		snprintf(kilobytes, sizeof(kilobytes), "%zu -> %zu", bytes[0] / 1024, bytes[1] / 1024);
+		snprintf(times, sizeof(times), "%.2f -> %.2f", 1000.0 * raster[0], 1000.0 * raster[1]);
+		fprintf(stdout, "%-24s %17s %17s %17s %8zu %21s  %.2fx\n", std::filesystem::path(file).filename().string().c_str(), vertices, triangles,
+			kilobytes, lodBytes / 1024, times, raster[0] / raster[1]);
+	}
+	// signed, a mesh the pass cannot weld may come out a little larger
+	double savedBytes = (double)totalBytes[0] - (double)totalBytes[1];
+	fprintf(stdout, "%zu files, %.1f KB saved (%.1f%%) plus %.1f KB of levels of detail, raster %.2fx faster\n", files.size(),
+		savedBytes / 1024.0, 100.0 * savedBytes / totalBytes[0], totalLodBytes / 1024.0, totalRaster[0] / totalRaster[1]);
+	return RC_SUCCESS;
+}
+
+RETURN_CODE BenchmarkLod(const char* path, float errorPixels, unsigned frames)
+{
+	static const float distances[] = { 2.f, 4.f, 8.f, 16.f, 32.f, 64.f, 128.f };
+
+	if (frames == 0)
+	{
+		return RC_FAILURE;
+	}
+
+	// the first scene keeps the asset, the others share it instead of loading the file again
+	std::unique_ptr<BatchScene> first;
+	fprintf(stdout, "%-9s %23s %23s\n", "distance", "triangles/frame", "raster ms/frame");
+	for (float distance : distances)
+	{
+		double triangles[2], raster[2];
+
+		// 0: full meshes, 1: levels of detail
+		for (int pass = 0; pass < 2; pass++)
+		{
+			std::ostringstream description;
+			// lod 0: the import pass also builds levels of detail, the timing compares the full meshes
+			description << "size 640 480\nshading phong\nlod 0\n"
+				<< "material grey 0.6 0.6 0.6 0.2 0.6 0.6 0.6 0.8 1 1 1 0.4 16\nuse grey\n"
+				<< "light point 0 2 4 1 1 1 0.2 1 1 1 0.8 1 1 1 0.5\n"
+				<< "camera 0 0 " << distance << " 0 0 0 0 1 0\nperspective 45 0.1 1000\n"
+				<< "model " << path << "\nframes " << frames << "\nspin " << 360.f / frames << "\n"
+				<< "lod " << (pass == 0 ? 0.f : errorPixels) << "\n";
+			std::unique_ptr<BatchScene> scene(new BatchScene());
+			if (scene->LoadFromMemory(description.str(), "bench-lod") != RC_SUCCESS || scene->GetModels().empty())
+			{
+				fprintf(stderr, "Loading %s failed\n", path);
+				return RC_FAILURE;
+			}
+
+			BatchRenderer batchRenderer(scene->GetSettings());
+			for (unsigned frame = 0; frame < frames; frame++)
+			{
+				batchRenderer.RenderFrame(*scene, 0, frame);
+			}
+			triangles[pass] = (double)batchRenderer.GetTimings().triangles / frames;
+			raster[pass]    = batchRenderer.GetTimings().seconds[RS_RASTER] / frames;
+			if (!first)
+			{
+				first = std::move(scene);
+			}
+		}
+
+		char triangleCounts[32], times[32];
+		snprintf(triangleCounts, sizeof(triangleCounts), "%.0f -> %.0f", triangles[0], triangles[1]);
+		snprintf(times, sizeof(times), "%.2f -> %.2f", 1000.0 * raster[0], 1000.0 * raster[1]);
+		fprintf(stdout, "%-9.0f %23s %23s  %.1fx fewer\n", distance, triangleCounts, times, triangles[0] / MAX(triangles[1], 1.0));
+	}
+	return RC_SUCCESS;
+}
+
+RETURN_CODE BenchmarkProgressive(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (file.fail())
+	{
+		fprintf(stderr, "Opening %s failed\n", path);
+		return RC_IO_ERROR;
+	}
+	file.seekg(0, std::ios::end);
+	double megabytes = (double)file.tellg() / (1024.0 * 1024.0);
+
+	auto      start = std::chrono::steady_clock::now();
+	MeshAsset preview;
+	preview.LoadPreview(file);
+	double previewSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fprintf(stdout, "%s, %.1f MB\n", path, megabytes);
+	fprintf(stdout, "preview:    %8.1f ms, %u vertices sampled, %zu triangles\n", 1000.0 * previewSeconds, preview.m_importStats.verticesIn,
+		preview.m_polygons.size());
+
+	file.clear();
+	file.seekg(0);
+	start = std::chrono::steady_clock::now();
+	MeshAsset full;
+	full.LoadStream(file);
+	double fullSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	fprintf(stdout, "full mesh:  %8.1f ms, %zu triangles, %zu levels of detail (coarsest %zu triangles)\n", 1000.0 * fullSeconds,
+		full.m_polygons.size(), full.m_lods.size(), full.m_lods.empty() ? full.m_polygons.size() : full.m_lods.back()->m_polygons.size());
+	fprintf(stdout, "first image %.0fx sooner\n", fullSeconds / MAX(previewSeconds, 1e-6));
+	return RC_SUCCESS;
+}
+
+RETURN_CODE BenchmarkVertexFormat(const char* path)
+{
+	std::vector<std::string> files = listObjFiles(path);
+	if (files.empty())
+	{
+		fprintf(stderr, "no obj files in %s\n", path);
+		return RC_FAILURE;
+	}
+
+	size_t totalBytes[2]    = { 0, 0 };
+	float  maxPositionError = 0.f, maxNormalDegrees = 0.f;
+	fprintf(stdout, "%-24s %10s %21s %13s %16s\n", "file", "vertices", "KB float -> packed", "max position", "max normal deg");
+	for (const std::string& file : files)
+	{
+		std::ifstream ifile(file.c_str(), std::ios::binary);
+		if (ifile.fail())
+		{
+			fprintf(stderr, "Opening %s failed\n", file.c_str());
+			return RC_IO_ERROR;
+		}
+		MeshAsset asset;
+		asset.LoadStream(ifile);
+
+		// the buffers Upload makes, every level of detail has its own
+		std::vector<const MeshAsset*> levels(1, &asset);
+		for (const auto& lod : asset.m_lods)
+		{
+			levels.push_back(lod.get());
+		}
+
+		size_t vertexCount = 0, bytes[2] = { 0, 0 };
+		float  positionError = 0.f, normalDot = 1.f;
+		for (const MeshAsset* level : levels)
+		{
+			std::vector<MESH_VERTEX> vertices;
+			std::vector<GLuint>      indices;
+			level->BuildBufferData(vertices, indices);
+			vertexCount += vertices.size();
+			bytes[0]    += vertices.size() * VERTEX_FLOAT_LAYOUT_BYTES + indices.size() * sizeof(GLuint);
+			bytes[1]    += vertices.size() * sizeof(MESH_VERTEX) + indices.size() * sizeof(GLuint);
+
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				glm::vec3 position = glm::clamp(level->m_vertexPositions[i], -1.f, 1.f);
+				glm::vec3 decoded  = VertexCodec::DecodePosition(vertices[i].position);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					positionError = MAX(positionError, fabsf(decoded[axis] - position[axis]));
+				}
+
+				const Face& face   = level->m_polygons[i / FACE_ELEMENTS];
+				glm::vec3   normal = (i % FACE_ELEMENTS == 0) ? face.m_vn1 : (i % FACE_ELEMENTS == 1) ? face.m_vn2 : face.m_vn3;
+				if (glm::dot(normal, normal) > 0.f)
+				{
+					normalDot = MIN(normalDot, glm::dot(glm::normalize(normal), VertexCodec::DecodeNormal(vertices[i].normal)));
+				}
+			}
+		}
+		float normalDegrees = glm::degrees(acosf(MIN(MAX(normalDot, -1.f), 1.f)));
+
+		char kilobytes[48];
+		snprintf(kilobytes, sizeof(kilobytes), "%zu -> %zu", bytes[0] / 1024, bytes[1] / 1024);
+		fprintf(stdout, "%-24s %10zu %21s %13.2e %16.4f\n", std::filesystem::path(file).filename().string().c_str(), vertexCount, kilobytes,
+			positionError, normalDegrees);
+		totalBytes[0]   += bytes[0];
+		totalBytes[1]   += bytes[1];
+		maxPositionError = MAX(maxPositionError, positionError);
+		maxNormalDegrees = MAX(maxNormalDegrees, normalDegrees);
+	}
+	fprintf(stdout, "%zu files, %.1f KB saved (%.1f%%), vertex fetch %.2fx smaller\n", files.size(), (totalBytes[0] - totalBytes[1]) / 1024.0,
+		100.0 * (totalBytes[0] - totalBytes[1]) / totalBytes[0], (double)VERTEX_FLOAT_LAYOUT_BYTES / sizeof(MESH_VERTEX));
+	fprintf(stdout, "max position error %.2e (bound %.2e), max normal error %.4f degrees\n", maxPositionError, VERTEX_POSITION_ERROR,
+		maxNormalDegrees);
+	return (maxPositionError <= VERTEX_POSITION_ERROR + FLT_EPSILON) ? RC_SUCCESS : RC_FAILURE;
+}
+
+RETURN_CODE TestSimplify(size_t triangleCount)
+{
+	// A latitude/longitude sphere with one vertex per pole and the seam welded, so every edge has two faces
+	unsigned rows    = MAX((unsigned)sqrt(triangleCount / 4.0), 3u);
+	unsigned columns = 2 * rows;
+	std::vector<glm::vec3> vertices;
+	std::vector<GLuint>    triangles;
+
+	vertices.push_back(glm::vec3(0.f, 1.f, 0.f));
+	for (unsigned row = 1; row < rows; row++)
+	{
+		float theta = (float)PI * row / rows;
+		for (unsigned column = 0; column < columns; column++)
+		{
+			float phi = 2.f * (float)PI * column / columns;
+			vertices.push_back(glm::vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi)));
+		}
+	}
+	vertices.push_back(glm::vec3(0.f, -1.f, 0.f));
+
+	GLuint southPole = (GLuint)vertices.size() - 1;
+	for (unsigned column = 0; column < columns; column++)
+	{
+		GLuint next = (column + 1) % columns;
+		triangles.insert(triangles.end(), { 0, 1 + column, 1 + next });
+		for (unsigned row = 1; row + 1 < rows; row++)
+		{
+			GLuint v = 1 + (row - 1) * columns;
+			triangles.insert(triangles.end(), { v + column, v + columns + column, v + next, v + next, v + columns + column, v + columns + next });
+		}
+		GLuint last = 1 + (rows - 2) * columns;
+		triangles.insert(triangles.end(), { last + column, southPole, last + next });
+	}
+
+	fprintf(stdout, "%6s %10s %10s %10s  %s\n", "level", "target", "triangles", "error", "closed");
+	RETURN_CODE rc    = RC_SUCCESS;
+	float       error = 0.f;
+	for (unsigned level = 1; level <= MESH_LOD_MAX_LEVELS && triangles.size() / FACE_ELEMENTS >= 2 * MESH_LOD_MIN_TRIANGLES; level++)
+	{
+		size_t                 target = triangles.size() / FACE_ELEMENTS / 2;
+		std::vector<glm::vec3> simplifiedVertices;
+		std::vector<GLuint>    simplifiedTriangles;
+		error += MeshSimplifier::Simplify(vertices, triangles, target, simplifiedVertices, simplifiedTriangles);
+		vertices.swap(simplifiedVertices);
+		triangles.swap(simplifiedTriangles);
+
+		// on a closed surface every collapse removes two faces, the simplifier stops at the target or one below it
+		size_t faceCount = triangles.size() / FACE_ELEMENTS;
+		bool   bOnTarget = faceCount <= target && faceCount + 2 > target;
+
+		std::vector<unsigned long long> edges;
+		for (size_t i = 0; i < triangles.size(); i += FACE_ELEMENTS)
+		{
+			for (int k = 0; k < FACE_ELEMENTS; k++)
+			{
+				GLuint a = triangles[i + k], b = triangles[i + (k + 1) % FACE_ELEMENTS];
+				edges.push_back(EDGE_KEY(MIN(a, b), MAX(a, b)));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		bool bClosed = true;
+		for (size_t i = 0; i < edges.size() && bClosed; i += 2)
+		{
+			bClosed = i + 1 < edges.size() && edges[i] == edges[i + 1] && (i + 2 == edges.size() || edges[i + 2] != edges[i]);
+		}
+
+		fprintf(stdout, "%6u %10zu %10zu %10.5f  %s%s\n", level, target, faceCount, error, bClosed ? "yes" : "NO",
+			bOnTarget ? "" : "  MISSED TARGET");
+		if (!bOnTarget || !bClosed)
+		{
+			rc = RC_FAILURE;
+		}
+	}
+	return rc;
+}
+
+RETURN_CODE TestFrameArena(unsigned resizes)
+{
+	static const COLOR_FORMAT colorFormats[] = { CF_RGB32F, CF_RGB16F, CF_RGBA8 };
+	static const DEPTH_FORMAT depthFormats[] = { DF_32F, DF_24, DF_16 };
+	Renderer                   renderer(MAX_WIDTH_4K, MAX_HEIGHT_4K, true);
+	std::vector<unsigned char> pixels(static_cast<size_t>(MAX_WIDTH_4K) * MAX_HEIGHT_4K * 4);
+	std::mt19937               random(1234);
+
+	// the float formats are the largest, the first 4K frame sizes the arena for everything after it
+	renderer.ClearColorBuffer();
+	renderer.ReadPixels(pixels.data());
+	const FrameArena& arena       = renderer.GetFrameArena();
+	const void*       block       = arena.GetBlock();
+	size_t            capacity    = arena.GetCapacity();
+	size_t            allocations = arena.GetAllocationCount();
+
+	for (unsigned i = 0; i < resizes; i++)
+	{
+		int width  = 1 + static_cast<int>(random() % MAX_WIDTH_4K);
+		int height = 1 + static_cast<int>(random() % MAX_HEIGHT_4K);
+		renderer.SetFrameBufferFormat(colorFormats[random() % 3], depthFormats[random() % 3]);
+		renderer.Viewport(width, height);
+		renderer.ClearColorBuffer();
+		renderer.ReadPixels(pixels.data());
+
+		if (arena.GetBlock() != block || arena.GetCapacity() != capacity || arena.GetAllocationCount() != allocations)
+		{
+			fprintf(stderr, "resize %u to %dx%d: arena block %p -> %p, capacity %zu -> %zu, %zu -> %zu allocations\n", i, width, height,
+				block, arena.GetBlock(), capacity, arena.GetCapacity(), allocations, arena.GetAllocationCount());
+			return RC_FAILURE;
+		}
+	}
+
+	fprintf(stdout, "%u resizes, arena of %.1f MB allocated %zu times, never moved\n", resizes, capacity / 1048576.0, allocations);
+	return RC_SUCCESS;
+}
+
+#ifdef DISTRIBUTED_RENDERING
+
+// Starts 'workers' local worker processes, or waits for remote ones when listenAddress is given, and hands them to the coordinator
+static RETURN_CODE connectWorkers(RenderCoordinator& coordinator, NetListener& listener, unsigned workers, const HEADLESS_OPTIONS& options,
+	const char* executable, unsigned failAfter, std::vector<int>& children)
+{
+	std::string address = options.listenAddress;
+	if (address.empty())
+	{
+		address = (options.transport == "tcp") ? std::string("tcp:127.0.0.1:0") : "unix:/tmp/meshviewer-" + std::to_string(getpid()) + ".sock";
+	}
+
+	RETURN_CODE rc = listener.Listen(address);
+	if (rc != RC_SUCCESS)
+	{
+		return rc;
+	}
+
+	if (options.listenAddress.empty())
+	{
+		for (unsigned i = 0; i < workers; i++)
+		{
+			// only the first worker dies, the others have to pick up its units
+			int pid = RenderCoordinator::SpawnLocalWorker(executable, listener.GetAddress(), i == 0 ? failAfter : 0, options.bHang);
+			if (pid < 0)
+			{
+				return RC_FAILURE;
+			}
+			children.push_back(pid);
+		}
+	}
+	else
+	{
+		fprintf(stdout, "waiting for %u workers on %s\n", workers, listener.GetAddress().c_str());
+	}
+
+	for (unsigned i = 0; i < workers; i++)
+	{
+		NetChannel channel;
+		rc = listener.Accept(channel);
+		if (rc == RC_SUCCESS)
+		{
+			rc = coordinator.AddWorker(std::move(channel));
+		}
+		if (rc != RC_SUCCESS)
+		{
+			return rc;
+		}
+	}
+	return RC_SUCCESS;
+}
+
+static double unitTimeout(const HEADLESS_OPTIONS& options)
+{
+	return options.unitTimeout > 0 ? options.unitTimeout : COORDINATOR_UNIT_TIMEOUT;
+}
+
+static void reapWorkers(std::vector<int>& children)
+{
+	for (int pid : children)
+	{
+		waitpid(pid, nullptr, 0);
+	}
+	children.clear();
+}
+
+RETURN_CODE RenderDistributed(BatchScene& scene, const HEADLESS_OPTIONS& options, const char* executable)
+{
+	const BATCH_SETTINGS&      settings = scene.GetSettings();
+	RenderCoordinator          coordinator(scene, options.tileSize, unitTimeout(options));
+	NetListener                listener;
+	std::vector<int>           children;
+	std::vector<unsigned char> image;
+
+	fprintf(stdout, "Rendering %zu cameras x %u frames at %dx%d on %u workers\n",
+		scene.GetCameras().size(), settings.frames, settings.width, settings.height, options.distributedWorkers);
+
+	RETURN_CODE rc = connectWorkers(coordinator, listener, options.distributedWorkers, options, executable, options.failAfter, children);
+	if (rc == RC_SUCCESS)
+	{
+		rc = coordinator.Render([&](unsigned cameraIdx, unsigned frame, const std::vector<unsigned char>& pixels)
+		{
+			return BatchRenderer::WriteImage(BatchRenderer::FrameFileName(settings, cameraIdx, frame), pixels,
+				(unsigned)settings.width, (unsigned)settings.height, settings.imageFormat, image);
+		});
+	}
+	coordinator.Shutdown();
+	reapWorkers(children);
+
+	const COORDINATOR_STATS& stats = coordinator.GetStats();
+	fprintf(stdout, "%u units in %.3f s, %u stolen, %u retried, %u workers lost (%u timed out)\n",
+		stats.units, stats.seconds, stats.stolen, stats.retried, stats.workersLost, stats.workersTimedOut);
+	return rc;
+}
+
+RETURN_CODE BenchmarkDistributed(BatchScene& scene, const HEADLESS_OPTIONS& options, const char* executable)
+{
+	const BATCH_SETTINGS& settings = scene.GetSettings();
+	unsigned              cameras  = (unsigned)scene.GetCameras().size();
+	std::vector<uint64_t> reference(cameras * settings.frames);
+
+	// the reference: one process, one renderer, no threads
+	BatchRenderer batchRenderer(settings);
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned cameraIdx = 0; cameraIdx < cameras; cameraIdx++)
+	{
+		for (unsigned frame = 0; frame < settings.frames; frame++)
+		{
+			batchRenderer.RenderFrame(scene, cameraIdx, frame);
+			reference[cameraIdx * settings.frames + frame] = RenderCoordinator::Checksum(batchRenderer.GetPixels());
+		}
+	}
+	double localSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	fprintf(stdout, "%zu frames at %dx%d over %s sockets\n", reference.size(), settings.width, settings.height, options.transport.c_str());
+	fprintf(stdout, "workers   seconds  frames/sec  speedup  units  stolen  retried  lost  checksums\n");
+	fprintf(stdout, "  local %9.3f %11.2f %8.2f\n", localSeconds, reference.size() / localSeconds, 1.0);
+
+	RETURN_CODE result = RC_SUCCESS;
+	for (unsigned workers = 1; workers <= options.benchWorkers; workers++)
+	{
+		RenderCoordinator coordinator(scene, options.tileSize, unitTimeout(options));
+		NetListener       listener;
+		std::vector<int>  children;
+		unsigned          mismatches = 0;
+
+		// with a single worker there is nobody left to retry on
+		RETURN_CODE rc = connectWorkers(coordinator, listener, workers, options, executable, workers > 1 ? options.failAfter : 0, children);
+		if (rc == RC_SUCCESS)
+		{
+			rc = coordinator.Render([&](unsigned cameraIdx, unsigned frame, const std::vector<unsigned char>& pixels)
+			{
+				if (RenderCoordinator::Checksum(pixels) != reference[cameraIdx * settings.frames + frame])
+				{
+					mismatches++;
+				}
+				return RC_SUCCESS;
+			});
+		}
+		coordinator.Shutdown();
+		reapWorkers(children);
+
+		const COORDINATOR_STATS& stats = coordinator.GetStats();
+		if (rc != RC_SUCCESS || mismatches != 0)
+		{
+			result = RC_FAILURE;
+		}
+		fprintf(stdout, "%7u %9.3f %11.2f %8.2f %6u %7u %8u %5u  %s\n", workers, stats.seconds, reference.size() / stats.seconds,
+			localSeconds / stats.seconds, stats.units, stats.stolen, stats.retried, stats.workersLost,
+			rc != RC_SUCCESS ? "FAILED" : (mismatches == 0 ? "match" : "MISMATCH"));
+	}
+
+	return result;
+}
+
+// Forks a render server on the scene this process already loaded and connects client to it
+static RETURN_CODE startServer(BatchScene& scene, unsigned threads, const std::string& address, RenderServerClient& client, pid_t& pid)
+{
+	pid = fork();
+	if (pid == 0)
+	{
+		RETURN_CODE rc;
+		{
+			RenderServer server(scene, threads);
+			rc = server.Run(address);
+		}
+		_exit(rc);
+	}
+	if (pid < 0)
+	{
+		return RC_FAILURE;
+	}
+
+	RETURN_CODE rc = RC_IO_ERROR;
+	for (int attempt = 0; attempt < 500 && rc != RC_SUCCESS; attempt++)
+	{
+		// until the server listens
+		usleep(10000);
+		rc = client.Connect(address);
+	}
+
+	if (rc != RC_SUCCESS)
+	{
+		kill(pid, SIGTERM);
+		waitpid(pid, nullptr, 0);
+	}
+	return rc;
+}
+
+RETURN_CODE BenchmarkServer(BatchScene& scene, const HEADLESS_OPTIONS& options)
+{
+	std::string        address = "unix:/tmp/meshviewer-" + std::to_string(getpid()) + "-server.sock";
+	RenderServerClient client;
+	pid_t              pid;
+
+	RETURN_CODE rc = startServer(scene, options.threads, address, client, pid);
+	if (rc != RC_SUCCESS)
+	{
+		return rc;
+	}
+
+	const FRAME_RING_HEADER& ring   = client.GetRingHeader();
+	unsigned                 frames = options.benchServerFrames;
+	unsigned                 depths[] = { 1, ring.slotCount };
+
+	fprintf(stdout, "%u frames at %ux%u through %u ring slots\n", frames, ring.width, ring.height, ring.slotCount);
+	fprintf(stdout, "in flight   seconds  frames/sec\n");
+
+	for (unsigned depth : depths)
+	{
+		unsigned requested = 0;
+		unsigned received  = 0;
+		auto     start     = std::chrono::steady_clock::now();
+
+		while (rc == RC_SUCCESS && received < frames)
+		{
+			uint32_t     requestId;
+			SERVER_FRAME frame;
+
+			while (rc == RC_SUCCESS && requested < frames && requested - received < depth)
+			{
+				rc = client.RequestFrame(0, requested++, requestId);
+			}
+			if (rc == RC_SUCCESS)
+			{
+				rc = client.WaitFrame(frame);
+			}
+			if (rc == RC_SUCCESS && frame.slot != SERVER_NO_SLOT)
+			{
+				// a thumbnail tool would encode client.GetPixels(frame.slot) here
+				rc = client.Release(frame.slot);
+			}
+			received++;
+		}
+
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if (rc == RC_SUCCESS)
+		{
+			fprintf(stdout, "%9u %9.3f %11.2f\n", depth, seconds, frames / seconds);
+		}
+	}
+
+	client.Quit();
+	waitpid(pid, nullptr, 0);
+	return rc;
+}
+
+// Requests count frames and waits for them without releasing any, fails if two of them got the same slot
+static RETURN_CODE holdFrames(RenderServerClient& client, unsigned count, std::vector<unsigned>& slots)
+{
+	std::vector<bool> held(client.GetRingHeader().slotCount, false);
+	uint32_t          requestId;
+	SERVER_FRAME      frame;
+
+	slots.clear();
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (client.RequestFrame(0, i, requestId) != RC_SUCCESS)
+		{
+			return RC_IO_ERROR;
+		}
+	}
+	for (unsigned i = 0; i < count; i++)
+	{
+		if (client.WaitFrame(frame) != RC_SUCCESS || frame.rc != RC_SUCCESS || frame.slot >= held.size())
+		{
+			fprintf(stderr, "frame %u of %u failed\n", i, count);
+			return RC_FAILURE;
+		}
+		if (held[frame.slot])
+		{
+			fprintf(stderr, "slot %u was handed out twice\n", frame.slot);
+			return RC_FAILURE;
+		}
+		held[frame.slot] = true;
+		slots.push_back(frame.slot);
+	}
+	return RC_SUCCESS;
+}
+
+RETURN_CODE TestRenderServer()
+{
+	std::string           address = "unix:/tmp/meshviewer-" + std::to_string(getpid()) + "-test.sock";
+	BatchScene            scene;
+	RenderServerClient    client;
+	pid_t                 pid;
+	std::vector<unsigned> slots;
+
+	RETURN_CODE rc = scene.LoadFromMemory("size 64 48\n", "test-server");
+	if (rc == RC_SUCCESS)
+	{
+		rc = startServer(scene, 1, address, client, pid);
+	}
+	if (rc != RC_SUCCESS)
+	{
+		return rc;
+	}
+	unsigned slotCount = client.GetRingHeader().slotCount;
+
+	// render and release, then release the same slot again and one the client never got
+	rc = holdFrames(client, 1, slots);
+	if (rc == RC_SUCCESS)
+	{
+		client.Release(slots[0]);
+		client.Release(slots[0]);
+		client.Release((slots[0] + 1) % slotCount);
+		rc = client.Release(slotCount);
+	}
+	// the bad releases must not have added slots, every frame of a full ring needs its own
+	if (rc == RC_SUCCESS)
+	{
+		rc = holdFrames(client, slotCount, slots);
+	}
+
+	// a client that disconnects holding the whole ring, the next one has to get every slot again
+	if (rc == RC_SUCCESS)
+	{
+		RenderServerClient next;
+		client.Disconnect();
+		rc = next.Connect(address);
+		if (rc == RC_SUCCESS)
+		{
+			rc = holdFrames(next, slotCount, slots);
+		}
+		for (unsigned slot : slots)
+		{
+			next.Release(slot);
+		}
+		next.Quit();
+	}
+	else
+	{
+		client.Quit();
+	}
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	if (rc == RC_SUCCESS && (!WIFEXITED(status) || WEXITSTATUS(status) != RC_SUCCESS))
+	{
+		rc = RC_FAILURE;
+	}
+	fprintf(stdout, "render server with %u ring slots: %s\n", slotCount, rc == RC_SUCCESS ? "slot bookkeeping ok" : "FAILED");
+	return rc;
+}
+
+#endif
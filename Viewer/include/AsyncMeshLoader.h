@@ -0,0 +1,75 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "MeshAsset.h"
+#include "ThreadPool.h"
+
+#define ASYNC_LOAD_THREADS               2
+#define ASYNC_UPLOAD_BUDGET_BYTES        (4 * 1024 * 1024)   // per frame, about a millisecond of buffer writes
+#define ASYNC_PROGRESSIVE_MIN_BYTES      (16 * 1024 * 1024)  // files from this size on are worth a preview
+
+/*
+ * AsyncMeshLoader class. Loads obj files without stalling the render loop: parsing, normalization and building
+ * the buffer data of every level run on worker threads, the render thread then copies the result to MeshBuffer
+ * in pieces of at most a budget of bytes per Update. A mesh larger than the budget spreads over several frames
+ * and is only handed out once it is complete, its levels of detail included.
+ *
+ * Progressive loads hand out stand-ins before that: first a voxel preview from vertices sampled all over the file
+ * (MeshAsset::LoadPreview, ready long before the file is parsed), then, once it is parsed, each level of detail
+ * as soon as it is uploaded, coarsest first. The final result is the complete asset.
+ */
+class AsyncMeshLoader
+{
+public:
+    struct Result
+    {
+        std::string path;
+        PMeshAsset  asset;  // nullptr if the file could not be read
+        bool        bFinal; // false for the stand-ins of a progressive load, more results of the path follow
+    };
+
+private:
+    struct Job
+    {
+        std::string                path;
+        std::shared_ptr<MeshAsset> asset;
+        bool                       bFailed;
+        bool                       bPreview;    // a stand-in of a progressive load, not the file's asset
+        bool                       bProgressive;
+        // the levels of detail of the asset coarsest first, then the asset, each uploaded to a range of its own
+        std::vector<MeshAsset*>    levels;
+        size_t                     level;
+        // buffer data of each of the levels, built by the worker; freed as the levels are uploaded
+        std::vector<std::vector<MESH_VERTEX> > vertices;
+        std::vector<std::vector<GLuint> >      indices;
+        bool                       bReserved;
+        MESH_RANGE                 range;
+        size_t                     verticesWritten;
+        size_t                     indicesWritten;
+    };
+
+    std::mutex                        m_mutex;
+    std::deque<std::unique_ptr<Job> > m_parsed;     // waiting for the render thread
+    std::unique_ptr<Job>              m_uploading;
+    unsigned                          m_pending;    // submitted, not yet handed out
+    // last, its destructor waits for the running parses before the queue goes away
+    ThreadPool                        m_pool;
+
+    void parse(Job* job);
+    void queue(Job* job);
+
+public:
+    explicit AsyncMeshLoader(unsigned threads = ASYNC_LOAD_THREADS);
+    ~AsyncMeshLoader();
+    AsyncMeshLoader(const AsyncMeshLoader&) = delete;
+    AsyncMeshLoader& operator=(const AsyncMeshLoader&) = delete;
+
+    // bProgressive: hand out stand-ins while the file loads, see above
+    void Load(const std::string& path, bool bProgressive = false);
+    // Render thread, GL context current. Appends the meshes that finished, in the order they finished.
+    void Update(size_t budgetBytes, std::vector<Result>& finished);
+
+    unsigned GetPendingCount();
+};
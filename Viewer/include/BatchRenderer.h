@@ -0,0 +1,192 @@
+#pragma once
+
+#include <map>
+#include <tuple>
+#include <memory>
+#include <functional>
+#include "ThreadPool.h"
+#include "Defs.h"
+#include "Renderer.h"
+#include "MeshModel.h"
+#include "Light.h"
+#include "Camera.h"
+
+/*
+ * Headless batch rendering. A BatchScene is loaded from a line based scene description, a BatchRenderer
+ * draws it with the software Renderer (no window, no GL context) and writes the frames as PNG or QOI files.
+ *
+ * Scene description, one keyword per line, '#' starts a comment:
+ *   size w h                                   frame dimensions
+ *   background r g b
+ *   material name ar ag ab ai dr dg db di sr sg sb si shininess
+ *   use name                                   selects a defined material for the following models
+ *   model path.obj | primitive sphere|cube|teapot
+ *   translate x y z | scale s | rotate x|y|z degrees       applies to the last model
+ *   transform i tx ty tz rx ry rz s            replaces the transformation of model i (rotation in degrees, x then y then z)
+ *   clear                                      removes all models and empties the mesh cache
+ *   light point|parallel|area x y z ar ag ab ai dr dg db di sr sg sb si
+ *   camera ex ey ez ax ay az ux uy uz
+ *   lookat i ex ey ez ax ay az ux uy uz        re-aims camera i
+ *   ortho left right bottom top near far | perspective fovy_degrees near far     applies to the last camera
+ *   shading none|solid|flat|gouraud|phong
+ *   wireframe 0|1
+ *   post none|blur|bloom kernelX kernelY sigma [intensity threshold]
+ *   frames n                                   frames rendered per camera
+ *   spin degrees                               rotation of all models around y between frames
+ *   lod pixels                                 screen space error the levels of detail of the meshes may show (default
+ *                                              MESH_LOD_ERROR_PIXELS), 0 draws every model in full
+ *   output prefix [png|pngfast|qoi]            frames are written to prefix_c<camera>_f<frame>.png (or .qoi, see QoiImage.h),
+ *                                              pngfast trades some file size for a parallel encode (lodepng::encodeFast)
+ *
+ * A BatchScene is read-only while rendering, so any number of BatchRenderers, each with its own frame
+ * buffers, can draw it at the same time. ParallelBatchRenderer runs one per pool thread.
+ */
+
+typedef struct _BATCH_SETTINGS
+{
+    int          width;
+    int          height;
+    glm::vec4    bgColor;
+    SHADING_TYPE shading;
+    bool         bWireframe;
+    POST_EFFECT  postEffect;
+    int          blurX;
+    int          blurY;
+    float        sigma;
+    float        bloomIntensity;
+    float        bloomThreshold;
+    unsigned     frames;
+    float        spinDegrees;
+    float        lodErrorPixels;
+    std::string  outputPrefix;
+    IMAGE_FORMAT imageFormat;
+}BATCH_SETTINGS, *PBATCH_SETTINGS;
+
+typedef struct _BATCH_CAMERA
+{
+    Camera*            pCamera;
+    glm::vec3          eye;
+    // perspective projections take their aspect from the frame size when rendering
+    bool               bPerspective;
+    PERSPECTIVE_PARAMS perspective;
+}BATCH_CAMERA, *PBATCH_CAMERA;
+
+class BatchScene
+{
+private:
+    std::map<std::string, Surface> m_materials;
+    Surface                        m_currentMaterial;
+    std::vector<Model*>            m_models;
+    std::vector<Light*>            m_lights;
+    std::vector<BATCH_CAMERA>      m_cameras;
+    BATCH_SETTINGS                 m_settings;
+    std::string                    m_description;
+    // contents of the obj files of the 'model' lines, keyed by the path in the description
+    std::map<std::string, std::string> m_meshCache;
+
+    RETURN_CODE parseLine(const std::string& lineType, std::istringstream& issLine);
+    void        addDefaultCamera();
+
+public:
+    BatchScene();
+    ~BatchScene();
+
+    // Reads a scene description, see above. Adds a default camera if the file has none.
+    RETURN_CODE Load(const std::string& fileName);
+    // Same from a description in memory. 'model' files already in the mesh cache are not read from disk.
+    RETURN_CODE LoadFromMemory(const std::string& description, const std::string& sourceName);
+    // Applies one description line to the loaded scene, used to edit it between renders. Not recorded in GetDescription().
+    RETURN_CODE ApplyLine(const std::string& line);
+    // Provides the content of a 'model' file up front, used by render workers that get the scene over the network
+    void        AddMesh(const std::string& path, const std::string& objData) { m_meshCache[path] = objData; }
+
+    const std::string&                        GetDescription() const { return m_description; }
+    const std::map<std::string, std::string>& GetMeshCache()   const { return m_meshCache;   }
+
+    BATCH_SETTINGS&                  GetSettings()         { return m_settings; }
+    const std::vector<Model*>&       GetModels()     const { return m_models;   }
+    const std::vector<Light*>&       GetLights()     const { return m_lights;   }
+    const std::vector<BATCH_CAMERA>& GetCameras()    const { return m_cameras;  }
+};
+
+class BatchRenderer
+{
+private:
+    Renderer                   m_renderer;
+    // scratch of Model::Draw, reused between models and frames
+    std::tuple<std::vector<Face>, std::vector<glm::vec3>, std::vector<glm::vec3>, std::vector<glm::vec3> > m_modelData;
+    // RGBA8 frame as read back from the renderer, rows bottom-up
+    std::vector<unsigned char> m_pixels;
+    // the same frame top-down, as PNG stores it
+    std::vector<unsigned char> m_image;
+    // RGBA8 of the last RenderTile, rows bottom-up
+    std::vector<unsigned char> m_tilePixels;
+    STAGE_TIMINGS              m_timings;
+
+    // clears and draws all models, no post effect and readback
+    void draw(BatchScene& scene, unsigned cameraIdx, unsigned frame);
+
+public:
+    BatchRenderer(const BATCH_SETTINGS& settings);
+
+    // Picks up changed background, shading, wireframe and post effect settings
+    void ApplySettings(const BATCH_SETTINGS& settings);
+    // Renders frame 'frame' of camera 'cameraIdx' and reads it back to GetPixels(), or to pPixels (width*height RGBA8) when given
+    void RenderFrame(BatchScene& scene, unsigned cameraIdx, unsigned frame, unsigned char* pPixels = nullptr);
+    // Renders only the rectangle [x0,x1) x [y0,y1) of a frame to GetTilePixels(), with the same pixels
+    // RenderFrame gives there. The post effect is skipped, it needs the pixels around the tile.
+    void RenderTile(BatchScene& scene, unsigned cameraIdx, unsigned frame, int x0, int y0, int x1, int y1);
+    // Encodes the last rendered frame to a PNG or QOI file. encodeThreads is for IF_PNG_FAST, 0 uses every core.
+    RETURN_CODE WriteImage(const std::string& fileName, IMAGE_FORMAT format, unsigned encodeThreads = 0);
+    // Encodes bottom-up RGBA8 pixels to a file, image is scratch space for the flipped rows PNG needs
+    static RETURN_CODE WriteImage(const std::string& fileName, const std::vector<unsigned char>& pixels, unsigned width, unsigned height,
+        IMAGE_FORMAT format, std::vector<unsigned char>& image, unsigned encodeThreads = 0);
+    // File name of a frame according to the output prefix and image format
+    static std::string FrameFileName(const BATCH_SETTINGS& settings, unsigned cameraIdx, unsigned frame);
+
+    const std::vector<unsigned char>& GetPixels()  const { return m_pixels;  }
+    const std::vector<unsigned char>& GetTilePixels() const { return m_tilePixels; }
+    const STAGE_TIMINGS&              GetTimings() const { return m_timings; }
+    Renderer&                         GetRenderer()      { return m_renderer; }
+};
+
+// Receives finished frames, RGBA8 with rows bottom-up
+typedef std::function<RETURN_CODE(unsigned cameraIdx, unsigned frame, const std::vector<unsigned char>& pixels)> FRAME_SINK;
+
+/*
+ * Renders all cameras x frames of a scene on a thread pool, one BatchRenderer per worker.
+ * Work units are single frames, ordered camera by camera, so a turntable spreads its frames over the
+ * workers and a multi-camera still its cameras. PNGs are encoded by the workers, the optional sink
+ * still sees the frames strictly in unit order.
+ */
+class ParallelBatchRenderer
+{
+private:
+    BatchScene&                                  m_scene;
+    ThreadPool                                   m_pool;
+    std::vector<std::unique_ptr<BatchRenderer> > m_renderers;
+
+    // reordering of finished frames for the sink
+    std::mutex                                       m_orderMutex;
+    std::map<unsigned, std::vector<unsigned char> >  m_pending;
+    unsigned                                         m_nextUnit;
+    bool                                             m_bDelivering;
+    RETURN_CODE                                      m_result;
+
+    void renderUnit(unsigned workerIdx, unsigned unit, bool bWriteImages, const FRAME_SINK& sink);
+    void deliver(unsigned unit, std::vector<unsigned char>& pixels, const FRAME_SINK& sink);
+
+public:
+    // threadCount 0 uses one thread per hardware thread
+    ParallelBatchRenderer(BatchScene& scene, unsigned threadCount = 0);
+
+    // Renders every frame of every camera, writes them as image files if asked and hands them to sink in order.
+    // Returns the first failure of any unit.
+    RETURN_CODE Render(bool bWriteImages, const FRAME_SINK& sink = nullptr);
+
+    // Stage times summed over all workers, i.e. CPU time rather than wall time
+    STAGE_TIMINGS GetTimings() const;
+    // Memory traffic of the post effect of the last frame, all zero when none ran
+    POST_TRAFFIC  GetPostEffectTraffic() const;
+    unsigned      GetThreadCount() const { return m_pool.GetThreadCount(); }
+};
@@ -4,6 +4,7 @@
 #include <GLFW/glfw3.h>
 #include <string>
 #include <stdlib.h>
+#include <stdint.h>
 #include <vector>
 #include <glm/glm.hpp>
 #include <iostream>
@@ -12,6 +13,13 @@
 #include "glm/common.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 
+// windows.h (included by glad on Windows) defines these, the headless renderer also builds on POSIX
+#ifndef _WIN32
+typedef int BOOL;
+#define IN
+#define OUT
+#endif
+
 
 #define VIEW_SCALING                     300.f
 
@@ -19,6 +27,13 @@
 #define DEFAULT_WIDTH                    1280
 #define MAX_HEIGHT_4K                    2160
 #define MAX_WIDTH_4K                     3840
+#define MAX_HEIGHT_8K                    4320
+#define MAX_WIDTH_8K                     7680
+
+#define WIREFRAME_WIDTH                  1.5f
+#define FRAME_ARENA_ALIGNMENT            64
+#define FRAME_ARENA_HUGE_PAGE_SIZE       (2 * 1024 * 1024)
+#define FRAME_TILE_SIZE                  32
 
 #define CAMERA_OBJ_FILE                  "PrimModels/camera.obj"
 #define LIGHT_OBJ_FILE                   "PrimModels/sphere_test.obj"
@@ -27,6 +42,7 @@
 #define PI                               3.141592653589793238462643383279502884L
 #define COLOR_BUF_INDEX(width,x,y,c)     ((x)+(y)*(width))*3+(c)
 #define Z_BUF_INDEX(width,x,y)           ((x)+(y)*(width))
+#define EDGE_KEY(v1,v2)                  ((((unsigned long long)(v1)) << 32) | ((unsigned long long)(v2)))
 #define FACE_ELEMENTS                    3
 #define TO_RADIAN(angle)                 ((angle) * PI / 180.0f)
 #define ZERO_MATRIX                      { {0,0,0,0},{ 0,0,0,0 },{ 0,0,0,0 },{ 0,0,0,0 } }
@@ -158,7 +174,8 @@ enum RETURN_CODE
     RC_SUCCESS = 0,
     RC_FAILURE,
     RC_UNDEFINED,
-    RC_IO_ERROR
+    RC_IO_ERROR,
+    RC_INVALID_PARAM
 
 };
 
@@ -190,6 +207,12 @@ typedef struct _PERSPECTIVE_PARAMS
     GLfloat zFar;
 }PERSPECTIVE_PARAMS, *PPERSPECTIVE_PARAMS;
 
+typedef struct _EDGE
+{
+    unsigned int v1;
+    unsigned int v2;
+}EDGE, *PEDGE;
+
 typedef struct _CUBE
 {
     std::pair<glm::vec3, glm::vec3> lines[12];
@@ -211,6 +234,143 @@ typedef enum _POST_EFFECT
     BLOOM
 }POST_EFFECT, *PPOST_EFFECT;
 
+typedef enum _POST_STAGE
+{
+    PS_CLAMP = 0,   // clamps the scene color to [0,1]
+    PS_BLOOM_SOURCE // clamped color, pixels above the bloom threshold are boosted by the bloom intensity
+}POST_STAGE, *PPOST_STAGE;
+
+typedef struct _POST_TRAFFIC
+{
+    size_t fullFrameBytes;  // bytes of full resolution targets read and written per frame
+    size_t scratchBytes;    // size of the row ring the separable blur works in
+    size_t legacyBytes;     // full resolution traffic of the former unfused passes for the same effect
+}POST_TRAFFIC, *PPOST_TRAFFIC;
+
+typedef enum _COLOR_FORMAT
+{
+    CF_RGB32F = 0,  // planar 3 x float, 12 bytes per pixel
+    CF_RGB16F,      // planar 3 x half float, 6 bytes per pixel
+    CF_RGBA8        // packed 8 bit RGBA, 4 bytes per pixel, clamped to [0,1]
+}COLOR_FORMAT, *PCOLOR_FORMAT;
+
+typedef enum _NORMAL_WEIGHTING
+{
+    NW_ANGLE = 0,   // every face counts with its corner angle at the vertex, independent of the tessellation
+    NW_AREA         // every face counts with its area, large faces dominate
+}NORMAL_WEIGHTING, *PNORMAL_WEIGHTING;
+
+typedef enum _DEPTH_FORMAT
+{
+    DF_32F = 0,     // float, 4 bytes per pixel
+    DF_24,          // unorm, planar 16 bit high + 8 bit low, 3 bytes per pixel
+    DF_16           // unorm, 2 bytes per pixel
+}DEPTH_FORMAT, *PDEPTH_FORMAT;
+
+typedef enum _RENDER_STAGE
+{
+    RS_CLEAR = 0,   // lazy clear of the color and depth targets
+    RS_LIGHTING,    // collecting the model faces and attaching the lights to them
+    RS_RASTER,      // transformation, shading and scan conversion, wireframe edges
+    RS_POST,        // post effect
+    RS_READBACK,    // packing the displayed buffer to RGBA8
+    RS_ENCODE,      // PNG encoding and writing the file
+    RS_COUNT
+}RENDER_STAGE, *PRENDER_STAGE;
+
+typedef struct _STAGE_TIMINGS
+{
+    double   seconds[RS_COUNT];   // accumulated over all frames
+    unsigned frames;
+    size_t   triangles;           // drawn over all frames, at the level of detail each model was drawn with
+}STAGE_TIMINGS, *PSTAGE_TIMINGS;
+
+typedef enum _IMAGE_FORMAT
+{
+    IF_PNG = 0,     // lodepng, deflate compressed
+    IF_PNG_FAST,    // lodepng::encodeFast, a somewhat larger PNG deflated on several threads
+    IF_QOI          // QoiImage, single pass, several times faster to write and read
+}IMAGE_FORMAT, *PIMAGE_FORMAT;
+
+typedef enum _VIDEO_FORMAT
+{
+    VF_Y4M = 0,     // YUV4MPEG2, 4:2:0 full range BT.601 (C420jpeg)
+    VF_RGB          // headerless rgb24, rows top-down
+}VIDEO_FORMAT, *PVIDEO_FORMAT;
+
+typedef struct _VIDEO_SINK_STATS
+{
+    unsigned frames;
+    uint64_t bytes;
+    double   convertSeconds;    // color conversion, on the render loop
+    double   stallSeconds;      // render loop waiting for a free buffer
+    double   writeSeconds;      // on the writer thread
+    unsigned buffers;           // buffers the sink ended up with
+}VIDEO_SINK_STATS, *PVIDEO_SINK_STATS;
+
+typedef struct _MESH_ASSET_STATS
+{
+    unsigned loads;     // obj sources parsed
+    unsigned shared;    // models that got an already loaded asset
+    unsigned live;      // assets still held by a model
+}MESH_ASSET_STATS, *PMESH_ASSET_STATS;
+
+// What the import pass of a mesh (MeshOptimizer) removed
+typedef struct _MESH_IMPORT_STATS
+{
+    unsigned verticesIn;
+    unsigned verticesOut;   // after welding duplicates and dropping unused vertices
+    unsigned trianglesIn;
+    unsigned trianglesOut;  // after dropping degenerate ones
+}MESH_IMPORT_STATS, *PMESH_IMPORT_STATS;
+
+// Vertex of the static geometry buffer (MeshBuffer), one per triangle corner, quantized (see VertexCodec.h)
+typedef struct _MESH_VERTEX
+{
+    GLshort position[4];    // xyz snorm16 of the [-1,1] model coordinates, w the corner of the triangle (0-2) whose
+                            // barycentric coordinate the vertex shader makes for the wireframe overlay
+    GLshort normal[2];      // octahedral snorm16
+}MESH_VERTEX, *PMESH_VERTEX;
+
+// Where a mesh lives in the static geometry buffer
+typedef struct _MESH_RANGE
+{
+    GLint  baseVertex;
+    GLuint vertexCount;
+    GLuint firstIndex;
+    GLuint indexCount;
+}MESH_RANGE, *PMESH_RANGE;
+
+// Per instance vertex attributes of the instanced mesh draw (vshader.glsl locations 3-6 and 7)
+typedef struct _MESH_INSTANCE
+{
+    glm::mat4x4 model;
+    GLuint      material;   // texel of the material buffer
+}MESH_INSTANCE, *PMESH_INSTANCE;
+
+typedef struct _INSTANCING_STATS
+{
+    unsigned drawCalls;     // one per mesh and texture
+    unsigned instances;
+    unsigned triangles;     // of all instances, at the level of detail each was drawn with
+    size_t   vertexBytes;   // vertex data the draws fetch, every instance reads the vertices of its mesh
+    unsigned materials;
+    size_t   uploadBytes;   // instance and material data sent this frame, 0 while nothing moves
+    unsigned programBinds;  // state changes issued this frame, the draws are sorted to keep them low
+    unsigned vertexArrayBinds;
+    unsigned textureBinds;
+    unsigned instanceRebinds;   // instance attributes pointed at the next group's slice of the instance buffer
+}INSTANCING_STATS, *PINSTANCING_STATS;
+
+typedef struct _TEXTURE_STATS
+{
+    unsigned textures;      // held by at least one model
+    unsigned pending;       // decoding, or decoded and waiting for their upload
+    unsigned shared;        // ApplyTexture calls that got an already loaded texture
+    size_t   cpuBytes;      // decoded texels not uploaded yet, freed once on the GPU
+    size_t   gpuBytes;      // resident textures including their mipmaps
+}TEXTURE_STATS, *PTEXTURE_STATS;
+
 // 
 // typedef struct _GUI_CONFIG
 // {
@@ -17,12 +17,12 @@ public:
     int m_shininess;
 
     Surface() : m_material("Empty"),
-        m_ambientReflectionRate(1.f),
         m_ambientColor(COLOR(BLACK)),
-        m_diffuseReflectionRate(1.f),
         m_diffuseColor(COLOR(BLACK)),
-        m_specularReflectionRate(0.2f),
         m_specularColor(COLOR(BLACK)),
+        m_ambientReflectionRate(1.f),
+        m_diffuseReflectionRate(1.f),
+        m_specularReflectionRate(0.2f),
         m_shininess(1)
     {}
     Surface(const std::string& material, 
@@ -31,9 +31,8 @@ public:
             const glm::vec4& specularC, float specularI,
             int shininess) :
             m_material(material),
-            m_ambientColor(ambientC), m_ambientReflectionRate(ambientI),
-            m_diffuseColor(diffusiveC), m_diffuseReflectionRate(diffusiveI),
-            m_specularColor(specularC), m_specularReflectionRate(specularI),
+            m_ambientColor(ambientC), m_diffuseColor(diffusiveC), m_specularColor(specularC),
+            m_ambientReflectionRate(ambientI), m_diffuseReflectionRate(diffusiveI), m_specularReflectionRate(specularI),
             m_shininess(shininess) {}
     Surface(const Surface& surf) : 
         Surface(surf.m_material,
@@ -41,6 +40,7 @@ public:
         surf.m_diffuseColor, surf.m_diffuseReflectionRate,
         surf.m_specularColor, surf.m_specularReflectionRate,
         surf.m_shininess) {}
+    Surface& operator=(const Surface&) = default;
 
     ~Surface() = default;
 
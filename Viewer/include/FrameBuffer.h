@@ -0,0 +1,390 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include "Defs.h"
+
+/*
+ * Render targets of the software renderer in a selectable storage format.
+ * Pixels are addressed by their linear index Z_BUF_INDEX(width, x, y).
+ * All targets of a renderer live in one FrameArena, every plane starts on a FRAME_ARENA_ALIGNMENT boundary.
+ */
+
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint32_t sign     = (bits >> 16) & 0x8000;
+    int32_t  exponent = static_cast<int32_t>((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (((bits >> 23) & 0xFF) == 0xFF)
+    {
+        // inf / nan
+        return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+    if (exponent >= 31)
+    {
+        return static_cast<uint16_t>(sign | 0x7C00);
+    }
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+        {
+            return static_cast<uint16_t>(sign);
+        }
+        // denormal half
+        mantissa |= 0x800000;
+        uint32_t shift    = static_cast<uint32_t>(14 - exponent);
+        uint32_t half     = mantissa >> shift;
+        uint32_t rest     = mantissa & ((1u << shift) - 1);
+        uint32_t halfway  = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+        {
+            half++;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    // round to nearest even, a carry into the exponent is the correct result
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+    {
+        half++;
+    }
+    return static_cast<uint16_t>(half);
+}
+
+inline float halfToFloat(uint16_t half)
+{
+    uint32_t sign     = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1F;
+    uint32_t mantissa = half & 0x3FF;
+    uint32_t bits;
+
+    if (exponent == 0)
+    {
+        if (mantissa == 0)
+        {
+            bits = sign;
+        }
+        else
+        {
+            // denormal half, normalize it
+            exponent = 113;
+            while (!(mantissa & 0x400))
+            {
+                mantissa <<= 1;
+                exponent--;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FF) << 13);
+        }
+    }
+    else if (exponent == 31)
+    {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    }
+    else
+    {
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+inline uint8_t floatToUnorm8(float value)
+{
+    value = value > 0.f ? (value < 1.f ? value : 1.f) : 0.f;
+    return static_cast<uint8_t>(value * 255.f + 0.5f);
+}
+
+/*
+ * One block of FRAME_ARENA_ALIGNMENT aligned memory that render targets are carved from.
+ * The block only grows (geometrically), so shrinking or re-growing a window reuses it.
+ */
+class FrameArena
+{
+private:
+    unsigned char* m_block;
+    size_t         m_capacity;
+    size_t         m_offset;
+    bool           m_bHugePages;
+    bool           m_bMapped;
+    // number of times the block was (re)allocated
+    size_t         m_allocations;
+
+    void release();
+
+public:
+    FrameArena();
+    ~FrameArena();
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Bytes a request of size bytes occupies inside the arena
+    static size_t AlignedSize(size_t bytes) { return (bytes + FRAME_ARENA_ALIGNMENT - 1) & ~static_cast<size_t>(FRAME_ARENA_ALIGNMENT - 1); }
+
+    // Makes sure bytes are available and drops all previous sub allocations.
+    // Views taken before a call to Reset are invalid after it.
+    void Reset(size_t bytes);
+    // Carves an aligned, uninitialized sub allocation
+    void* Take(size_t bytes);
+
+    // Back large blocks by transparent huge pages where the OS supports it. Applies to the next growth.
+    void        UseHugePages(bool bUse) { m_bHugePages = bUse; }
+    size_t      GetCapacity()           const { return m_capacity; }
+    const void* GetBlock()              const { return m_block; }
+    size_t      GetAllocationCount()    const { return m_allocations; }
+};
+
+/*
+ * Typed window into a FrameArena. Data() is always FRAME_ARENA_ALIGNMENT aligned, so SIMD kernels may use aligned loads.
+ */
+template <typename T>
+class AlignedView
+{
+private:
+    T*     m_data;
+    size_t m_count;
+
+public:
+    AlignedView() : m_data(nullptr), m_count(0) {}
+
+    void Attach(FrameArena& arena, size_t count)
+    {
+        m_data  = static_cast<T*>(arena.Take(count * sizeof(T)));
+        m_count = count;
+    }
+    void Detach() { m_data = nullptr; m_count = 0; }
+
+    static size_t ArenaBytes(size_t count) { return FrameArena::AlignedSize(count * sizeof(T)); }
+
+    T*       Data()       { return m_data; }
+    const T* Data() const { return m_data; }
+    size_t   Size() const { return m_count; }
+    T&       operator[](size_t idx)       { return m_data[idx]; }
+    const T& operator[](size_t idx) const { return m_data[idx]; }
+};
+
+/*
+ * Both target types clear lazily: Clear only marks every FRAME_TILE_SIZE^2 tile as pending.
+ * A pending tile is filled with the clear value the first time a pixel in it is written,
+ * reads of a pending tile return the clear value and presentation writes it straight to the output.
+ */
+class ColorTarget
+{
+private:
+    COLOR_FORMAT m_format;
+    size_t       m_pixelCount;
+    int          m_width;
+    int          m_height;
+    int          m_tilesX;
+    // clear value as it reads back from m_format
+    glm::vec3    m_clearColor;
+
+    // CF_RGB32F, one plane per channel
+    AlignedView<float>    m_planes32f[3];
+    // CF_RGB16F, one plane per channel
+    AlignedView<uint16_t> m_planes16f[3];
+    // CF_RGBA8
+    AlignedView<uint32_t> m_rgba8;
+    // one byte per tile, set while the tile logically holds m_clearColor
+    AlignedView<uint8_t>  m_tilePending;
+
+    inline size_t tileOf(int x, int y) const { return (y / FRAME_TILE_SIZE) * m_tilesX + x / FRAME_TILE_SIZE; }
+    void materializeTile(size_t tile);
+
+    inline void store(size_t idx, const glm::vec3& color)
+    {
+        switch (m_format)
+        {
+        case CF_RGB16F:
+            m_planes16f[0][idx] = floatToHalf(color.x);
+            m_planes16f[1][idx] = floatToHalf(color.y);
+            m_planes16f[2][idx] = floatToHalf(color.z);
+            break;
+        case CF_RGBA8:
+            m_rgba8[idx] = packRGBA8(color);
+            break;
+        default:
+            m_planes32f[0][idx] = color.x;
+            m_planes32f[1][idx] = color.y;
+            m_planes32f[2][idx] = color.z;
+            break;
+        }
+    }
+
+    inline glm::vec3 load(size_t idx) const
+    {
+        switch (m_format)
+        {
+        case CF_RGB16F:
+            return { halfToFloat(m_planes16f[0][idx]), halfToFloat(m_planes16f[1][idx]), halfToFloat(m_planes16f[2][idx]) };
+        case CF_RGBA8:
+        {
+            uint32_t packed = m_rgba8[idx];
+            return glm::vec3(packed & 0xFF, (packed >> 8) & 0xFF, (packed >> 16) & 0xFF) * (1.f / 255.f);
+        }
+        default:
+            return { m_planes32f[0][idx], m_planes32f[1][idx], m_planes32f[2][idx] };
+        }
+    }
+
+    static inline uint32_t packRGBA8(const glm::vec3& color)
+    {
+        return static_cast<uint32_t>(floatToUnorm8(color.x))
+             | static_cast<uint32_t>(floatToUnorm8(color.y)) << 8
+             | static_cast<uint32_t>(floatToUnorm8(color.z)) << 16
+             | 0xFF000000u;
+    }
+
+    // Convert count resolved pixels starting at first, with one format switch per span
+    void readSpan(size_t first, size_t count, glm::vec3* rgb) const;
+    void writeSpan(size_t first, size_t count, const glm::vec3* rgb);
+    void packSpan(size_t first, size_t count, unsigned char* rgba) const;
+
+public:
+    ColorTarget();
+    ColorTarget(const ColorTarget&) = delete;
+    ColorTarget& operator=(const ColorTarget&) = delete;
+
+    // Takes the storage from arena and clears it to zero
+    void Attach(FrameArena& arena, int width, int height, COLOR_FORMAT format);
+    void Detach();
+    // Arena bytes a target of [width,height] needs
+    static size_t ArenaBytes(int width, int height, COLOR_FORMAT format);
+
+    COLOR_FORMAT GetFormat()     const { return m_format; }
+    int          GetWidth()      const { return m_width; }
+    int          GetHeight()     const { return m_height; }
+    size_t       GetPixelCount() const { return m_pixelCount; }
+    size_t       GetBytes()      const;
+    static size_t BytesPerPixel(COLOR_FORMAT format);
+
+    // Raw storage, only meaningful after Resolve
+    const AlignedView<float>&    GetPlane32F(int c)   const { return m_planes32f[c]; }
+    const AlignedView<uint16_t>& GetPlane16F(int c)   const { return m_planes16f[c]; }
+    const AlignedView<uint32_t>& GetRGBA8()           const { return m_rgba8; }
+
+    inline void Write(int x, int y, const glm::vec3& color)
+    {
+        size_t tile = tileOf(x, y);
+        if (m_tilePending[tile])
+        {
+            materializeTile(tile);
+        }
+        store(Z_BUF_INDEX(m_width, x, y), color);
+    }
+
+    inline glm::vec3 Read(int x, int y) const
+    {
+        return m_tilePending[tileOf(x, y)] ? m_clearColor : load(Z_BUF_INDEX(m_width, x, y));
+    }
+
+    // Row versions of Read and Write for the post effects, the format is dispatched once per row
+    void ReadRow(int y, glm::vec3* rgb) const;
+    void WriteRow(int y, const glm::vec3* rgb);
+
+    // Sets all pixels to color, in O(tiles)
+    void Clear(const glm::vec3& color);
+    // Fills every pending tile so the raw storage holds the whole frame
+    void Resolve();
+    // Converts the whole target to RGBA8 for presentation, pending tiles are written as the clear color
+    void PackRGBA8(unsigned char* rgba) const;
+    // Same for the rectangle [x0,x1) x [y0,y1) only, rgba receives (x1-x0)*(y1-y0) tightly packed pixels
+    void PackRGBA8(unsigned char* rgba, int x0, int y0, int x1, int y1) const;
+};
+
+class DepthTarget
+{
+private:
+    DEPTH_FORMAT m_format;
+    size_t       m_pixelCount;
+    int          m_width;
+    int          m_height;
+    int          m_tilesX;
+
+    // DF_32F
+    AlignedView<float>    m_depth32f;
+    // DF_16 and the high 16 bits of DF_24
+    AlignedView<uint16_t> m_depthHigh;
+    // low 8 bits of DF_24
+    AlignedView<uint8_t>  m_depthLow;
+    // one byte per tile, set while the tile logically holds the cleared depth
+    AlignedView<uint8_t>  m_tilePending;
+
+    inline size_t tileOf(int x, int y) const { return (y / FRAME_TILE_SIZE) * m_tilesX + x / FRAME_TILE_SIZE; }
+    void materializeTile(size_t tile);
+
+    // Maps [-1,1] to [1, maxValue], 0 is kept for the cleared (-inf) depth
+    static inline uint32_t quantize(float depth, uint32_t maxValue)
+    {
+        float normalized = (depth + 1.f) * 0.5f;
+        normalized = normalized > 0.f ? (normalized < 1.f ? normalized : 1.f) : 0.f;
+        return 1 + static_cast<uint32_t>(normalized * (maxValue - 1) + 0.5f);
+    }
+
+public:
+    DepthTarget();
+    DepthTarget(const DepthTarget&) = delete;
+    DepthTarget& operator=(const DepthTarget&) = delete;
+
+    // Takes the storage from arena and clears it
+    void Attach(FrameArena& arena, int width, int height, DEPTH_FORMAT format);
+    void Detach();
+    // Arena bytes a target of [width,height] needs
+    static size_t ArenaBytes(int width, int height, DEPTH_FORMAT format);
+
+    DEPTH_FORMAT GetFormat() const { return m_format; }
+    size_t       GetBytes()  const;
+    static size_t BytesPerPixel(DEPTH_FORMAT format);
+
+    // Raw storage, only meaningful after Resolve
+    const AlignedView<float>&    GetDepth32F()  const { return m_depth32f; }
+    const AlignedView<uint16_t>& GetDepthHigh() const { return m_depthHigh; }
+    const AlignedView<uint8_t>&  GetDepthLow()  const { return m_depthLow; }
+
+    // Stores depth if it is not behind the current value (bigger is closer)
+    inline bool TestAndSet(int x, int y, float depth)
+    {
+        size_t tile = tileOf(x, y);
+        if (m_tilePending[tile])
+        {
+            materializeTile(tile);
+        }
+
+        size_t idx = Z_BUF_INDEX(m_width, x, y);
+        switch (m_format)
+        {
+        case DF_16:
+        {
+            uint16_t quantized = static_cast<uint16_t>(quantize(depth, 0xFFFF));
+            if (quantized < m_depthHigh[idx]) return false;
+            m_depthHigh[idx] = quantized;
+            return true;
+        }
+        case DF_24:
+        {
+            uint32_t quantized = quantize(depth, 0xFFFFFF);
+            uint32_t stored    = (static_cast<uint32_t>(m_depthHigh[idx]) << 8) | m_depthLow[idx];
+            if (quantized < stored) return false;
+            m_depthHigh[idx] = static_cast<uint16_t>(quantized >> 8);
+            m_depthLow[idx]  = static_cast<uint8_t>(quantized & 0xFF);
+            return true;
+        }
+        default:
+            if (depth < m_depth32f[idx]) return false;
+            m_depth32f[idx] = depth;
+            return true;
+        }
+    }
+
+    // Resets all pixels to -inf, in O(tiles)
+    void Clear();
+    // Fills every pending tile so the raw storage holds the whole frame
+    void Resolve();
+};
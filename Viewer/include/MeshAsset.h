@@ -0,0 +1,126 @@
+#pragma once
+
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "Face.h"
+
+#define MESH_PREVIEW_SAMPLES             16384    // places of the file LoadPreview reads a vertex from
+#define MESH_PREVIEW_PROBE_LINES         4        // lines read at each place looking for a vertex
+#define MESH_PREVIEW_GRID                32       // voxels along each axis of the [-1,1] cube
+
+/*
+ * MeshAsset class. The geometry of an obj file as every MeshModel drawing it needs it: the normalized vertices,
+ * the triangles, the unique edges and, with a GL context, its range of the shared MeshBuffer. An asset never changes once it is
+ * loaded, the instances only add their own transformations and Surface on top of it.
+ *
+ * The faces of an asset point to no Surface, MeshModel::Draw attaches the one of the instance.
+ *
+ * Meshes large enough carry a chain of coarser levels of detail built by MeshSimplifier, each with about half the
+ * triangles of the one before and an estimate of its distance to the full mesh. SelectLod picks the coarsest level
+ * whose estimated error stays within a number of pixels on screen.
+ */
+class MeshAsset
+{
+public:
+    std::vector<glm::vec3> m_vertices;
+    std::vector<glm::vec3> m_vertexNormals;
+    // triangle corners, FACE_ELEMENTS per polygon
+    std::vector<glm::vec3> m_vertexPositions;
+    std::vector<Face>      m_polygons;
+    // Unique (undirected) edges of the mesh, indices into m_vertices
+    std::vector<EDGE>      m_edges;
+    MESH_IMPORT_STATS      m_importStats;
+
+    glm::vec3 m_modelCentroid;
+    glm::vec3 m_minCoords;
+    glm::vec3 m_maxCoords;
+
+    // in MeshBuffer, only once uploaded (never without a GL context)
+    bool       m_bUploaded;
+    MESH_RANGE m_range;
+
+    // coarser levels, finest first; a level has no levels of its own
+    std::vector<std::unique_ptr<MeshAsset> > m_lods;
+    // estimated distance of the surface to the full mesh, in normalized model units (0 for the full mesh)
+    float                                    m_lodError;
+
+    MeshAsset();
+    ~MeshAsset();
+    MeshAsset(const MeshAsset&) = delete;
+    MeshAsset& operator=(const MeshAsset&) = delete;
+
+    // bOptimize runs the MeshOptimizer import pass: duplicate vertices welded, degenerate triangles dropped,
+    // then builds the levels of detail
+    void LoadStream(std::istream& objStream, bool bOptimize = true);
+    // A blocky stand-in for a file too large to wait for: reads vertices at MESH_PREVIEW_SAMPLES places spread
+    // over the stream (no need to parse it all, the stream has to be seekable) and covers the voxels they fall
+    // into. Normalized like LoadStream would, from the sample. No polygons if no vertex was found.
+    void LoadPreview(std::istream& objStream);
+    // bytes held by the CPU side geometry, its levels of detail included unless bLods is false
+    size_t GetMemoryBytes(bool bLods = true) const;
+    // The vertices and indices Upload copies to MeshBuffer, no GL needed
+    void BuildBufferData(std::vector<MESH_VERTEX>& vertices, std::vector<GLuint>& indices) const;
+    // Copies the triangles to MeshBuffer, the levels of detail as well, needs the GL context current
+    void Upload();
+
+    // The coarsest level whose estimated error projects to at most errorPixels: mvp takes the model coordinates to clip
+    // space, pixelsPerNdc is half the viewport. errorPixels 0 always selects the full mesh.
+    const MeshAsset& SelectLod(const glm::mat4x4& mvp, const glm::vec2& pixelsPerNdc, float errorPixels) const;
+
+private:
+    // faces, corners and edges of the triangles over m_vertices; normals are generated without bHasNormals
+    void build(const std::vector<GLuint>& triangles, bool bHasNormals);
+    void buildLods(const std::vector<GLuint>& triangles);
+};
+
+using PMeshAsset = std::shared_ptr<const MeshAsset>;
+
+/*
+ * MeshAssetRegistry class. Shares the assets between the models: the first Acquire of a path parses the file
+ * (and uploads it when a shader program is given), every further one while a model still holds the asset is
+ * a lookup. The registry only keeps weak references, the asset goes away with the last model using it.
+ * Thread safe. The lock is only taken to look an asset up and to publish it, the file is parsed outside of it; an
+ * Acquire of a key that another thread is loading waits for that load instead of parsing the file again.
+ */
+class MeshAssetRegistry
+{
+private:
+    struct Entry
+    {
+        std::weak_ptr<const MeshAsset> asset;
+        size_t                         sourceHash;  // of the obj text for in-memory sources, 0 for files
+        std::shared_future<PMeshAsset> loading;     // valid while a thread loads the asset
+    };
+
+    std::mutex                   m_mutex;
+    std::map<std::string, Entry> m_assets;
+    MESH_ASSET_STATS             m_stats;
+    bool                         m_bOptimizeImports;
+
+    MeshAssetRegistry();
+    PMeshAsset store(const std::string& key, size_t sourceHash, PMeshAsset asset);
+    // The shared asset of key, else one loaded by load(asset, bOptimize) outside the lock and uploaded when program is not 0
+    PMeshAsset acquire(const std::string& key, size_t sourceHash, GLuint program, const std::function<void(MeshAsset&, bool)>& load);
+
+public:
+    static MeshAssetRegistry& Instance();
+
+    // Exits like the former MeshModel::LoadFile if the file cannot be opened. program 0: no GL upload.
+    PMeshAsset Acquire(const std::string& path, GLuint program);
+    // obj text already in memory, e.g. a mesh shipped to a render worker. key names it like a path; an asset
+    // with the same key but a different text is loaded anew.
+    PMeshAsset Acquire(const std::string& key, const std::string& objData, GLuint program);
+
+    // The asset of a file if some model still holds it (uploaded when program is not 0), else nullptr
+    PMeshAsset Find(const std::string& path, GLuint program);
+    // An asset of a file loaded elsewhere, e.g. by AsyncMeshLoader; later Acquires of the path share it
+    PMeshAsset Register(const std::string& path, PMeshAsset asset);
+
+    // Whether the following loads run the import pass (on by default); assets already loaded stay as they are
+    void SetImportOptimization(bool bOptimize);
+
+    MESH_ASSET_STATS GetStats();
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include "Defs.h"
+
+#define MESH_BUFFER_INITIAL_VERTICES     (64 * 1024)
+#define MESH_BUFFER_INITIAL_INDICES      (64 * 1024)
+
+/*
+ * MeshBuffer class. One vertex and one index buffer holding every uploaded mesh, behind a single VAO, so drawing
+ * a different mesh only changes the base vertex and first index of the draw call. Ranges of meshes that are
+ * removed are reused first fit; the buffers grow by copying on the GPU when nothing fits.
+ *
+ * The VAO has the MESH_VERTEX attributes 0 (position and triangle corner), 1 (texture coordinate, the position's
+ * xy) and 2 (octahedral normal), all 16 bit integers the vertex shader decodes. Needs the GL context current,
+ * lives as long as the program.
+ */
+class MeshBuffer
+{
+private:
+    typedef std::pair<size_t, size_t> SPAN;    // first element, count
+
+    GLuint            m_VAO;
+    GLuint            m_vertexBuffer;
+    GLuint            m_indexBuffer;
+    size_t            m_vertexCapacity;
+    size_t            m_vertexEnd;          // elements past the last range are unused
+    size_t            m_indexCapacity;
+    size_t            m_indexEnd;
+    std::vector<SPAN> m_freeVertices;
+    std::vector<SPAN> m_freeIndices;
+
+    MeshBuffer();
+    ~MeshBuffer();
+
+    void   create();
+    // first element of count free ones, grows the buffer if needed
+    size_t allocate(std::vector<SPAN>& freeSpans, size_t& end, size_t& capacity, size_t count, GLenum target, size_t elementSize);
+    static void release(std::vector<SPAN>& freeSpans, size_t& end, SPAN span);
+    void   bindVertexAttributes();
+
+public:
+    static MeshBuffer& Instance();
+
+    MeshBuffer(const MeshBuffer&) = delete;
+    MeshBuffer& operator=(const MeshBuffer&) = delete;
+
+    // indices are relative to the first vertex of the mesh
+    MESH_RANGE Add(const std::vector<MESH_VERTEX>& vertices, const std::vector<GLuint>& indices);
+    void       Remove(const MESH_RANGE& range);
+
+    // Add in steps, e.g. to spread a large mesh over several frames: the range is allocated first and filled
+    // piecewise, first is relative to the start of the range
+    MESH_RANGE Reserve(size_t vertexCount, size_t indexCount);
+    void       WriteVertices(const MESH_RANGE& range, size_t first, const MESH_VERTEX* vertices, size_t count);
+    void       WriteIndices(const MESH_RANGE& range, size_t first, const GLuint* indices, size_t count);
+
+    GLuint GetVAO() const { return m_VAO; }
+    size_t GetVertexCapacity() const { return m_vertexCapacity; }
+    size_t GetIndexCapacity() const { return m_indexCapacity; }
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <map>
+#include "MeshModel.h"
+
+/*
+ * MeshInstancer class. Draws the models of a frame with one glDrawElementsInstancedBaseVertex per mesh asset and
+ * texture instead of one draw per model. All meshes live in the MeshBuffer behind one VAO, the per instance model
+ * matrices and material indices of all groups in one instance buffer; a draw only moves the instance attributes
+ * to its group's slice. The materials (ambient color times rate) are a texture buffer the fragment shader fetches
+ * from. The groups are drawn sorted by texture, then mesh, and only state that differs from the previous draw is
+ * set. The buffers are only written when their contents differ from the previous frame. A model may be drawn with
+ * one of the levels of detail of its mesh, the levels group like separate meshes.
+ * On Mesa llvmpipe the 10000 cube stress test takes about 14 ms to submit against 20 ms with one draw per cube;
+ * at 1280x720 both are bound by the rasterization (about 72 ms a frame), so the gain shows on small viewports only.
+ *
+ * Usage per frame: Begin, Add every visible model, Draw. Needs the GL context current throughout.
+ */
+class MeshInstancer
+{
+private:
+    // the draw order: texture first, binding one costs more than moving to another mesh
+    typedef std::pair<GLuint, const MeshAsset*> GROUP_KEY;
+
+    struct Group
+    {
+        PMeshAsset                 asset;       // keeps the mesh alive as long as the group draws it
+        const MeshAsset*           mesh;        // the asset or one of its levels
+        std::vector<MESH_INSTANCE> instances;
+    };
+
+    typedef std::tuple<float, float, float, float> MATERIAL_KEY;
+
+    std::map<GROUP_KEY, Group>     m_groups;
+    GROUP_KEY                      m_lastKey;      // consecutive models mostly share the mesh and the material
+    Group*                         m_lastGroup;
+    std::vector<MESH_INSTANCE>     m_instances;    // of all groups in draw order
+    std::vector<MESH_INSTANCE>     m_uploadedInstances;
+    GLuint                         m_instanceBuffer;
+    size_t                         m_instanceCapacity;
+    std::vector<glm::vec4>         m_materials;
+    std::vector<glm::vec4>         m_uploadedMaterials;
+    std::map<MATERIAL_KEY, GLuint> m_materialIndex;
+    GLuint                         m_materialBuffer;
+    GLuint                         m_materialTexture;
+    INSTANCING_STATS               m_stats;
+
+    GLuint materialIndex(const Surface& surface);
+    void   uploadInstances();
+    void   uploadMaterials();
+    void   pointInstanceAttributes(size_t firstInstance);
+
+public:
+    MeshInstancer();
+    ~MeshInstancer();
+    MeshInstancer(const MeshInstancer&) = delete;
+    MeshInstancer& operator=(const MeshInstancer&) = delete;
+
+    void Begin();
+    // level: one of the levels of detail of the model's asset, nullptr for the full mesh
+    void Add(const MeshModel& model, const glm::mat4x4& transformation, const MeshAsset* level = nullptr);
+    // Groups without instances this frame are released
+    void Draw(GLuint program);
+
+    const INSTANCING_STATS& GetStats() const { return m_stats; }
+};
@@ -2,28 +2,21 @@
 
 
 #include "Model.h"
+#include "MeshAsset.h"
+#include "TextureManager.h"
 
 
 /*
  * MeshModel class. Mesh model object represents a triangle mesh (loaded fron an obj file).
+ * The geometry is a MeshAsset shared by all models of the same file, see MeshAssetRegistry.
  * 
  */
 
 class MeshModel : public Model
 {
 	protected :
-        GLuint VAO;
-        GLuint VBO;
-        GLuint TEX;
-
-        size_t m_verticesSize;
-        glm::vec3 *m_vertices;
-        size_t m_verticesNormSize;
-        Face *m_polygons;
-		size_t m_polygonsSize;
-        glm::vec3 *m_vertexNormals;
-        size_t m_vPositionsSize;
-        glm::vec3* m_vertexPositions;
+        PMeshAsset m_asset;
+        PTexture   m_texture;
 
 		// Add more attributes.
         glm::mat4x4 m_scaleTransformation;
@@ -38,6 +31,9 @@ class MeshModel : public Model
 	public:
         Surface m_surface;
 		MeshModel(const std::string& fileName, const Surface& material, GLuint program);
+		// Parses obj data that is already in memory, e.g. a mesh shipped to a render worker
+		MeshModel(std::istream& objStream, const Surface& material, GLuint program);
+		MeshModel(PMeshAsset asset, const Surface& material, GLuint program);
 		~MeshModel();
 
         const glm::mat4x4& GetModelTransformation() override;
@@ -47,19 +43,30 @@ class MeshModel : public Model
 		const glm::mat4x4& GetWorldTransformation() override;
 		const glm::mat4x4& GetNormalTransformation() override;
 
-        void SetModelTransformation(glm::mat4x4& transformation) override;
-        void SetScaleTransformation(glm::mat4x4& transformation) override;
-        void SetTranslateTransformation(glm::mat4x4& transformation) override;
-        void SetRotateTransformation(glm::mat4x4& transformation) override;
-		void SetWorldTransformation(glm::mat4x4& transformation) override;
-		void SetNormalTransformation(glm::mat4x4& transformation) override;
+        void SetModelTransformation(const glm::mat4x4& transformation) override;
+        void SetScaleTransformation(const glm::mat4x4& transformation) override;
+        void SetTranslateTransformation(const glm::mat4x4& transformation) override;
+        void SetRotateTransformation(const glm::mat4x4& transformation) override;
+		void SetWorldTransformation(const glm::mat4x4& transformation) override;
+		void SetNormalTransformation(const glm::mat4x4& transformation) override;
 
 		void LoadFile(const std::string& fileName, GLuint program);
+		void LoadStream(std::istream& objStream, GLuint program);
+		// Replaces the geometry, e.g. a placeholder once the real mesh finished loading
+		void SetAsset(PMeshAsset asset);
+		const PMeshAsset& GetAsset() const { return m_asset; }
+		// 0 until the texture of ApplyTexture is resident on the GPU
+		GLuint GetTexture() const { return m_texture ? m_texture->GetName() : 0; }
 		void Draw(std::tuple<std::vector<Face>, std::vector<glm::vec3>, std::vector<glm::vec3>, std::vector<glm::vec3> >& modelData) override;
+		// Same with one of the levels of detail of the asset, see MeshAsset::SelectLod
+		void DrawLevel(std::tuple<std::vector<Face>, std::vector<glm::vec3>, std::vector<glm::vec3>, std::vector<glm::vec3> >& modelData, const MeshAsset& level);
         glm::vec3 getCentroid() override { return  m_modelCentroid; }
+        const std::vector<EDGE>& getEdges() override { return m_asset->m_edges; }
 
         void ApplyTexture(std::string path) override;
 private:
+    // member initialization shared by the constructors, loads nothing
+    MeshModel(const Surface& material, GLuint program);
     GLuint m_cur_prog;
 };
 
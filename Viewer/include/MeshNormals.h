@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include "Defs.h"
+#include "ThreadPool.h"
+
+#define MESH_NORMALS_CREASE_ANGLE        60.f     // degrees, sharper edges between two faces keep separate normals
+#define MESH_NORMALS_MIN_PARALLEL_FACES  (32 * 1024)
+
+/*
+ * MeshNormals class. Smooth normals for meshes whose obj file has none. Every vertex gets the weighted average
+ * of the normals of its faces; a triangle corner only averages the faces around its vertex that meet its own face
+ * at less than the crease angle, so hard edges stay hard.
+ *
+ * The work runs in parallel over faces and vertices on a pool the caller keeps, meshes are normalized level by
+ * level and a pool per call would cost more than the normals of the small levels. Each output is written by
+ * exactly one task, summing its faces in index order, so the result is bitwise the same for any thread count.
+ */
+class MeshNormals
+{
+public:
+    // triangles holds FACE_ELEMENTS vertex indices per face. vertexNormals gets one normal per vertex,
+    // cornerNormals one per entry of triangles. Without pPool, or below MESH_NORMALS_MIN_PARALLEL_FACES, it runs
+    // on the calling thread. Other callers may share the pool, but it must not be the one the caller runs on.
+    static void Generate(const std::vector<glm::vec3>& vertices, const std::vector<GLuint>& triangles, NORMAL_WEIGHTING weighting,
+                         float creaseAngle, std::vector<glm::vec3>& vertexNormals, std::vector<glm::vec3>& cornerNormals,
+                         ThreadPool* pPool = nullptr);
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include "Defs.h"
+
+#define MESH_WELD_TOLERANCE              1e-5f    // in normalized model coordinates, i.e. [-1,1]
+#define MESH_WELD_NORMAL_TOLERANCE       1e-3f    // vertices with a different normal in the file stay apart
+#define MESH_DEGENERATE_AREA             1e-10f   // twice the triangle area below which a triangle is dropped
+
+/*
+ * MeshOptimizer class. The import pass of MeshAsset. Obj exports often repeat vertices and contain triangles
+ * without area. Optimize welds the vertices closer than a tolerance through a spatial hash, drops the degenerate
+ * triangles and renumbers the vertices in the order the triangles first use them, keeping the face order of the
+ * file. Welding is what lets MeshSimplifier build the levels of detail; --bench-import shows no measurable raster
+ * gain of the pass itself on the bundled models. The GPU buffers stay one vertex per triangle corner (see
+ * MeshAsset::BuildBufferData), so neither the weld nor the face order changes the vertex shader work.
+ */
+class MeshOptimizer
+{
+private:
+    // old vertex index -> welded one
+    static void weld(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, std::vector<GLuint>& remap);
+
+public:
+    // triangles holds FACE_ELEMENTS vertex indices per face. normals, if not empty, are per vertex like the
+    // positions (missing ones count as zero) and are renumbered with them.
+    static MESH_IMPORT_STATS Optimize(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<GLuint>& triangles);
+};
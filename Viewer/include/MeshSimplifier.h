@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+#include "Defs.h"
+
+#define MESH_LOD_MIN_TRIANGLES           256      // meshes and levels below this are not simplified further
+#define MESH_LOD_MAX_LEVELS              8
+#define MESH_LOD_ERROR_PIXELS            1.f      // default visual error budget, 0 always draws the full mesh
+#define MESH_SIMPLIFY_BOUNDARY_WEIGHT    100.f    // keeps open borders in place
+#define MESH_SIMPLIFY_MIN_FLIP_DOT       0.2f     // collapses turning a face by more than ~78 degrees are refused
+
+/*
+ * MeshSimplifier class. Quadric error metric edge collapse (Garland & Heckbert): every vertex sums the planes of
+ * its faces, collapsing an edge moves both ends to the point with the smallest squared distance to the planes of
+ * both, cheapest edge first. Collapses that fold a face over are skipped, borders are held by extra planes
+ * perpendicular to them.
+ */
+class MeshSimplifier
+{
+public:
+    // Collapses edges until at most targetTriangles remain (or nothing can collapse). triangles holds
+    // FACE_ELEMENTS vertex indices per face. Returns an estimate of how far the simplified surface is from the
+    // input one, in the units of the vertices: the largest distance of a moved vertex to the planes it gathered,
+    // not a bound (the faces between the vertices may stray further). Unused vertices are dropped from the output.
+    static float Simplify(const std::vector<glm::vec3>& vertices, const std::vector<GLuint>& triangles, size_t targetTriangles,
+                          std::vector<glm::vec3>& outVertices, std::vector<GLuint>& outTriangles);
+};
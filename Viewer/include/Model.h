@@ -16,17 +16,18 @@ public:
     virtual const     glm::mat4x4& GetRotateTransformation()                                                             = 0;
     virtual const     glm::mat4x4& GetWorldTransformation()                                                              = 0;
     virtual const     glm::mat4x4& GetNormalTransformation()                                                             = 0;
-    virtual void      SetModelTransformation(glm::mat4x4& transformation)                                                = 0;
-    virtual void      SetScaleTransformation(glm::mat4x4& transformation)                                                      = 0;
-    virtual void      SetTranslateTransformation(glm::mat4x4& transformation)                                                  = 0;
-    virtual void      SetRotateTransformation(glm::mat4x4& transformation)                                                     = 0;
-    virtual void      SetWorldTransformation(glm::mat4x4& transformation)                                                = 0;
-	virtual void      SetNormalTransformation(glm::mat4x4& transformation)                                               = 0;
+    virtual void      SetModelTransformation(const glm::mat4x4& transformation)                                          = 0;
+    virtual void      SetScaleTransformation(const glm::mat4x4& transformation)                                                = 0;
+    virtual void      SetTranslateTransformation(const glm::mat4x4& transformation)                                            = 0;
+    virtual void      SetRotateTransformation(const glm::mat4x4& transformation)                                               = 0;
+    virtual void      SetWorldTransformation(const glm::mat4x4& transformation)                                          = 0;
+	virtual void      SetNormalTransformation(const glm::mat4x4& transformation)                                         = 0;
     virtual void      ApplyTexture(std::string texPath)                                                                       = 0;
 	
     
     virtual void Draw(std::tuple<std::vector<Face>, std::vector<glm::vec3>, std::vector<glm::vec3>, std::vector<glm::vec3> >& modelData) = 0;
     virtual glm::vec3 getCentroid()                                                                                      = 0;
+    virtual const std::vector<EDGE>& getEdges()                                                                    = 0;
 
     bool isModelRenderingActive()                               { return m_bShouldRender; }
     void setModelRenderingState(bool bIsRenderingStateActive)   { m_bShouldRender = bIsRenderingStateActive; }
@@ -40,10 +41,6 @@ public:
 
 protected:
 
-    GLuint m_tex_width;
-    GLuint m_tex_height;
-    unsigned char* m_tex_data;
-
     bool m_bShouldRender;
     CUBE m_cubeLines;
 
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+#include "Defs.h"
+#include "FrameBuffer.h"
+
+/*
+ * Post effect graph of the software renderer.
+ * An effect is compiled to a list of per-pixel stages followed by a separable gaussian blur.
+ * The per-pixel stages are fused into the blur's row fetch, and the blur keeps only kernel-height rows of
+ * horizontally blurred pixels, so the whole effect reads the scene once and writes the destination once.
+ */
+class PostProcess
+{
+private:
+    POST_EFFECT             m_effect;
+    int                     m_kernelSizeX;
+    int                     m_kernelSizeY;
+    float                   m_sigma;
+    float                   m_bloomIntensity;
+    glm::vec3               m_bloomWeights;
+    float                   m_bloomThreshold;
+
+    std::vector<POST_STAGE> m_fetchStages;
+    std::vector<float>      m_kernelX;
+    std::vector<float>      m_kernelY;
+
+    // source row after the fetch stages, padded by half a kernel on both sides
+    std::vector<glm::vec3>  m_fetchRow;
+    // m_kernelY.size() horizontally blurred rows, row r lives in slot r % m_kernelY.size()
+    std::vector<glm::vec3>  m_rowRing;
+    // vertically blurred destination row, written with one WriteRow
+    std::vector<glm::vec3>  m_outRow;
+
+    POST_TRAFFIC            m_traffic;
+
+    static void makeKernel(std::vector<float>& kernel, int kernelSize, float sigma);
+
+    inline glm::vec3 applyFetchStages(const glm::vec3& color) const
+    {
+        glm::vec3 result = color;
+        for (POST_STAGE stage : m_fetchStages)
+        {
+            switch (stage)
+            {
+            case PS_CLAMP:
+                result = glm::clamp(result, 0.f, 1.f);
+                break;
+            case PS_BLOOM_SOURCE:
+            {
+                float boost = glm::dot(result, m_bloomWeights) > m_bloomThreshold ? 1.f + m_bloomIntensity : 1.f;
+                result = boost * glm::clamp(result, 0.f, 1.f);
+            } break;
+            }
+        }
+        return result;
+    }
+
+    // Fetches source row y and blurs it horizontally into out
+    void blurRow(const ColorTarget& source, int y, glm::vec3* out);
+
+public:
+    PostProcess();
+
+    // Rebuilds the graph, cheap when nothing changed
+    void Configure(POST_EFFECT effect, int kernelSizeX, int kernelSizeY, float sigma, float bloomIntensity, const glm::vec3& bloomWeights, float bloomThreshold);
+    // False when the configured effect leaves the scene untouched
+    bool IsActive() const { return m_effect != NONE && (m_kernelSizeX > 2 || m_kernelSizeY > 2); }
+    // Runs the effect from source into destination, both of the same dimensions
+    void Apply(const ColorTarget& source, ColorTarget& destination);
+
+    // Memory traffic of the last Apply
+    const POST_TRAFFIC& GetTraffic() const { return m_traffic; }
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Defs.h"
+
+#define QOI_HEADER_SIZE                  14
+#define QOI_PADDING_SIZE                 8
+#define QOI_MAX_PIXELS                   400000000   // rejects headers that would not fit in memory anyway
+#define QOI_CACHE_EXTENSION              ".qoi"
+
+/*
+ * Lossless RGBA8 images in the QOI format (qoiformat.org): one pass, no entropy coder, each pixel is a run,
+ * an index into the 64 recently seen colors, a small difference to the previous pixel or the literal value.
+ * Files are somewhat larger than PNG, but encode and decode many times faster, which is what frame dumps
+ * and the texture cache need. Pixels are RGBA8 with rows top-down unless stated otherwise.
+ */
+class QoiImage
+{
+public:
+    // bBottomUp reads the rows of rgba last to first, for frames as the renderer reads them back
+    static void        Encode(const unsigned char* rgba, unsigned width, unsigned height, std::vector<unsigned char>& out, bool bBottomUp = false);
+    // Takes 3 and 4 channel files, always returns RGBA8. Fails on data that ends before the last pixel,
+    // an op running into the end marker or a wrong end marker.
+    static RETURN_CODE Decode(const unsigned char* data, size_t size, std::vector<unsigned char>& rgba, unsigned& width, unsigned& height);
+
+    // Writes a temporary file and renames it over fileName, a failed write leaves no file behind
+    static RETURN_CODE WriteFile(const std::string& fileName, const unsigned char* rgba, unsigned width, unsigned height, bool bBottomUp = false);
+    static RETURN_CODE ReadFile(const std::string& fileName, std::vector<unsigned char>& rgba, unsigned& width, unsigned& height);
+
+    // Decodes a PNG through a QOI copy next to it (path + QOI_CACHE_EXTENSION). The copy is written on the first
+    // load and read instead of the PNG as long as it is newer; a copy that cannot be written is not an error.
+    static RETURN_CODE LoadPngCached(const std::string& pngPath, std::vector<unsigned char>& rgba, unsigned& width, unsigned& height);
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <map>
+#include "BatchRenderer.h"
+#include "RenderNet.h"
+
+#define COORDINATOR_PIPELINE_DEPTH       2      // work units in flight per worker, hides the network round trip
+#define COORDINATOR_AUTO_TILE_SIZE       256    // tile size used when a render has too few frames to keep the workers busy
+#define COORDINATOR_UNIT_TIMEOUT         120.0  // seconds a worker may stay silent with units in flight before it counts as hung
+#define COORDINATOR_POLL_MS              1000   // longest wait for worker messages before the timeouts are checked
+
+typedef struct _COORDINATOR_STATS
+{
+    unsigned units;         // work units the render was split into
+    unsigned stolen;        // units a worker took from another worker's queue
+    unsigned retried;       // units sent again because their worker died
+    unsigned workersLost;
+    unsigned workersTimedOut;   // lost workers that stopped answering instead of disconnecting
+    double   seconds;
+}COORDINATOR_STATS, *PCOORDINATOR_STATS;
+
+/*
+ * Farms a BatchScene out to worker processes, local or on other nodes.
+ * Every worker gets the scene description and the mesh cache once, then work units: whole frames, or
+ * tiles of frames when there are not enough frames for all workers (tiles skip the post effect, so scenes with
+ * one are always split by frame). Units are dealt to the workers in contiguous runs, a worker whose run is done
+ * steals from the back of the longest remaining one. Units of a worker that dies, or that does not answer within the
+ * unit timeout, are put back and retried elsewhere; a worker that timed out is disconnected. Results are stitched
+ * into whole frames, which are passed to the sink as they complete.
+ */
+class RenderCoordinator
+{
+private:
+    typedef struct _WORKER
+    {
+        NetChannel           channel;
+        std::deque<unsigned> queue;     // units dealt to this worker, stolen from the back
+        std::deque<unsigned> inFlight;  // units sent and not yet answered
+        std::chrono::steady_clock::time_point lastHeard;    // last message, or the send that started the current wait
+        bool                 bReady;
+        bool                 bAlive;
+    }WORKER;
+
+    typedef struct _FRAME_ASSEMBLY
+    {
+        std::vector<unsigned char> pixels;  // RGBA8, rows bottom-up
+        unsigned                   missingUnits;
+    }FRAME_ASSEMBLY;
+
+    BatchScene&                 m_scene;
+    int                         m_tileSize;
+    double                      m_unitTimeout;
+    NetPayload                  m_scenePayload;
+    std::vector<WORKER>         m_workers;
+    std::vector<NET_WORK_UNIT>  m_units;
+    std::vector<bool>           m_unitDone;
+    std::map<unsigned, FRAME_ASSEMBLY> m_frames;   // keyed by cameraIdx * frames + frame
+    COORDINATOR_STATS           m_stats;
+
+    void        splitWork();
+    bool        nextUnit(size_t workerIdx, unsigned& unit);
+    RETURN_CODE feed(size_t workerIdx);
+    void        loseWorker(size_t workerIdx);
+    RETURN_CODE handleMessage(size_t workerIdx, const FRAME_SINK& sink);
+    void        expireWorkers();
+
+public:
+    // tileSize 0 always splits by frame, -1 picks tiles only when there are fewer frames than workers.
+    // unitTimeout has to be longer than the slowest unit takes to render.
+    RenderCoordinator(BatchScene& scene, int tileSize = -1, double unitTimeout = COORDINATOR_UNIT_TIMEOUT);
+
+    // Takes over a connected worker and sends it the scene
+    RETURN_CODE AddWorker(NetChannel&& channel);
+    // Renders every frame of every camera on the workers. Fails only when all workers are gone.
+    RETURN_CODE Render(const FRAME_SINK& sink);
+    // Tells the workers to exit
+    void        Shutdown();
+
+    const COORDINATOR_STATS& GetStats() const { return m_stats; }
+
+    // 64 bit FNV-1a of a frame, for comparing distributed and local renders
+    static uint64_t Checksum(const std::vector<unsigned char>& pixels);
+    // Starts 'executable --worker address' as a child process, the worker dies on purpose after failAfter units (0 = never),
+    // or with bHang stops answering while staying connected
+    static int SpawnLocalWorker(const std::string& executable, const std::string& address, unsigned failAfter = 0, bool bHang = false);
+};
+
+/*
+ * Worker side: connects to a coordinator, loads the scene it sends and renders units until told to quit.
+ */
+class RenderWorker
+{
+public:
+    // failAfter > 0 makes the worker exit without answering its failAfter+1'th unit, to exercise the retry path.
+    // With bHang it ignores that unit and everything after it until the coordinator drops it, to exercise the timeout.
+    static RETURN_CODE Run(const std::string& address, unsigned failAfter = 0, bool bHang = false);
+};
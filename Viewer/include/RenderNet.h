@@ -0,0 +1,147 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "Defs.h"
+
+/*
+ * Message transport of the distributed renderer and the render server, over Unix domain or TCP stream sockets (POSIX only).
+ * Addresses are "unix:/path/of/socket" or "tcp:host:port", host given as an IPv4 address.
+ * A message is a NET_MSG_HEADER followed by 'size' payload bytes. Values are sent in host byte order,
+ * coordinator and workers are expected to run on the same architecture.
+ */
+
+// Largest payload Receive accepts: an 8K RGBA8 result, with the same again for the meshes of a scene message.
+// A corrupt or hostile header must not make the receiver allocate whatever size it claims.
+#define NET_MAX_PAYLOAD_SIZE             (2ull * MAX_WIDTH_8K * MAX_HEIGHT_8K * 4)
+
+typedef enum _NET_MSG_TYPE
+{
+    NM_SCENE = 1,   // coordinator -> worker: scene description and mesh cache
+    NM_READY,       // worker -> coordinator: scene loaded, ready for work
+    NM_WORK,        // coordinator -> worker: one NET_WORK_UNIT
+    NM_RESULT,      // worker -> coordinator: the NET_WORK_UNIT followed by the RGBA8 pixels of its rectangle
+    NM_QUIT,        // coordinator -> worker: no more work, client -> render server: shut down
+    NM_HELLO,       // render server -> client: name of the shared memory frame ring
+    NM_COMMAND,     // client -> render server: one scene description line
+    NM_COMMAND_DONE,// render server -> client: RETURN_CODE of the command
+    NM_RENDER,      // client -> render server: one SERVER_RENDER_REQUEST
+    NM_FRAME,       // render server -> client: SERVER_FRAME, the pixels are in the ring slot
+    NM_RELEASE      // client -> render server: the client is done with a ring slot
+}NET_MSG_TYPE, *PNET_MSG_TYPE;
+
+typedef struct _NET_MSG_HEADER
+{
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t size;
+}NET_MSG_HEADER, *PNET_MSG_HEADER;
+
+typedef struct _NET_WORK_UNIT
+{
+    uint32_t unit;
+    uint32_t cameraIdx;
+    uint32_t frame;
+    // rectangle of the frame to render, the whole frame for frame units
+    int32_t  x0, y0, x1, y1;
+}NET_WORK_UNIT, *PNET_WORK_UNIT;
+
+// Payload of a message, written and read front to back
+class NetPayload
+{
+private:
+    std::vector<char> m_data;
+    size_t            m_readPos;
+
+public:
+    NetPayload() : m_readPos(0) {}
+
+    void PutBytes(const void* data, size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        m_data.insert(m_data.end(), bytes, bytes + size);
+    }
+    template<typename T> void Put(const T& value) { PutBytes(&value, sizeof(T)); }
+    void PutString(const std::string& str)
+    {
+        Put<uint64_t>(str.size());
+        PutBytes(str.data(), str.size());
+    }
+
+    bool GetBytes(void* data, size_t size)
+    {
+        if (m_readPos + size > m_data.size())
+        {
+            return false;
+        }
+        memcpy(data, m_data.data() + m_readPos, size);
+        m_readPos += size;
+        return true;
+    }
+    template<typename T> bool Get(T& value) { return GetBytes(&value, sizeof(T)); }
+    bool GetString(std::string& str)
+    {
+        uint64_t size;
+        if (!Get(size) || m_readPos + size > m_data.size())
+        {
+            return false;
+        }
+        str.assign(m_data.data() + m_readPos, static_cast<size_t>(size));
+        m_readPos += static_cast<size_t>(size);
+        return true;
+    }
+    // Unread bytes, e.g. the pixels after a NET_WORK_UNIT
+    const char* Remaining(size_t& size) const { size = m_data.size() - m_readPos; return m_data.data() + m_readPos; }
+
+    std::vector<char>&       Data()       { return m_data; }
+    const std::vector<char>& Data() const { return m_data; }
+    void Clear() { m_data.clear(); m_readPos = 0; }
+};
+
+// One connected stream socket
+class NetChannel
+{
+private:
+    int m_fd;
+
+public:
+    NetChannel() : m_fd(-1) {}
+    explicit NetChannel(int fd) : m_fd(fd) {}
+    NetChannel(NetChannel&& other) noexcept : m_fd(other.m_fd) { other.m_fd = -1; }
+    NetChannel& operator=(NetChannel&& other) noexcept;
+    NetChannel(const NetChannel&) = delete;
+    NetChannel& operator=(const NetChannel&) = delete;
+    ~NetChannel() { Close(); }
+
+    RETURN_CODE Connect(const std::string& address);
+    // Both block until the whole message is transferred. RC_IO_ERROR when the peer is gone or a payload
+    // exceeds NET_MAX_PAYLOAD_SIZE, after which the channel is closed since the stream is out of step.
+    RETURN_CODE Send(NET_MSG_TYPE type, const NetPayload& payload);
+    RETURN_CODE Receive(NET_MSG_TYPE& type, NetPayload& payload);
+    void        Close();
+
+    bool IsOpen() const { return m_fd >= 0; }
+    int  GetFd()  const { return m_fd; }
+};
+
+class NetListener
+{
+private:
+    int         m_fd;
+    std::string m_address;
+    std::string m_unixPath;
+
+public:
+    NetListener() : m_fd(-1) {}
+    ~NetListener();
+    NetListener(const NetListener&) = delete;
+    NetListener& operator=(const NetListener&) = delete;
+
+    // Port 0 of a tcp address picks a free port, GetAddress() then has the real one
+    RETURN_CODE Listen(const std::string& address);
+    RETURN_CODE Accept(NetChannel& channel);
+
+    const std::string& GetAddress() const { return m_address; }
+};
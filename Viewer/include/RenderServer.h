@@ -0,0 +1,150 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include "BatchRenderer.h"
+#include "RenderNet.h"
+
+#define SERVER_RING_SLOTS                8           // at least this many frames are handed out before the client has to release one
+#define SERVER_RING_MAGIC                0x474E5246  // "FRNG"
+#define SERVER_NO_SLOT                   0xFFFFFFFF
+
+typedef struct _FRAME_RING_HEADER
+{
+    uint32_t magic;
+    uint32_t slotCount;
+    uint32_t width;
+    uint32_t height;
+    uint64_t slotOffset;    // first slot, from the start of the mapping
+    uint64_t slotStride;    // page aligned
+}FRAME_RING_HEADER, *PFRAME_RING_HEADER;
+
+typedef struct _SERVER_RENDER_REQUEST
+{
+    uint32_t requestId;     // echoed in the SERVER_FRAME, chosen by the client
+    uint32_t cameraIdx;
+    uint32_t frame;         // spin step, see 'spin' of the scene description
+}SERVER_RENDER_REQUEST, *PSERVER_RENDER_REQUEST;
+
+typedef struct _SERVER_FRAME
+{
+    uint32_t requestId;
+    uint32_t slot;          // SERVER_NO_SLOT when the render failed
+    uint32_t rc;
+}SERVER_FRAME, *PSERVER_FRAME;
+
+/*
+ * POSIX shared memory holding a FRAME_RING_HEADER and slotCount RGBA8 frames, rows bottom-up.
+ * Which side owns a slot is decided by the messages: the server writes a slot, sends NM_FRAME and does not touch
+ * it again until the client sends NM_RELEASE, so the memory itself needs no synchronization.
+ */
+class SharedFrameRing
+{
+private:
+    std::string        m_name;
+    unsigned char*     m_pBase;
+    size_t             m_size;
+    bool               m_bOwner;
+
+public:
+    SharedFrameRing() : m_pBase(nullptr), m_size(0), m_bOwner(false) {}
+    ~SharedFrameRing() { Close(); }
+    SharedFrameRing(const SharedFrameRing&) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing&) = delete;
+
+    // Server side, the name is removed again when the ring is closed
+    RETURN_CODE Create(const std::string& name, unsigned slotCount, unsigned width, unsigned height);
+    // Client side
+    RETURN_CODE Open(const std::string& name);
+    void        Close();
+
+    const FRAME_RING_HEADER& GetHeader() const { return *reinterpret_cast<const FRAME_RING_HEADER*>(m_pBase); }
+    unsigned char*           GetSlot(unsigned slot) const { return m_pBase + GetHeader().slotOffset + GetHeader().slotStride * slot; }
+    const std::string&       GetName() const { return m_name; }
+};
+
+/*
+ * Render server for tools that drive the renderer without the UI, e.g. thumbnail generation.
+ * A client connects, gets the name of the frame ring (NM_HELLO) and then sends, in any mix:
+ *   NM_COMMAND  a scene description line (see BatchRenderer.h) applied to the scene, e.g. "clear", "model x.obj",
+ *               "transform 0 0 0 0 0 45 0 1", "lookat 0 2 2 2 0 0 0 0 1 0". Answered by NM_COMMAND_DONE.
+ *               The frame size is fixed when the server starts, 'size' is refused.
+ *   NM_RENDER   answered by NM_FRAME once the frame is in its ring slot
+ *   NM_RELEASE  gives a slot back; slots the client does not hold are ignored
+ *   NM_QUIT     stops the server
+ * Requests are handled in order, a client may send many without waiting for the answers. Up to one render per
+ * pool thread runs at a time; a command waits for the renders sent before it, since the scene is read-only while
+ * rendering. Frames may be answered out of order when several render at once.
+ * The slots a client still holds when it disconnects go back to the ring for the next one.
+ */
+class RenderServer
+{
+private:
+    typedef struct _PENDING_REQUEST
+    {
+        NET_MSG_TYPE          type;
+        SERVER_RENDER_REQUEST render;
+        std::string           command;
+    }PENDING_REQUEST;
+
+    BatchScene&                                 m_scene;
+    ThreadPool                                  m_pool;
+    std::vector<std::unique_ptr<BatchRenderer>> m_renderers;    // one per pool thread
+    SharedFrameRing                             m_ring;
+    std::vector<unsigned>                       m_freeSlots;
+    std::vector<bool>                           m_slotHeld;     // the client got the frame of the slot and has not released it
+    std::deque<PENDING_REQUEST>                 m_pending;
+    unsigned                                    m_inFlight;
+    // finished renders, handed from the pool threads to the socket loop; a byte on m_wakeFds wakes it
+    std::mutex                                  m_doneMutex;
+    std::vector<SERVER_FRAME>                   m_done;
+    int                                         m_wakeFds[2];
+    bool                                        m_bQuit;
+
+    RETURN_CODE dispatch(NetChannel& client);
+    RETURN_CODE sendFinished(NetChannel& client);
+    RETURN_CODE serveClient(NetChannel& client);
+    void        releaseSlot(uint32_t slot);
+    void        reclaimSlots();
+
+public:
+    // threads 0 uses every hardware thread
+    RenderServer(BatchScene& scene, unsigned threads = 0);
+    ~RenderServer();
+
+    // Serves clients one after the other until one sends NM_QUIT
+    RETURN_CODE Run(const std::string& address);
+};
+
+/*
+ * Client of a RenderServer. RequestFrame only sends, so several frames can be in flight; WaitFrame returns
+ * them as they arrive and the pixels stay valid in the ring until Release.
+ */
+class RenderServerClient
+{
+private:
+    NetChannel               m_channel;
+    SharedFrameRing          m_ring;
+    uint32_t                 m_nextRequestId;
+    // frames that arrived while Command waited for its answer
+    std::deque<SERVER_FRAME> m_frames;
+
+public:
+    RenderServerClient() : m_nextRequestId(0) {}
+
+    RETURN_CODE Connect(const std::string& address);
+    // Sends a scene description line and waits until the server applied it
+    RETURN_CODE Command(const std::string& line);
+    // Queues a render, returns the request id the frame will carry
+    RETURN_CODE RequestFrame(unsigned cameraIdx, unsigned frame, uint32_t& requestId);
+    RETURN_CODE WaitFrame(SERVER_FRAME& frame);
+    RETURN_CODE Release(unsigned slot);
+    // Stops the server
+    RETURN_CODE Quit();
+    // Leaves the server running, it takes back the slots this client did not release
+    void        Disconnect();
+
+    const unsigned char*     GetPixels(unsigned slot) const { return m_ring.GetSlot(slot); }
+    const FRAME_RING_HEADER& GetRingHeader()          const { return m_ring.GetHeader(); }
+};
@@ -3,6 +3,8 @@
 #include <GLFW/glfw3.h>
 #include <imgui/imgui.h>
 #include "Face.h"
+#include "FrameBuffer.h"
+#include "PostProcess.h"
 
 /*
  * Renderer class. This class takes care of all the rendering operations needed for rendering a full scene to the screen.
@@ -11,26 +13,31 @@
 class Renderer
 {
 private:
-    // 3*width*height
-    GLfloat *colorBuffer;
-    // 3*width*height
-    GLfloat *blurredBuffer;
-    // 3*width*height
-    GLfloat *bloomBuffer;
-    // 3*width*height
-    GLfloat *bloomDestBuff;
-    // width*height
-    GLfloat *zBuffer;
+    // No GL context is used: nothing is presented, frames are read back with ReadPixels
+    bool        m_bHeadless;
+    // backing memory of all the render targets below
+    FrameArena  m_frameArena;
+    // width*height pixels each, stored in m_colorFormat
+    ColorTarget colorBuffer;
+    // output of the post effect
+    ColorTarget blurredBuffer;
+    // width*height, stored in m_depthFormat
+    DepthTarget zBuffer;
+
+    COLOR_FORMAT m_colorFormat;
+    DEPTH_FORMAT m_depthFormat;
 
     
     // Screen dimensions
     int m_width, m_height;
+    // Rasterization is limited to [m_scissorX0,m_scissorX1) x [m_scissorY0,m_scissorY1)
+    int m_scissorX0, m_scissorY0, m_scissorX1, m_scissorY1;
 
     // Draws a pixel in location p with color color
-    void putPixel(int i, int j, float d, const glm::vec4& color, Face* face = nullptr );
+    void putPixel(int i, int j, float d, const glm::vec4& color);
     void putPixel(int x, int y, bool steep, float d, const glm::vec4& color);
     bool putZ(int x, int y, float d);
-    // creates float array of dimension [3,w,h]
+    // allocates the render targets for [w,h] in the current formats
     void createBuffers(int w, int h);
     //##############################
     //##openGL stuff. Don't touch.##
@@ -38,7 +45,10 @@ private:
     
     GLuint glScreenVtc;
     GLuint glScreenTex;
-    GLuint glVertices;
+    GLuint glScreenProgram;
+    // the displayed buffer packed to RGBA8 for the upload, reused between frames
+    std::vector<unsigned char> m_screenPixels;
+    // (Re)allocates the screen texture for the current dimensions
     void createOpenGLBuffer();
     void initOpenGLRendering();
     //##############################
@@ -48,6 +58,8 @@ private:
     glm::mat4x4       m_cameraProjection;
     glm::mat4x4       m_objectTransform;
     glm::mat4x4       m_normalTransform;
+    // m_cameraProjection * m_cameraTransform * m_worldTransformation * m_objectTransform
+    glm::mat4x4       m_fullTransform;
 
     PROJ_PARAMS       m_projParams;
 
@@ -62,7 +74,15 @@ private:
     SHADING_TYPE      m_shadingType;
     GENERATED_TEXTURE m_generatedTexture;
 
+    // DrawTriangles' vertices on the view plane, reused between calls
+    std::vector<glm::vec3> m_viewVertices;
+
     glm::vec3 toViewPlane(const glm::vec3& point);
+    // Full pipeline + view plane using the cached m_fullTransform
+    glm::vec3 projectToViewPlane(const glm::vec3& point);
+    void      updateFullTransform();
+    // Liang-Barsky clipping of the segment to the viewport. Returns false if nothing is left to draw.
+    bool      clipLine(glm::vec3& p1, glm::vec3& p2);
     Face      toViewPlane(Face polygon);
     glm::vec3 Barycentric(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c);
     BOOL      isPointInTriangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c);
@@ -79,7 +99,8 @@ private:
     bool        m_bBloomActive;
     POST_EFFECT m_ePostEffect;
     float       m_bloomIntensity;
-    float       * pDispBuffer;
+    const ColorTarget* pDispBuffer;
+    PostProcess m_postProcess;
 
     int         m_blurX;
     int         m_blurY;
@@ -93,19 +114,25 @@ public:
     GLfloat* mVerticesColors;
     unsigned mVerticesColorsSize;
     Renderer();
-    Renderer(int w, int h);
+    Renderer(int w, int h, bool bHeadless = false);
     ~Renderer();
     inline glm::vec3 processPipeline(glm::vec3 point, PIPE_TYPE pipeType = FULL, glm::mat4x4* lightTransform = nullptr);
     inline Face processPipeline(Face polygon, PIPE_TYPE pipeType = FULL, glm::mat4x4* lightTransform = nullptr);
     // Local initializations of your implementation
     void Init();
 
-    // Draws a line by Bresenham algorithm: 
+    // Draws a line by Bresenham algorithm, clipped to the viewport: 
     void DrawLine(const glm::vec3& p1, const glm::vec3& p2, const glm::vec4& color);
     void PolygonScanConversion(Face& polygon);
+    // Transforms model vertices through the full pipeline to the view plane, once per vertex
+    void TransformVertices(const std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& viewVertices);
+    // Draws the unique edges of a mesh using its already transformed vertices
+    void DrawEdges(const std::vector<glm::vec3>& viewVertices, const std::vector<EDGE>& edges);
     void drawVerticesNormals(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, float normScaleRate);
-    // Draws wireframe triangles to the color buffer
-    void DrawTriangles(const std::vector<Face>& vertices, const glm::vec3* modelCentroid = nullptr, const glm::vec3 eye = ZERO_VEC3);
+    // Fills triangles to the color buffer and outlines them when the wireframe is on. Given the mesh's vertices and
+    // unique edges, the wireframe is drawn from those (DrawEdges), every shared edge once, instead of per polygon.
+    void DrawTriangles(const std::vector<Face>& vertices, const glm::vec3* modelCentroid = nullptr, const glm::vec3 eye = ZERO_VEC3,
+                       const std::vector<glm::vec3>* meshVertices = nullptr, const std::vector<EDGE>* edges = nullptr);
 
     void CalculateLights(Face &polygon, Face &viewPolygon, const glm::vec3 eye);
 
@@ -126,14 +153,36 @@ public:
 
     // Swaps between the back buffer and front buffer, as explained in class.
     // https://en.wikipedia.org/wiki/Multiple_buffering#Double_buffering_in_computer_graphics
+    // The displayed buffer is packed to RGBA8 into the next PBO of the ring, uploaded to the
+    // screen texture and drawn as a fullscreen triangle.
     void SwapBuffers();
 
+    // Packs the displayed buffer (post effect output if one ran) to RGBA8, rows bottom-up like glReadPixels.
+    // Works with and without a GL context, this is how headless renders get their frames.
+    void ReadPixels(unsigned char* rgba);
+    // Same for the rectangle [x0,x1) x [y0,y1), tightly packed
+    void ReadPixels(unsigned char* rgba, int x0, int y0, int x1, int y1);
+    // Limits all drawing to the rectangle [x0,x1) x [y0,y1), triangles are only scanned inside of it.
+    // Lets a frame be rendered tile by tile with the same pixels as in one go. Resizing resets it to the whole frame.
+    void SetScissor(int x0, int y0, int x1, int y1);
+
     // Sets the color buffer to a new color (all pixels are set to this color).
     void ClearColorBuffer();
 
     // Resize the buffer.
     void Viewport(int w, int h);
 
+    // Selects the storage of the render targets. Compact formats trade precision for memory bandwidth,
+    // CF_RGBA8 also clamps the scene to [0,1] before the post effects see it.
+    void SetFrameBufferFormat(COLOR_FORMAT colorFormat, DEPTH_FORMAT depthFormat);
+    COLOR_FORMAT GetColorFormat() { return m_colorFormat; }
+    DEPTH_FORMAT GetDepthFormat() { return m_depthFormat; }
+    // Total size of the render targets, i.e. the memory one cleared and post processed frame touches
+    size_t GetFrameBufferBytes();
+    // Number of times the render target memory had to be allocated since construction
+    size_t GetFrameBufferAllocations() { return m_frameArena.GetAllocationCount(); }
+    const FrameArena& GetFrameArena() const { return m_frameArena; }
+
     int getHeight() { return m_height; }
     int getWidth() { return m_width; }
 
@@ -158,9 +207,9 @@ public:
     void DrawWireframe(bool bDrawn);
 
     void applyPostEffect(int kernelSizeX, int kernelSizeY, float sigma, POST_EFFECT postEffect = NONE);
-    float colorTruncate(float color);
-    void makeKernel(float gaussianKernel[][29], int kernelSizeX, int kernelSizeY, float sigma);
     void configPostEffect(POST_EFFECT postEffect, int blurX, int blurY, float sigma, float bloomIntensity, glm::vec4 bloomThreshold, float bloomThresh);
+    // Frame memory traffic of the last applied post effect, next to what the unfused passes needed
+    const POST_TRAFFIC& GetPostEffectTraffic() { return m_postProcess.GetTraffic(); }
     void DrawFaceNormal(bool bDrawn);
     void SetFaceNormScaleFactor(float scaleFactor);
 private:
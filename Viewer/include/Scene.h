@@ -2,11 +2,15 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <map>
 #include <vector>
 #include <string>
 #include "Model.h"
 #include "Light.h"
 #include "Camera.h"
+#include "MeshInstancer.h"
+#include "AsyncMeshLoader.h"
+#include "TextureManager.h"
 #include "Defs.h"
 
 class Scene {
@@ -19,6 +23,18 @@ private:
     int                  m_activeLight;
     int                  m_activeCamera;
     glm::mat4x4          m_worldTransformation;
+    MeshInstancer        m_instancer;
+    // models drawn as a placeholder box until their file is loaded: the tickets waiting for each path, and the
+    // model of each ticket. Deleting a model cancels its ticket, a finished load only reaches live models.
+    AsyncMeshLoader                          m_meshLoader;
+    std::multimap<std::string, unsigned>     m_loadingModels;
+    std::map<unsigned, MeshModel*>           m_loadTickets;
+    unsigned                                 m_nextLoadTicket;
+    PMeshAsset                               m_placeholderMesh;
+    // screen space error the levels of detail may show, 0 draws every model in full
+    float                                    m_lodErrorPixels;
+
+    void updateLoadingModels();
 
     glm::vec4            m_polygonColor;
     glm::vec4            m_wireframeColor;
@@ -48,6 +64,13 @@ public:
 
     // Loads an obj file into the scene.
     void LoadOBJModel(std::string fileName, const Surface& material);
+    // Same without waiting for the file: the model is a box until the mesh is parsed and uploaded, which
+    // Draw finishes over the following frames. A file that cannot be read removes the model again. Files of at
+    // least ASYNC_PROGRESSIVE_MIN_BYTES load progressively: a voxel preview within a frame or two of the call,
+    // then coarse to fine levels of detail (see AsyncMeshLoader).
+    void LoadOBJModelAsync(const std::string& fileName, const Surface& material);
+    unsigned int GetLoadingModelCount() { return m_meshLoader.GetPendingCount(); }
+    TEXTURE_STATS GetTextureStats() { return TextureManager::Instance().GetStats(); }
 
     // Draws the current scene.
     void Draw();
@@ -103,6 +126,11 @@ public:
     void SetfnScale(float scale);
 
     unsigned int AddPrimitiveModel(PRIM_MODEL primitiveModel, const Surface& material); //TO_DO develop good API
+    // Stress test for the instanced drawing: count copies of the primitive on a square grid in the xz plane
+    void AddPrimitiveGrid(PRIM_MODEL primitiveModel, const Surface& material, unsigned int count);
+    const INSTANCING_STATS& GetInstancingStats() const { return m_instancer.GetStats(); }
+    float GetLodErrorPixels() const { return m_lodErrorPixels; }
+    void SetLodErrorPixels(float pixels) { m_lodErrorPixels = pixels; }
     void NextModel();
     void DeleteActiveModel();
 
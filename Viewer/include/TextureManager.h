@@ -0,0 +1,105 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Defs.h"
+#include "ThreadPool.h"
+
+#define TEXTURE_DECODE_THREADS           2
+#define TEXTURE_UPLOAD_BUDGET_BYTES      (16 * 1024 * 1024)   // per frame; a larger texture still goes in one piece
+
+/*
+ * Texture class. A 2D texture shared by every model applying the same image file. Its GL name is 0 until
+ * TextureManager uploaded it, models draw with their material colour meanwhile. The GL texture is deleted
+ * with the last model holding it, which has to happen on the render thread.
+ */
+class Texture
+{
+private:
+    friend class TextureManager;
+
+    GLuint   m_name;
+    unsigned m_width;
+    unsigned m_height;
+
+public:
+    Texture() : m_name(0), m_width(0), m_height(0) {}
+    ~Texture();
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
+    GLuint   GetName() const { return m_name; }
+    unsigned GetWidth() const { return m_width; }
+    unsigned GetHeight() const { return m_height; }
+    // including the mipmap chain, 0 while not resident
+    size_t   GetGpuBytes() const { return m_name != 0 ? (size_t)m_width * m_height * 4 * 4 / 3 : 0; }
+};
+
+using PTexture = std::shared_ptr<Texture>;
+
+/*
+ * TextureManager class. Textures by image path: the first Acquire of a path queues the PNG (through the QOI
+ * cache of QoiImage) for decoding on worker threads, every further one while a model still holds the texture
+ * gets the same one. Update, on the render thread, hands the decoded texels to GL through a pixel unpack
+ * buffer, at most a budget of bytes per frame, and frees them right after; only the GPU copy stays. The mipmaps
+ * are generated by a later Update, once a fence shows the transfer is done; until then the texture samples
+ * level 0 only. The manager keeps weak references, a texture nobody holds anymore is not uploaded at all.
+ * It is a static, so it outlives the GL context: ReleaseGL has to be called while the context is still current.
+ */
+class TextureManager
+{
+private:
+    struct Job
+    {
+        std::string                path;
+        std::weak_ptr<Texture>     texture;
+        bool                       bFailed;
+        unsigned                   width;
+        unsigned                   height;
+        std::vector<unsigned char> texels;  // RGBA8
+    };
+
+    struct PendingMipmaps
+    {
+        std::weak_ptr<Texture>     texture;
+        GLsync                     fence;   // signalled once level 0 is in the texture
+    };
+
+    std::mutex                            m_mutex;
+    std::map<std::string, std::weak_ptr<Texture> > m_textures;
+    std::deque<std::unique_ptr<Job> >     m_decoded;    // waiting for the render thread
+    unsigned                              m_pending;    // acquired, not uploaded yet
+    unsigned                              m_shared;
+    size_t                                m_decodedBytes;
+    GLuint                                m_unpackBuffer;
+    std::deque<PendingMipmaps>            m_mipmaps;    // render thread only
+    // last, its destructor waits for the running decodes before the queue goes away
+    ThreadPool                            m_pool;
+
+    TextureManager();
+    ~TextureManager();
+
+    void decode(Job* job);
+    void upload(Texture& texture, const Job& job);
+    void generateMipmaps();
+
+public:
+    static TextureManager& Instance();
+
+    TextureManager(const TextureManager&) = delete;
+    TextureManager& operator=(const TextureManager&) = delete;
+
+    // Never blocks on the file; a file that cannot be decoded leaves the texture at name 0
+    PTexture Acquire(const std::string& path);
+    // Render thread, GL context current
+    void     Update(size_t budgetBytes);
+    // Render thread, before the GL context is destroyed: deletes the manager's own GL objects. Textures still
+    // held by models are theirs to delete.
+    void     ReleaseGL();
+
+    TEXTURE_STATS GetStats();
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * ThreadPool class. A fixed set of worker threads running tasks in submission order.
+ * Every task is handed the index of the worker running it, so callers can keep per-worker state
+ * (a Renderer with its private frame buffers, scratch vectors...) in a vector indexed by it.
+ */
+class ThreadPool
+{
+private:
+    std::vector<std::thread>                     m_workers;
+    std::deque<std::function<void(unsigned)> >   m_tasks;
+    std::mutex                                   m_mutex;
+    // signaled when a task is queued or the pool shuts down
+    std::condition_variable                      m_taskReady;
+    // signaled when the last running task finishes
+    std::condition_variable                      m_idle;
+    unsigned                                     m_running;
+    bool                                         m_bStopping;
+
+    void workerLoop(unsigned workerIdx);
+
+public:
+    // threadCount 0 uses one thread per hardware thread
+    explicit ThreadPool(unsigned threadCount = 0);
+    // Finishes the queued tasks, then joins the workers
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(std::function<void(unsigned workerIdx)> task);
+    // Blocks until every task submitted so far has finished
+    void Wait();
+
+    unsigned GetThreadCount() const { return (unsigned)m_workers.size(); }
+};
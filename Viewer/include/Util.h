@@ -22,6 +22,9 @@ public:
     static bool isVecEqual(glm::vec4 v1, glm::vec4 v2);
     static bool isVecEqual(glm::vec2 v1, glm::vec2 v2);
     static bool isInRange(float x, float min, float max);
+
+    // Converts planar RGB floats to RGBA8 (alpha = 255), clamping every channel to [0,1]
+    static void packRGBA8(const float* r, const float* g, const float* b, unsigned char* rgba, size_t pixelCount);
     //Color handling
 
 
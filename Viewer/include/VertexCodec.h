@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Defs.h"
+
+#define VERTEX_SNORM16_MAX               32767
+// the worst case of a position coordinate in [-1,1] after a round trip, half a step
+#define VERTEX_POSITION_ERROR            (0.5f / VERTEX_SNORM16_MAX)
+// MESH_VERTEX holding the same data as floats: position, normal and barycentric coordinate, 3 floats each
+#define VERTEX_FLOAT_LAYOUT_BYTES        (9 * sizeof(float))
+
+/*
+ * VertexCodec class. The compact encodings of MESH_VERTEX. Every mesh is normalized into [-1,1] on load, so a
+ * position is three 16 bit signed normalized integers; a unit normal is folded onto the octahedron |x|+|y|+|z| = 1
+ * and its upper half, then stored as two of them. vshader.glsl decodes both the same way Decode* do.
+ */
+class VertexCodec
+{
+public:
+    // coordinates outside [-1,1] (a simplified surface may bulge out a little) are clamped
+    static void      EncodePosition(const glm::vec3& position, GLshort encoded[3]);
+    static glm::vec3 DecodePosition(const GLshort encoded[3]);
+    // a zero normal (none in the file) comes back as +z
+    static void      EncodeNormal(const glm::vec3& normal, GLshort encoded[2]);
+    static glm::vec3 DecodeNormal(const GLshort encoded[2]);
+};
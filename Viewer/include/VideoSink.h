@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Defs.h"
+
+#define VIDEO_SINK_BUFFERS               2       // one frame is converted while the previous one is written
+#define VIDEO_SINK_MAX_BUFFERS           8       // more are added while the disk lags behind, past that the render loop waits
+
+/*
+ * Streams rendered frames to a file or to stdout ("-") as Y4M or raw rgb24, e.g. for
+ *   MeshViewerHeadless scene.txt --video - | ffmpeg -i - out.mp4
+ * The color conversion runs on the caller, the writing on a thread of its own, so the render loop only pays for
+ * the conversion. Frames are written in the order WriteFrame is called.
+ */
+class VideoSink
+{
+private:
+    FILE*            m_file;
+    bool             m_bOwnsFile;
+    VIDEO_FORMAT     m_format;
+    int              m_width;
+    int              m_height;
+    size_t           m_frameBytes;
+    VIDEO_SINK_STATS m_stats;
+
+    std::vector<std::unique_ptr<std::vector<unsigned char> > > m_buffers;
+    std::vector<size_t>     m_free;     // buffers the next frame may be converted into
+    std::deque<size_t>      m_queue;    // converted, waiting for the writer
+    std::mutex              m_mutex;
+    std::condition_variable m_bufferFree;
+    std::condition_variable m_frameQueued;
+    std::thread             m_writer;
+    bool                    m_bClosing;
+    bool                    m_bWriteFailed;
+
+    void writerLoop();
+
+public:
+    VideoSink();
+    ~VideoSink();
+    VideoSink(const VideoSink&) = delete;
+    VideoSink& operator=(const VideoSink&) = delete;
+
+    // path "-" is stdout. A zero fps, width or height fails with RC_INVALID_PARAM.
+    RETURN_CODE Open(const std::string& path, VIDEO_FORMAT format, int width, int height, unsigned fps);
+    // rgba: RGBA8 rows bottom-up, as the renderer reads them back
+    RETURN_CODE WriteFrame(const unsigned char* rgba);
+    // Waits for the queued frames to be written
+    RETURN_CODE Close();
+
+    const VIDEO_SINK_STATS& GetStats() const { return m_stats; }
+
+    // Full range BT.601 4:2:0, chroma planes are ((width+1)/2) x ((height+1)/2). Flips rgba to top-down rows.
+    static void ConvertToI420(const unsigned char* rgba, int width, int height, unsigned char* yPlane, unsigned char* uPlane,
+                              unsigned char* vPlane);
+    // Drops alpha and flips rgba to top-down rows
+    static void ConvertToRGB24(const unsigned char* rgba, int width, int height, unsigned char* rgb);
+};
@@ -872,6 +872,12 @@ buffer. It cannot be used to create gzip files however, and it only supports the
 part of zlib that is required for PNG, it does not support dictionaries.
 */
 
+/*Calculate the Adler32 checksum that zlib stores after the deflate data*/
+unsigned lodepng_adler32(const unsigned char* data, size_t len);
+
+/*Adler32 of the concatenation of two buffers, from their checksums and the length of the second buffer*/
+unsigned lodepng_adler32_combine(unsigned adler1, unsigned adler2, size_t len2);
+
 #ifdef LODEPNG_COMPILE_DECODER
 /*Inflate a buffer. Inflate is the decompression step of deflate. Out buffer must be freed after use.*/
 unsigned lodepng_inflate(unsigned char** out, size_t* outsize,
@@ -913,6 +919,16 @@ unsigned lodepng_deflate(unsigned char** out, size_t* outsize,
                          const unsigned char* in, size_t insize,
                          const LodePNGCompressSettings* settings);
 
+/*
+Compress one part of a larger buffer with deflate, without back references into other parts. If final is 0, the
+last block is not marked final and the output ends with an empty stored block on a byte boundary (a sync flush),
+so the outputs of consecutive parts, compressed e.g. on different threads, can simply be concatenated; the last
+part must have final set. Out buffer must be freed after use.
+*/
+unsigned lodepng_deflate_part(unsigned char** out, size_t* outsize,
+                              const unsigned char* in, size_t insize,
+                              const LodePNGCompressSettings* settings, unsigned final);
+
 #endif /*LODEPNG_COMPILE_ENCODER*/
 #endif /*LODEPNG_COMPILE_ZLIB*/
 
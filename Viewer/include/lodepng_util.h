@@ -149,6 +149,26 @@ struct ZlibBlockInfo
 //Extracts all info needed from a PNG file to reconstruct the zlib compression exactly.
 void extractZlibInfo(std::vector<ZlibBlockInfo>& zlibinfo, const std::vector<unsigned char>& in);
 
+/*
+Fast encoding, for screenshots and frame dumps where the encoding time matters more than the last percent of
+file size: no color type analysis, the Sub filter on every scanline instead of trying all five, a short LZ77
+search without lazy matching, and the image data split into parts that are deflated on several threads. The
+parts are joined with sync flushes into one zlib stream, so the result is an ordinary PNG any decoder reads.
+threads: 0 uses every core. The image is 8-bit RGBA.
+*/
+unsigned encodeFast(std::vector<unsigned char>& out, const unsigned char* image, unsigned w, unsigned h,
+                    unsigned threads = 0);
+unsigned encodeFast(const std::string& filename, const unsigned char* image, unsigned w, unsigned h,
+                    unsigned threads = 0);
+
+/*
+The custom_zlib function behind encodeFast: splits the input into one part per thread (of at least 256KB
+each) and compresses them with the other fields of settings. custom_context may
+point to an unsigned thread count, 0 or null uses every core.
+*/
+unsigned parallelZlibCompress(unsigned char** out, size_t* outsize, const unsigned char* in, size_t insize,
+                              const LodePNGCompressSettings* settings);
+
 } // namespace lodepng
 
 #endif /*LODEPNG_UTIL_H inclusion guard*/
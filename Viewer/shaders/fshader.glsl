@@ -1,24 +1,54 @@
 #version 330
 
 in  vec2 texCoord;
+in  vec3 barycentric;
+in  vec3 normal;
+flat in uint material;
 out vec4 colour;
 
 uniform sampler2D textureSampler;
+// ambient color of every material, indexed by the instance
+uniform samplerBuffer materials;
+uniform bool useTexture;
 
 
 struct DirectionalLight 
 {
 	vec3 colour;
 	float ambientIntensity;
+	vec3 diffuseColour;
+	float diffuseIntensity;
+	vec3 direction;     // world space, towards the light
 };
 
 
 uniform DirectionalLight directionalLight;
 
+// Wireframe overlay, drawn in the same pass as the solid surface
+uniform bool  drawWireframe;
+uniform vec3  wireframeColour;
+uniform float wireframeWidth;
+
+// 0 on a triangle edge, 1 once we are wireframeWidth pixels away from all edges
+float edgeFactor()
+{
+    vec3 pixelWidth = fwidth(barycentric);
+    vec3 edgeDistance = smoothstep(vec3(0.0), pixelWidth * wireframeWidth, barycentric);
+    return min(min(edgeDistance.x, edgeDistance.y), edgeDistance.z);
+}
+
 void main() 
 { 
 	vec4 ambientColour = vec4(directionalLight.colour, 1.0f) * directionalLight.ambientIntensity;
+    float lambert = max(dot(normalize(normal), directionalLight.direction), 0.0f);
+    vec4 diffuseColour = vec4(directionalLight.diffuseColour, 1.0f) * directionalLight.diffuseIntensity * lambert;
+
+    vec4 surfaceColour = useTexture ? texture(textureSampler, texCoord) : texelFetch(materials, int(material));
+    colour = surfaceColour * (ambientColour + diffuseColour);
 
-    colour = texture(textureSampler, texCoord) * ambientColour;
+    if (drawWireframe)
+    {
+        colour = mix(vec4(wireframeColour, 1.0f), colour, edgeFactor());
+    }
 } 
 
@@ -0,0 +1,11 @@
+#version 330
+
+in  vec2 texCoord;
+out vec4 colour;
+
+uniform sampler2D screenTexture;
+
+void main()
+{
+    colour = texture(screenTexture, texCoord);
+}
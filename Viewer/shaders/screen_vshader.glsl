@@ -0,0 +1,11 @@
+#version 330
+
+out vec2 texCoord;
+
+// Fullscreen triangle generated from the vertex id, no vertex buffer is bound.
+void main()
+{
+    vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    texCoord    = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -1,16 +1,40 @@
 #version 330
 
-layout (location = 0) in  vec3 vPosition;
-layout (location = 1) in  vec2 vTexCoord;
+// 16 bit integers, see VertexCodec: xyz snorm of the [-1,1] model coordinates, w the triangle corner
+layout (location = 0) in ivec4 vPosition;
+layout (location = 1) in ivec2 vTexCoord;
+layout (location = 2) in ivec2 vNormal;     // octahedral
+// per instance, see MeshInstancer
+layout (location = 3) in  mat4 instanceModel;
+layout (location = 7) in  uint instanceMaterial;
 
-uniform mat4 Model;
 uniform mat4 View;
 uniform mat4 Projection;
 
 out vec2 texCoord;
+out vec3 barycentric;
+out vec3 normal;
+flat out uint material;
+
+vec2 snorm16(ivec2 v) { return max(vec2(v) / 32767.0, -1.0); }
+vec3 snorm16(ivec3 v) { return max(vec3(v) / 32767.0, -1.0); }
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+    {
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(n);
+}
 
 void main()
 {
-    gl_Position = Projection * View * Model * vec4(vPosition,1);
-    texCoord = vTexCoord;
+    gl_Position = Projection * View * instanceModel * vec4(snorm16(vPosition.xyz), 1);
+    texCoord = snorm16(vTexCoord);
+    barycentric = vec3(equal(ivec3(vPosition.w), ivec3(0, 1, 2)));
+    // the inverse transpose keeps normals perpendicular to the surface under per-axis scale
+    normal = transpose(inverse(mat3(instanceModel))) * octahedralDecode(snorm16(vNormal));
+    material = instanceMaterial;
 }
@@ -0,0 +1,181 @@
+#include "AsyncMeshLoader.h"
+#include "MeshBuffer.h"
+
+using namespace std;
+
+AsyncMeshLoader::AsyncMeshLoader(unsigned threads /*= ASYNC_LOAD_THREADS*/) : m_pending(0), m_pool(threads)
+{
+}
+
+AsyncMeshLoader::~AsyncMeshLoader()
+{
+    m_pool.Wait();
+    // a mesh cut off in the middle of its upload gives its range back
+    if (m_uploading && m_uploading->bReserved)
+    {
+        MeshBuffer::Instance().Remove(m_uploading->range);
+    }
+}
+
+void AsyncMeshLoader::queue(Job* job)
+{
+    job->vertices.resize(job->levels.size());
+    job->indices.resize(job->levels.size());
+    for (size_t i = 0; i < job->levels.size(); i++)
+    {
+        job->levels[i]->BuildBufferData(job->vertices[i], job->indices[i]);
+    }
+
+    lock_guard<mutex> lock(m_mutex);
+    m_parsed.emplace_back(job);
+}
+
+void AsyncMeshLoader::parse(Job* job)
+{
+    // binary, the preview seeks to offsets of its own
+    ifstream ifile(job->path.c_str(), ios::binary);
+    job->bFailed = ifile.fail();
+    if (job->bFailed)
+    {
+        queue(job);
+        return;
+    }
+
+    if (job->bProgressive)
+    {
+        // shown while the whole file is parsed, which takes seconds for the large ones
+        Job* preview = new Job(*job);
+        preview->bPreview = true;
+        preview->asset    = make_shared<MeshAsset>();
+        preview->asset->LoadPreview(ifile);
+        if (preview->asset->m_polygons.empty())
+        {
+            delete preview;
+        }
+        else
+        {
+            preview->levels.push_back(preview->asset.get());
+            queue(preview);
+        }
+        ifile.clear();
+        ifile.seekg(0);
+    }
+
+    job->asset = make_shared<MeshAsset>();
+    job->asset->LoadStream(ifile);
+    for (auto lod = job->asset->m_lods.rbegin(); lod != job->asset->m_lods.rend(); ++lod)
+    {
+        job->levels.push_back(lod->get());
+    }
+    job->levels.push_back(job->asset.get());
+    queue(job);
+}
+
+void AsyncMeshLoader::Load(const std::string& path, bool bProgressive /*= false*/)
+{
+    Job* job = new Job();
+    job->path            = path;
+    job->bFailed         = false;
+    job->bPreview        = false;
+    job->bProgressive    = bProgressive;
+    job->level           = 0;
+    job->bReserved       = false;
+    job->range           = MESH_RANGE();
+    job->verticesWritten = 0;
+    job->indicesWritten  = 0;
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_pending++;
+    }
+    m_pool.Submit([this, job](unsigned) { parse(job); });
+}
+
+void AsyncMeshLoader::Update(size_t budgetBytes, std::vector<Result>& finished)
+{
+    MeshBuffer& meshBuffer = MeshBuffer::Instance();
+    size_t      spent      = 0;
+
+    while (spent < budgetBytes)
+    {
+        if (!m_uploading)
+        {
+            lock_guard<mutex> lock(m_mutex);
+            if (m_parsed.empty())
+            {
+                break;
+            }
+            m_uploading = move(m_parsed.front());
+            m_parsed.pop_front();
+        }
+        Job& job = *m_uploading;
+
+        if (!job.bFailed)
+        {
+            vector<MESH_VERTEX>& vertices = job.vertices[job.level];
+            vector<GLuint>&      indices  = job.indices[job.level];
+            if (!job.bReserved)
+            {
+                job.range     = meshBuffer.Reserve(vertices.size(), indices.size());
+                job.bReserved = true;
+            }
+
+            // at least one element per call, a tiny budget still makes progress
+            size_t vertexCount = MIN(vertices.size() - job.verticesWritten, MAX((budgetBytes - spent) / sizeof(MESH_VERTEX), (size_t)1));
+            meshBuffer.WriteVertices(job.range, job.verticesWritten, vertices.data() + job.verticesWritten, vertexCount);
+            job.verticesWritten += vertexCount;
+            spent               += vertexCount * sizeof(MESH_VERTEX);
+
+            if (job.verticesWritten < vertices.size() || spent >= budgetBytes)
+            {
+                continue;
+            }
+
+            size_t indexCount = MIN(indices.size() - job.indicesWritten, MAX((budgetBytes - spent) / sizeof(GLuint), (size_t)1));
+            meshBuffer.WriteIndices(job.range, job.indicesWritten, indices.data() + job.indicesWritten, indexCount);
+            job.indicesWritten += indexCount;
+            spent              += indexCount * sizeof(GLuint);
+
+            if (job.indicesWritten < indices.size())
+            {
+                continue;
+            }
+
+            MeshAsset& level  = *job.levels[job.level];
+            level.m_range     = job.range;
+            level.m_bUploaded = true;
+            vector<MESH_VERTEX>().swap(vertices);
+            vector<GLuint>().swap(indices);
+
+            // then the next finer level; the models of a progressive load show this one meanwhile (it shares
+            // the lifetime of the asset)
+            if (++job.level < job.levels.size())
+            {
+                if (job.bProgressive)
+                {
+                    finished.push_back({ job.path, PMeshAsset(job.asset, &level), false });
+                }
+                job.bReserved       = false;
+                job.verticesWritten = 0;
+                job.indicesWritten  = 0;
+                continue;
+            }
+        }
+
+        if (job.bPreview)
+        {
+            finished.push_back({ job.path, job.asset, false });
+            m_uploading.reset();
+            continue;
+        }
+        finished.push_back({ job.path, job.bFailed ? nullptr : job.asset, true });
+        m_uploading.reset();
+        lock_guard<mutex> lock(m_mutex);
+        m_pending--;
+    }
+}
+
+unsigned AsyncMeshLoader::GetPendingCount()
+{
+    lock_guard<mutex> lock(m_mutex);
+    return m_pending;
+}
@@ -0,0 +1,698 @@
+#include <chrono>
+#include <cstring>
+#include "BatchRenderer.h"
+#include "Util.h"
+#include "lodepng_util.h"
+#include "QoiImage.h"
+#include "MeshSimplifier.h"
+
+using namespace std;
+using namespace glm;
+
+typedef std::chrono::steady_clock BATCH_CLOCK;
+
+// obj parser helper, MeshAsset.cpp
+vec3 vec3fFromStream(std::istream& issLine);
+
+static double secondsSince(BATCH_CLOCK::time_point& start)
+{
+    BATCH_CLOCK::time_point now = BATCH_CLOCK::now();
+    double seconds = std::chrono::duration<double>(now - start).count();
+    start = now;
+    return seconds;
+}
+
+// Whether an optional value follows. Skipping whitespace on a line already read to its end would fail the stream.
+static bool hasMoreOnLine(std::istream& issLine)
+{
+    return !issLine.eof() && !(issLine >> std::ws).eof();
+}
+
+static vec4 vec4fFromStream(std::istream& issLine)
+{
+    float r, g, b;
+    issLine >> r >> std::ws >> g >> std::ws >> b;
+    return vec4(r, g, b, 1.f);
+}
+
+BatchScene::BatchScene()
+{
+    m_settings.width          = DEFAULT_WIDTH;
+    m_settings.height         = DEFAULT_HEIGHT;
+    m_settings.bgColor        = Util::getColor(CLEAR);
+    m_settings.shading        = ST_GOURAUD;
+    m_settings.bWireframe     = false;
+    m_settings.postEffect     = NONE;
+    m_settings.blurX          = 1;
+    m_settings.blurY          = 1;
+    m_settings.sigma          = 1.f;
+    m_settings.bloomIntensity = 1.f;
+    m_settings.bloomThreshold = 1.f;
+    m_settings.frames         = 1;
+    m_settings.spinDegrees    = 0.f;
+    m_settings.lodErrorPixels = MESH_LOD_ERROR_PIXELS;
+    m_settings.outputPrefix   = "frame";
+    m_settings.imageFormat    = IF_PNG;
+}
+
+BatchScene::~BatchScene()
+{
+    for (Model* model : m_models)
+    {
+        delete model;
+    }
+    for (Light* light : m_lights)
+    {
+        delete light;
+    }
+    for (BATCH_CAMERA& camera : m_cameras)
+    {
+        delete camera.pCamera;
+    }
+}
+
+RETURN_CODE BatchScene::Load(const std::string& fileName)
+{
+    ifstream ifile(fileName.c_str(), ios::binary);
+
+    if (ifile.fail())
+    {
+        fprintf(stderr, "Opening scene %s failed\n", fileName.c_str());
+        return RC_IO_ERROR;
+    }
+
+    stringstream description;
+    description << ifile.rdbuf();
+    return LoadFromMemory(description.str(), fileName);
+}
+
+RETURN_CODE BatchScene::LoadFromMemory(const std::string& description, const std::string& sourceName)
+{
+    istringstream ifile(description);
+
+    m_description = description;
+
+    unsigned lineNumber = 0;
+    while (!ifile.eof())
+    {
+        string curLine;
+        getline(ifile, curLine);
+        lineNumber++;
+
+        istringstream issLine(curLine);
+        string lineType;
+
+        issLine >> std::ws >> lineType;
+
+        if (lineType.empty() || lineType[0] == '#')
+        {
+            continue;
+        }
+
+        if (parseLine(lineType, issLine) != RC_SUCCESS || issLine.fail())
+        {
+            fprintf(stderr, "%s:%u: bad line \"%s\"\n", sourceName.c_str(), lineNumber, curLine.c_str());
+            return RC_FAILURE;
+        }
+    }
+
+    addDefaultCamera();
+    return RC_SUCCESS;
+}
+
+RETURN_CODE BatchScene::ApplyLine(const std::string& line)
+{
+    istringstream issLine(line);
+    string lineType;
+
+    issLine >> std::ws >> lineType;
+    if (lineType.empty() || lineType[0] == '#')
+    {
+        return RC_SUCCESS;
+    }
+
+    RETURN_CODE rc = parseLine(lineType, issLine);
+    if (rc == RC_SUCCESS && issLine.fail())
+    {
+        rc = RC_FAILURE;
+    }
+    return rc;
+}
+
+void BatchScene::addDefaultCamera()
+{
+    if (m_cameras.empty())
+    {
+        // Camera() always looks from DEFAULT_CAMERA_POSITION
+        BATCH_CAMERA camera = { new Camera(0), vec3(2.f, 2.f, 2.f), false, {} };
+        m_cameras.push_back(camera);
+    }
+}
+
+RETURN_CODE BatchScene::parseLine(const std::string& lineType, std::istringstream& issLine)
+{
+    if (lineType == "size")
+    {
+        issLine >> m_settings.width >> m_settings.height;
+        return (m_settings.width > 0 && m_settings.height > 0) ? RC_SUCCESS : RC_FAILURE;
+    }
+    else if (lineType == "background")
+    {
+        m_settings.bgColor = vec4fFromStream(issLine);
+    }
+    else if (lineType == "material")
+    {
+        string name;
+        vec4   ambientC, diffusiveC, specularC;
+        float  ambientI, diffusiveI, specularI;
+        int    shininess;
+
+        issLine >> name;
+        ambientC   = vec4fFromStream(issLine);
+        issLine >> ambientI;
+        diffusiveC = vec4fFromStream(issLine);
+        issLine >> diffusiveI;
+        specularC  = vec4fFromStream(issLine);
+        issLine >> specularI >> shininess;
+
+        m_currentMaterial = Surface(name, ambientC, ambientI, diffusiveC, diffusiveI, specularC, specularI, shininess);
+        m_materials.erase(name);
+        m_materials.insert({ name, m_currentMaterial });
+    }
+    else if (lineType == "use")
+    {
+        string name;
+        issLine >> name;
+        auto it = m_materials.find(name);
+        if (it == m_materials.end())
+        {
+            return RC_FAILURE;
+        }
+        m_currentMaterial = it->second;
+    }
+    else if (lineType == "model")
+    {
+        string path;
+        issLine >> std::ws;
+        getline(issLine, path);
+
+        auto cached = m_meshCache.find(path);
+        if (cached == m_meshCache.end())
+        {
+            ifstream objFile(path.c_str(), ios::binary);
+            if (objFile.fail())
+            {
+                return RC_IO_ERROR;
+            }
+            stringstream objData;
+            objData << objFile.rdbuf();
+            cached = m_meshCache.insert({ path, objData.str() }).first;
+        }
+
+        // repeated paths share one parsed mesh
+        m_models.push_back(new MeshModel(MeshAssetRegistry::Instance().Acquire(path, cached->second, 0), m_currentMaterial, 0));
+    }
+    else if (lineType == "primitive")
+    {
+        string name;
+        issLine >> name;
+        if      (name == "sphere") m_models.push_back(new PrimMeshModel(PM_SPHERE, m_currentMaterial, 0));
+        else if (name == "cube")   m_models.push_back(new PrimMeshModel(PM_CUBE,   m_currentMaterial, 0));
+        else if (name == "teapot") m_models.push_back(new PrimMeshModel(PM_TEAPOT, m_currentMaterial, 0));
+        else return RC_FAILURE;
+    }
+    else if (lineType == "translate" || lineType == "scale" || lineType == "rotate")
+    {
+        if (m_models.empty())
+        {
+            return RC_FAILURE;
+        }
+        Model* model = m_models.back();
+
+        if (lineType == "translate")
+        {
+            mat4x4 transform = translate(model->GetTranslateTransformation(), vec3fFromStream(issLine));
+            model->SetTranslateTransformation(transform);
+        }
+        else if (lineType == "scale")
+        {
+            float value;
+            issLine >> value;
+            mat4x4 transform = scale(model->GetScaleTransformation(), vec3(value, value, value));
+            model->SetScaleTransformation(transform);
+        }
+        else
+        {
+            string axis;
+            float  degrees;
+            issLine >> axis >> degrees;
+            vec3 axisVec = (axis == "x") ? vec3(1, 0, 0) : (axis == "y") ? vec3(0, 1, 0) : vec3(0, 0, 1);
+            mat4x4 transform = rotate(model->GetRotateTransformation(), radians(degrees), axisVec);
+            model->SetRotateTransformation(transform);
+        }
+    }
+    else if (lineType == "transform")
+    {
+        size_t modelIdx;
+        issLine >> modelIdx;
+        if (modelIdx >= m_models.size())
+        {
+            return RC_FAILURE;
+        }
+        Model* model   = m_models[modelIdx];
+        vec3   offset  = vec3fFromStream(issLine);
+        vec3   degrees = vec3fFromStream(issLine);
+        float  value;
+        issLine >> value;
+
+        mat4x4 rotation = rotate(mat4x4(I_MATRIX), radians(degrees.z), vec3(0, 0, 1));
+        rotation        = rotate(rotation, radians(degrees.y), vec3(0, 1, 0));
+        rotation        = rotate(rotation, radians(degrees.x), vec3(1, 0, 0));
+        mat4x4 translation = translate(mat4x4(I_MATRIX), offset);
+        mat4x4 scaling     = scale(mat4x4(I_MATRIX), vec3(value, value, value));
+        model->SetTranslateTransformation(translation);
+        model->SetRotateTransformation(rotation);
+        model->SetScaleTransformation(scaling);
+    }
+    else if (lineType == "clear")
+    {
+        for (Model* model : m_models)
+        {
+            delete model;
+        }
+        m_models.clear();
+        m_meshCache.clear();
+    }
+    else if (lineType == "light")
+    {
+        string type;
+        issLine >> type;
+        vec3  location   = vec3fFromStream(issLine);
+        vec4  ambientC   = vec4fFromStream(issLine);
+        float ambientI;
+        issLine >> ambientI;
+        vec4  diffusiveC = vec4fFromStream(issLine);
+        float diffusiveI;
+        issLine >> diffusiveI;
+        vec4  specularC  = vec4fFromStream(issLine);
+        float specularI;
+        issLine >> specularI;
+
+        if      (type == "point")    m_lights.push_back(new PointSourceLight(location, ambientC, ambientI, diffusiveC, diffusiveI, specularC, specularI, 0));
+        else if (type == "parallel") m_lights.push_back(new ParallelSourceLight(location, ambientC, ambientI, diffusiveC, diffusiveI, specularC, specularI, 0));
+        else if (type == "area")     m_lights.push_back(new DistributedSourceLight(location, ambientC, ambientI, diffusiveC, diffusiveI, specularC, specularI, 0));
+        else return RC_FAILURE;
+    }
+    else if (lineType == "camera")
+    {
+        vec3 eye = vec3fFromStream(issLine);
+        vec3 at  = vec3fFromStream(issLine);
+        vec3 up  = vec3fFromStream(issLine);
+        BATCH_CAMERA camera = { new Camera(eye, at, up, 0), eye, false, {} };
+        m_cameras.push_back(camera);
+    }
+    else if (lineType == "lookat")
+    {
+        size_t cameraIdx;
+        issLine >> cameraIdx;
+        if (cameraIdx >= m_cameras.size())
+        {
+            return RC_FAILURE;
+        }
+        vec3 eye = vec3fFromStream(issLine);
+        vec3 at  = vec3fFromStream(issLine);
+        vec3 up  = vec3fFromStream(issLine);
+        m_cameras[cameraIdx].pCamera->LookAt(eye, at, up);
+        m_cameras[cameraIdx].eye = eye;
+    }
+    else if (lineType == "ortho")
+    {
+        PROJ_PARAMS projParams;
+        issLine >> projParams.left >> projParams.right >> projParams.bottom >> projParams.top >> projParams.zNear >> projParams.zFar;
+        if (m_cameras.empty())
+        {
+            return RC_FAILURE;
+        }
+        m_cameras.back().pCamera->Ortho(projParams);
+        m_cameras.back().bPerspective = false;
+    }
+    else if (lineType == "perspective")
+    {
+        float degrees;
+        if (m_cameras.empty())
+        {
+            return RC_FAILURE;
+        }
+        PERSPECTIVE_PARAMS& perspective = m_cameras.back().perspective;
+        issLine >> degrees >> perspective.zNear >> perspective.zFar;
+        if (perspective.zFar == perspective.zNear)
+        {
+            return RC_FAILURE;
+        }
+        perspective.fovy   = radians(degrees);
+        perspective.aspect = 1.f;
+        m_cameras.back().bPerspective = true;
+    }
+    else if (lineType == "shading")
+    {
+        string type;
+        issLine >> type;
+        if      (type == "none")    m_settings.shading = ST_NO_SHADING;
+        else if (type == "solid")   m_settings.shading = ST_SOLID;
+        else if (type == "flat")    m_settings.shading = ST_FLAT;
+        else if (type == "gouraud") m_settings.shading = ST_GOURAUD;
+        else if (type == "phong")   m_settings.shading = ST_PHONG;
+        else return RC_FAILURE;
+    }
+    else if (lineType == "wireframe")
+    {
+        int bDrawn;
+        issLine >> bDrawn;
+        m_settings.bWireframe = bDrawn != 0;
+    }
+    else if (lineType == "post")
+    {
+        string type;
+        issLine >> type;
+        if      (type == "none")  { m_settings.postEffect = NONE; return RC_SUCCESS; }
+        else if (type == "blur")  m_settings.postEffect = BLUR_SCENE;
+        else if (type == "bloom") m_settings.postEffect = BLOOM;
+        else return RC_FAILURE;
+
+        issLine >> m_settings.blurX >> m_settings.blurY >> m_settings.sigma;
+        // intensity and threshold are optional
+        if (m_settings.postEffect == BLOOM && hasMoreOnLine(issLine))
+        {
+            issLine >> m_settings.bloomIntensity >> m_settings.bloomThreshold;
+        }
+    }
+    else if (lineType == "frames")
+    {
+        issLine >> m_settings.frames;
+    }
+    else if (lineType == "spin")
+    {
+        issLine >> m_settings.spinDegrees;
+    }
+    else if (lineType == "lod")
+    {
+        issLine >> m_settings.lodErrorPixels;
+    }
+    else if (lineType == "output")
+    {
+        string format;
+        issLine >> m_settings.outputPrefix;
+        // the format is optional
+        if (hasMoreOnLine(issLine))
+        {
+            issLine >> format;
+            if      (format == "png")     m_settings.imageFormat = IF_PNG;
+            else if (format == "pngfast") m_settings.imageFormat = IF_PNG_FAST;
+            else if (format == "qoi")     m_settings.imageFormat = IF_QOI;
+            else return RC_FAILURE;
+        }
+    }
+    else
+    {
+        return RC_UNDEFINED;
+    }
+
+    return RC_SUCCESS;
+}
+
+BatchRenderer::BatchRenderer(const BATCH_SETTINGS& settings) : m_renderer(settings.width, settings.height, true), m_timings()
+{
+    ApplySettings(settings);
+
+    m_pixels.resize(static_cast<size_t>(settings.width) * settings.height * 4);
+    m_image.resize(m_pixels.size());
+}
+
+void BatchRenderer::ApplySettings(const BATCH_SETTINGS& settings)
+{
+    m_renderer.SetBgColor(settings.bgColor);
+    m_renderer.SetShadingType(settings.shading);
+    m_renderer.DrawWireframe(settings.bWireframe);
+    m_renderer.DrawFaceNormal(false);
+    m_renderer.SetGeneratedTexture(GT_NONE);
+    m_renderer.SetFaceNormScaleFactor(1.f);
+    m_renderer.SetWorldTransformation(mat4x4(I_MATRIX));
+    m_renderer.configPostEffect(settings.postEffect, settings.blurX, settings.blurY, settings.sigma, settings.bloomIntensity,
+                                vec4(settings.bloomThreshold), settings.bloomThreshold);
+}
+
+void BatchRenderer::RenderFrame(BatchScene& scene, unsigned cameraIdx, unsigned frame, unsigned char* pPixels /*= nullptr*/)
+{
+    draw(scene, cameraIdx, frame);
+
+    const BATCH_SETTINGS&   settings = scene.GetSettings();
+    BATCH_CLOCK::time_point start    = BATCH_CLOCK::now();
+    m_renderer.applyPostEffect(settings.blurX, settings.blurY, settings.sigma, settings.postEffect);
+    m_timings.seconds[RS_POST] += secondsSince(start);
+
+    m_renderer.ReadPixels(pPixels != nullptr ? pPixels : m_pixels.data());
+    m_timings.seconds[RS_READBACK] += secondsSince(start);
+
+    m_timings.frames++;
+}
+
+void BatchRenderer::RenderTile(BatchScene& scene, unsigned cameraIdx, unsigned frame, int x0, int y0, int x1, int y1)
+{
+    m_renderer.SetScissor(x0, y0, x1, y1);
+    draw(scene, cameraIdx, frame);
+    m_renderer.SetScissor(0, 0, m_renderer.getWidth(), m_renderer.getHeight());
+
+    // draw() cleared the color buffer, which also made it the displayed one again
+    BATCH_CLOCK::time_point start = BATCH_CLOCK::now();
+    m_tilePixels.resize(static_cast<size_t>(x1 - x0) * (y1 - y0) * 4);
+    m_renderer.ReadPixels(m_tilePixels.data(), x0, y0, x1, y1);
+    m_timings.seconds[RS_READBACK] += secondsSince(start);
+}
+
+void BatchRenderer::draw(BatchScene& scene, unsigned cameraIdx, unsigned frame)
+{
+    const BATCH_SETTINGS& settings = scene.GetSettings();
+    const BATCH_CAMERA&   camera   = scene.GetCameras()[cameraIdx];
+    BATCH_CLOCK::time_point start  = BATCH_CLOCK::now();
+
+    mat4x4 projection = camera.pCamera->GetProjection();
+    if (camera.bPerspective)
+    {
+        float aspect = (float)m_renderer.getWidth() / (float)m_renderer.getHeight();
+        projection   = perspective(camera.perspective.fovy, aspect, camera.perspective.zNear, camera.perspective.zFar);
+    }
+    m_renderer.SetCameraTransform(camera.pCamera->GetTransformation());
+    m_renderer.SetProjection(projection);
+    m_renderer.ClearColorBuffer();
+    m_renderer.ClearDepthBuffer();
+    m_timings.seconds[RS_CLEAR] += secondsSince(start);
+
+    mat4x4 spin           = rotate(mat4x4(I_MATRIX), radians(settings.spinDegrees * frame), vec3(0, 1, 0));
+    mat4x4 viewProjection = projection * camera.pCamera->GetTransformation();
+    // the renderer maps the height of the NDC square to the frame height, x is scaled by the aspect
+    vec2   pixelsPerNdc(m_renderer.getHeight() / 2.f, m_renderer.getHeight() / 2.f);
+
+    for (Model* model : scene.GetModels())
+    {
+        get<TUPLE_POLYGONS>(m_modelData).clear();
+        get<TUPLE_VERTICES>(m_modelData).clear();
+        get<TUPLE_VNORMALS>(m_modelData).clear();
+        get<TUPLE_VPOSITIONS>(m_modelData).clear();
+
+        mat4x4           objTransformation = spin * model->GetTranslateTransformation() * model->GetRotateTransformation() * model->GetScaleTransformation();
+        MeshModel*       meshModel         = static_cast<MeshModel*>(model);
+        const MeshAsset& level             = meshModel->GetAsset()->SelectLod(viewProjection * objTransformation, pixelsPerNdc,
+                                                                              settings.lodErrorPixels);
+        meshModel->DrawLevel(m_modelData, level);
+        m_timings.triangles += level.m_polygons.size();
+
+        vector<Face>& polygons = get<TUPLE_POLYGONS>(m_modelData);
+        for (Light* light : scene.GetLights())
+        {
+            mat4x4 lightModelTransformation = light->GetLightModel().GetModelTransformation();
+            for (Face& face : polygons)
+            {
+                light->Illuminate(face, lightModelTransformation);
+            }
+        }
+        m_timings.seconds[RS_LIGHTING] += secondsSince(start);
+
+        vec3 centroid = model->getCentroid();
+
+        m_renderer.SetObjectMatrices(objTransformation, model->GetNormalTransformation());
+        m_renderer.DrawTriangles(polygons, &centroid, camera.eye, &get<TUPLE_VERTICES>(m_modelData), &level.m_edges);
+        m_timings.seconds[RS_RASTER] += secondsSince(start);
+    }
+}
+
+RETURN_CODE BatchRenderer::WriteImage(const std::string& fileName, IMAGE_FORMAT format, unsigned encodeThreads /*= 0*/)
+{
+    BATCH_CLOCK::time_point start = BATCH_CLOCK::now();
+    RETURN_CODE rc = WriteImage(fileName, m_pixels, (unsigned)m_renderer.getWidth(), (unsigned)m_renderer.getHeight(), format, m_image,
+        encodeThreads);
+    m_timings.seconds[RS_ENCODE] += secondsSince(start);
+    return rc;
+}
+
+RETURN_CODE BatchRenderer::WriteImage(const std::string& fileName, const std::vector<unsigned char>& pixels, unsigned width, unsigned height,
+    IMAGE_FORMAT format, std::vector<unsigned char>& image, unsigned encodeThreads /*= 0*/)
+{
+    if (format == IF_QOI)
+    {
+        // the encoder walks the rows bottom-up itself
+        RETURN_CODE rc = QoiImage::WriteFile(fileName, pixels.data(), width, height, true);
+        if (rc != RC_SUCCESS)
+        {
+            fprintf(stderr, "Writing %s failed\n", fileName.c_str());
+        }
+        return rc;
+    }
+
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+
+    // pixels are bottom-up like glReadPixels, PNG rows go top-down
+    image.resize(rowBytes * height);
+    for (unsigned y = 0; y < height; y++)
+    {
+        memcpy(&image[(height - 1 - y) * rowBytes], &pixels[y * rowBytes], rowBytes);
+    }
+
+    unsigned error = (format == IF_PNG_FAST) ? lodepng::encodeFast(fileName, image.data(), width, height, encodeThreads)
+                                             : lodepng_encode32_file(fileName.c_str(), image.data(), width, height);
+    if (error)
+    {
+        fprintf(stderr, "Writing %s failed: %s\n", fileName.c_str(), lodepng_error_text(error));
+        return RC_IO_ERROR;
+    }
+    return RC_SUCCESS;
+}
+
+std::string BatchRenderer::FrameFileName(const BATCH_SETTINGS& settings, unsigned cameraIdx, unsigned frame)
+{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "_c%u_f%04u.%s", cameraIdx, frame, settings.imageFormat == IF_QOI ? "qoi" : "png");
+    return settings.outputPrefix + suffix;
+}
+
+ParallelBatchRenderer::ParallelBatchRenderer(BatchScene& scene, unsigned threadCount /*= 0*/) : m_scene(scene), m_pool(threadCount), m_nextUnit(0), m_bDelivering(false), m_result(RC_SUCCESS)
+{
+    for (unsigned i = 0; i < m_pool.GetThreadCount(); i++)
+    {
+        m_renderers.emplace_back(new BatchRenderer(scene.GetSettings()));
+    }
+}
+
+RETURN_CODE ParallelBatchRenderer::Render(bool bWriteImages, const FRAME_SINK& sink /*= nullptr*/)
+{
+    unsigned frames = m_scene.GetSettings().frames;
+    unsigned units  = (unsigned)m_scene.GetCameras().size() * frames;
+
+    m_pending.clear();
+    m_nextUnit    = 0;
+    m_bDelivering = false;
+    m_result      = RC_SUCCESS;
+
+    // The queue is FIFO, so units finish roughly in order and few frames wait for the sink
+    for (unsigned unit = 0; unit < units; unit++)
+    {
+        m_pool.Submit([this, unit, bWriteImages, &sink](unsigned workerIdx) { renderUnit(workerIdx, unit, bWriteImages, sink); });
+    }
+    m_pool.Wait();
+
+    return m_result;
+}
+
+void ParallelBatchRenderer::renderUnit(unsigned workerIdx, unsigned unit, bool bWriteImages, const FRAME_SINK& sink)
+{
+    const BATCH_SETTINGS& settings  = m_scene.GetSettings();
+    BatchRenderer&        renderer  = *m_renderers[workerIdx];
+    unsigned              cameraIdx = unit / settings.frames;
+    unsigned              frame     = unit % settings.frames;
+    RETURN_CODE           rc        = RC_SUCCESS;
+
+    renderer.RenderFrame(m_scene, cameraIdx, frame);
+    if (bWriteImages)
+    {
+        // the other workers keep the cores busy, a frame is only split across threads when there are none
+        rc = renderer.WriteImage(BatchRenderer::FrameFileName(settings, cameraIdx, frame), settings.imageFormat,
+            m_pool.GetThreadCount() > 1 ? 1 : 0);
+    }
+
+    if (rc != RC_SUCCESS)
+    {
+        lock_guard<mutex> lock(m_orderMutex);
+        if (m_result == RC_SUCCESS)
+        {
+            m_result = rc;
+        }
+    }
+
+    if (sink)
+    {
+        vector<unsigned char> pixels(renderer.GetPixels());
+        deliver(unit, pixels, sink);
+    }
+}
+
+void ParallelBatchRenderer::deliver(unsigned unit, std::vector<unsigned char>& pixels, const FRAME_SINK& sink)
+{
+    unique_lock<mutex> lock(m_orderMutex);
+    m_pending[unit].swap(pixels);
+
+    // Whoever finds the next frame in order drains the run, the other workers just park their frames
+    if (m_bDelivering)
+    {
+        return;
+    }
+    m_bDelivering = true;
+
+    unsigned frames = m_scene.GetSettings().frames;
+    while (!m_pending.empty() && m_pending.begin()->first == m_nextUnit)
+    {
+        vector<unsigned char> next;
+        next.swap(m_pending.begin()->second);
+        m_pending.erase(m_pending.begin());
+
+        unsigned nextUnit = m_nextUnit;
+        lock.unlock();
+        RETURN_CODE rc = sink(nextUnit / frames, nextUnit % frames, next);
+        lock.lock();
+
+        if (rc != RC_SUCCESS && m_result == RC_SUCCESS)
+        {
+            m_result = rc;
+        }
+        m_nextUnit++;
+    }
+
+    m_bDelivering = false;
+}
+
+STAGE_TIMINGS ParallelBatchRenderer::GetTimings() const
+{
+    STAGE_TIMINGS total = {};
+    for (const unique_ptr<BatchRenderer>& renderer : m_renderers)
+    {
+        const STAGE_TIMINGS& timings = renderer->GetTimings();
+        for (int stage = 0; stage < RS_COUNT; stage++)
+        {
+            total.seconds[stage] += timings.seconds[stage];
+        }
+        total.frames    += timings.frames;
+        total.triangles += timings.triangles;
+    }
+    return total;
+}
+
+POST_TRAFFIC ParallelBatchRenderer::GetPostEffectTraffic() const
+{
+    // every worker runs the same effect, any one that rendered a frame has the numbers
+    for (const unique_ptr<BatchRenderer>& renderer : m_renderers)
+    {
+        if (renderer->GetTimings().frames > 0)
+        {
+            return renderer->GetRenderer().GetPostEffectTraffic();
+        }
+    }
+    return POST_TRAFFIC{};
+}
@@ -0,0 +1,573 @@
+#include <algorithm>
+#include <limits>
+#include <new>
+#include "FrameBuffer.h"
+#include "Util.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#if defined(__F16C__) || defined(__AVX2__)
+#include <immintrin.h>
+#define FRAMEBUFFER_F16C
+#endif
+
+using namespace std;
+using namespace glm;
+
+#define HALF_SPAN_PIXELS 256
+
+//////////////////// FrameArena /////////////////////////
+
+FrameArena::FrameArena() : m_block(nullptr), m_capacity(0), m_offset(0), m_bHugePages(true), m_bMapped(false), m_allocations(0) {}
+
+FrameArena::~FrameArena()
+{
+    release();
+}
+
+void FrameArena::release()
+{
+    if (!m_block)
+    {
+        return;
+    }
+#ifdef _WIN32
+    _aligned_free(m_block);
+#else
+    if (m_bMapped)
+    {
+        munmap(m_block, m_capacity);
+    }
+    else
+    {
+        free(m_block);
+    }
+#endif
+    m_block    = nullptr;
+    m_capacity = 0;
+    m_bMapped  = false;
+}
+
+void FrameArena::Reset(size_t bytes)
+{
+    m_offset = 0;
+    if (bytes <= m_capacity)
+    {
+        return;
+    }
+
+    // grow geometrically so a window dragged to a bigger size reallocates only a few times
+    size_t capacity = AlignedSize(MAX(bytes, m_capacity * 2));
+    release();
+
+#ifdef _WIN32
+    m_block = static_cast<unsigned char*>(_aligned_malloc(capacity, FRAME_ARENA_ALIGNMENT));
+#else
+    if (m_bHugePages && capacity >= FRAME_ARENA_HUGE_PAGE_SIZE)
+    {
+        capacity = (capacity + FRAME_ARENA_HUGE_PAGE_SIZE - 1) & ~static_cast<size_t>(FRAME_ARENA_HUGE_PAGE_SIZE - 1);
+        void* mapped = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped != MAP_FAILED)
+        {
+#ifdef MADV_HUGEPAGE
+            madvise(mapped, capacity, MADV_HUGEPAGE);
+#endif
+            m_block   = static_cast<unsigned char*>(mapped);
+            m_bMapped = true;
+        }
+    }
+    if (!m_block)
+    {
+        m_block = static_cast<unsigned char*>(aligned_alloc(FRAME_ARENA_ALIGNMENT, capacity));
+    }
+#endif
+
+    if (!m_block)
+    {
+        throw std::bad_alloc();
+    }
+    m_capacity = capacity;
+    m_allocations++;
+}
+
+void* FrameArena::Take(size_t bytes)
+{
+    size_t size = AlignedSize(bytes);
+    if (m_offset + size > m_capacity)
+    {
+        throw std::bad_alloc();
+    }
+    void* pointer = m_block + m_offset;
+    m_offset += size;
+    return pointer;
+}
+
+//////////////////// ColorTarget ////////////////////////
+
+ColorTarget::ColorTarget() : m_format(CF_RGB32F), m_pixelCount(0), m_width(0), m_height(0), m_tilesX(0), m_clearColor(ZERO_VEC3) {}
+
+void ColorTarget::Detach()
+{
+    for (auto& plane : m_planes32f)
+    {
+        plane.Detach();
+    }
+    for (auto& plane : m_planes16f)
+    {
+        plane.Detach();
+    }
+    m_rgba8.Detach();
+    m_tilePending.Detach();
+    m_pixelCount = 0;
+    m_width = m_height = m_tilesX = 0;
+}
+
+void ColorTarget::Attach(FrameArena& arena, int width, int height, COLOR_FORMAT format)
+{
+    Detach();
+
+    m_format     = format;
+    m_width      = width;
+    m_height     = height;
+    m_tilesX     = (width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+    m_pixelCount = static_cast<size_t>(width) * height;
+
+    switch (m_format)
+    {
+    case CF_RGB16F:
+        for (auto& plane : m_planes16f)
+        {
+            plane.Attach(arena, m_pixelCount);
+        }
+        break;
+    case CF_RGBA8:
+        m_rgba8.Attach(arena, m_pixelCount);
+        break;
+    default:
+        for (auto& plane : m_planes32f)
+        {
+            plane.Attach(arena, m_pixelCount);
+        }
+        break;
+    }
+    m_tilePending.Attach(arena, static_cast<size_t>(m_tilesX) * ((height + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE));
+
+    Clear(ZERO_VEC3);
+}
+
+size_t ColorTarget::ArenaBytes(int width, int height, COLOR_FORMAT format)
+{
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    size_t tileCount  = static_cast<size_t>((width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE) * ((height + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE);
+    size_t tileBytes  = AlignedView<uint8_t>::ArenaBytes(tileCount);
+
+    switch (format)
+    {
+    case CF_RGB16F: return 3 * AlignedView<uint16_t>::ArenaBytes(pixelCount) + tileBytes;
+    case CF_RGBA8:  return AlignedView<uint32_t>::ArenaBytes(pixelCount) + tileBytes;
+    default:        return 3 * AlignedView<float>::ArenaBytes(pixelCount) + tileBytes;
+    }
+}
+
+size_t ColorTarget::BytesPerPixel(COLOR_FORMAT format)
+{
+    switch (format)
+    {
+    case CF_RGB16F: return 3 * sizeof(uint16_t);
+    case CF_RGBA8:  return sizeof(uint32_t);
+    default:        return 3 * sizeof(float);
+    }
+}
+
+size_t ColorTarget::GetBytes() const
+{
+    return m_pixelCount * BytesPerPixel(m_format);
+}
+
+void ColorTarget::Clear(const vec3& color)
+{
+    // keep the value a materialized pixel would read back, so pending and resolved tiles look the same
+    switch (m_format)
+    {
+    case CF_RGB16F:
+        m_clearColor = vec3(halfToFloat(floatToHalf(color.x)), halfToFloat(floatToHalf(color.y)), halfToFloat(floatToHalf(color.z)));
+        break;
+    case CF_RGBA8:
+        m_clearColor = vec3(floatToUnorm8(color.x), floatToUnorm8(color.y), floatToUnorm8(color.z)) * (1.f / 255.f);
+        break;
+    default:
+        m_clearColor = color;
+        break;
+    }
+
+    if (m_tilePending.Size())
+    {
+        memset(m_tilePending.Data(), 1, m_tilePending.Size());
+    }
+}
+
+void ColorTarget::materializeTile(size_t tile)
+{
+    int x0 = static_cast<int>(tile % m_tilesX) * FRAME_TILE_SIZE;
+    int y0 = static_cast<int>(tile / m_tilesX) * FRAME_TILE_SIZE;
+    int x1 = MIN(x0 + FRAME_TILE_SIZE, m_width);
+    int y1 = MIN(y0 + FRAME_TILE_SIZE, m_height);
+
+    for (int y = y0; y < y1; y++)
+    {
+        size_t first = Z_BUF_INDEX(m_width, x0, y);
+        size_t last  = Z_BUF_INDEX(m_width, x1, y);
+        switch (m_format)
+        {
+        case CF_RGB16F:
+            for (int c = 0; c < 3; c++)
+            {
+                std::fill(m_planes16f[c].Data() + first, m_planes16f[c].Data() + last, floatToHalf(m_clearColor[c]));
+            }
+            break;
+        case CF_RGBA8:
+            std::fill(m_rgba8.Data() + first, m_rgba8.Data() + last, packRGBA8(m_clearColor));
+            break;
+        default:
+            for (int c = 0; c < 3; c++)
+            {
+                std::fill(m_planes32f[c].Data() + first, m_planes32f[c].Data() + last, m_clearColor[c]);
+            }
+            break;
+        }
+    }
+
+    m_tilePending[tile] = 0;
+}
+
+void ColorTarget::Resolve()
+{
+    for (size_t tile = 0; tile < m_tilePending.Size(); tile++)
+    {
+        if (m_tilePending[tile])
+        {
+            materializeTile(tile);
+        }
+    }
+}
+
+// Converts count half floats of one plane, 8 per vcvtph2ps when F16C is available
+static void halfPlaneToFloat(const uint16_t* halves, float* values, size_t count)
+{
+    size_t i = 0;
+#ifdef FRAMEBUFFER_F16C
+    for (; i + 8 <= count; i += 8)
+    {
+        _mm256_storeu_ps(values + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(halves + i))));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        values[i] = halfToFloat(halves[i]);
+    }
+}
+
+void ColorTarget::readSpan(size_t first, size_t count, vec3* rgb) const
+{
+    switch (m_format)
+    {
+    case CF_RGB16F:
+    {
+        float planes[3][HALF_SPAN_PIXELS];
+        for (size_t done = 0; done < count; done += HALF_SPAN_PIXELS)
+        {
+            size_t chunk = MIN(static_cast<size_t>(HALF_SPAN_PIXELS), count - done);
+            for (int c = 0; c < 3; c++)
+            {
+                halfPlaneToFloat(m_planes16f[c].Data() + first + done, planes[c], chunk);
+            }
+            for (size_t i = 0; i < chunk; i++)
+            {
+                rgb[done + i] = vec3(planes[0][i], planes[1][i], planes[2][i]);
+            }
+        }
+    } break;
+    case CF_RGBA8:
+    {
+        const uint32_t* packed = m_rgba8.Data() + first;
+        for (size_t i = 0; i < count; i++)
+        {
+            rgb[i] = vec3(packed[i] & 0xFF, (packed[i] >> 8) & 0xFF, (packed[i] >> 16) & 0xFF) * (1.f / 255.f);
+        }
+    } break;
+    default:
+    {
+        const float* r = m_planes32f[0].Data() + first;
+        const float* g = m_planes32f[1].Data() + first;
+        const float* b = m_planes32f[2].Data() + first;
+        for (size_t i = 0; i < count; i++)
+        {
+            rgb[i] = vec3(r[i], g[i], b[i]);
+        }
+    } break;
+    }
+}
+
+void ColorTarget::writeSpan(size_t first, size_t count, const vec3* rgb)
+{
+    switch (m_format)
+    {
+    case CF_RGB16F:
+        for (int c = 0; c < 3; c++)
+        {
+            uint16_t* plane = m_planes16f[c].Data() + first;
+            for (size_t i = 0; i < count; i++)
+            {
+                plane[i] = floatToHalf(rgb[i][c]);
+            }
+        }
+        break;
+    case CF_RGBA8:
+    {
+        uint32_t* packed = m_rgba8.Data() + first;
+        for (size_t i = 0; i < count; i++)
+        {
+            packed[i] = packRGBA8(rgb[i]);
+        }
+    } break;
+    default:
+        for (int c = 0; c < 3; c++)
+        {
+            float* plane = m_planes32f[c].Data() + first;
+            for (size_t i = 0; i < count; i++)
+            {
+                plane[i] = rgb[i][c];
+            }
+        }
+        break;
+    }
+}
+
+void ColorTarget::packSpan(size_t first, size_t count, unsigned char* rgba) const
+{
+    switch (m_format)
+    {
+    case CF_RGB16F:
+    {
+        float planes[3][HALF_SPAN_PIXELS];
+        for (size_t done = 0; done < count; done += HALF_SPAN_PIXELS)
+        {
+            size_t chunk = MIN(static_cast<size_t>(HALF_SPAN_PIXELS), count - done);
+            for (int c = 0; c < 3; c++)
+            {
+                halfPlaneToFloat(m_planes16f[c].Data() + first + done, planes[c], chunk);
+            }
+            Util::packRGBA8(planes[0], planes[1], planes[2], rgba + done * 4, chunk);
+        }
+    } break;
+    case CF_RGBA8:
+        // already stored as R,G,B,A bytes
+        memcpy(rgba, m_rgba8.Data() + first, count * sizeof(uint32_t));
+        break;
+    default:
+        Util::packRGBA8(m_planes32f[0].Data() + first, m_planes32f[1].Data() + first, m_planes32f[2].Data() + first, rgba, count);
+        break;
+    }
+}
+
+void ColorTarget::ReadRow(int y, vec3* rgb) const
+{
+    const uint8_t* pending = m_tilePending.Data() + (y / FRAME_TILE_SIZE) * m_tilesX;
+
+    for (int tileX = 0; tileX < m_tilesX; tileX++)
+    {
+        int x0 = tileX * FRAME_TILE_SIZE;
+        int x1 = MIN(x0 + FRAME_TILE_SIZE, m_width);
+        if (pending[tileX])
+        {
+            std::fill(rgb + x0, rgb + x1, m_clearColor);
+        }
+        else
+        {
+            readSpan(Z_BUF_INDEX(m_width, x0, y), x1 - x0, rgb + x0);
+        }
+    }
+}
+
+void ColorTarget::WriteRow(int y, const vec3* rgb)
+{
+    size_t firstTile = static_cast<size_t>(y / FRAME_TILE_SIZE) * m_tilesX;
+
+    for (size_t tile = firstTile; tile < firstTile + m_tilesX; tile++)
+    {
+        if (m_tilePending[tile])
+        {
+            materializeTile(tile);
+        }
+    }
+    writeSpan(Z_BUF_INDEX(m_width, 0, y), m_width, rgb);
+}
+
+void ColorTarget::PackRGBA8(unsigned char* rgba) const
+{
+    PackRGBA8(rgba, 0, 0, m_width, m_height);
+}
+
+void ColorTarget::PackRGBA8(unsigned char* rgba, int x0, int y0, int x1, int y1) const
+{
+    uint32_t clearPacked = packRGBA8(m_clearColor);
+    size_t   rowPixels   = static_cast<size_t>(x1 - x0);
+
+    for (int y = y0; y < y1; y++)
+    {
+        const uint8_t* pending = m_tilePending.Data() + (y / FRAME_TILE_SIZE) * m_tilesX;
+        unsigned char* row     = rgba + (y - y0) * rowPixels * 4;
+
+        // handle runs of neighbouring tiles with the same state at once
+        int tileX   = x0 / FRAME_TILE_SIZE;
+        int tileEnd = (x1 + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+        while (tileX < tileEnd)
+        {
+            bool bPending = pending[tileX] != 0;
+            int  runEnd   = tileX + 1;
+            while (runEnd < tileEnd && (pending[runEnd] != 0) == bPending)
+            {
+                runEnd++;
+            }
+
+            int            spanX0 = MAX(tileX * FRAME_TILE_SIZE, x0);
+            int            spanX1 = MIN(runEnd * FRAME_TILE_SIZE, x1);
+            size_t         first  = Z_BUF_INDEX(m_width, spanX0, y);
+            unsigned char* out    = row + (spanX0 - x0) * 4;
+            if (bPending)
+            {
+                for (int x = spanX0; x < spanX1; x++, out += 4)
+                {
+                    memcpy(out, &clearPacked, sizeof(clearPacked));
+                }
+            }
+            else
+            {
+                packSpan(first, spanX1 - spanX0, out);
+            }
+            tileX = runEnd;
+        }
+    }
+}
+
+//////////////////// DepthTarget ////////////////////////
+
+DepthTarget::DepthTarget() : m_format(DF_32F), m_pixelCount(0), m_width(0), m_height(0), m_tilesX(0) {}
+
+void DepthTarget::Detach()
+{
+    m_depth32f.Detach();
+    m_depthHigh.Detach();
+    m_depthLow.Detach();
+    m_tilePending.Detach();
+    m_pixelCount = 0;
+    m_width = m_height = m_tilesX = 0;
+}
+
+void DepthTarget::Attach(FrameArena& arena, int width, int height, DEPTH_FORMAT format)
+{
+    Detach();
+
+    m_format     = format;
+    m_width      = width;
+    m_height     = height;
+    m_tilesX     = (width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE;
+    m_pixelCount = static_cast<size_t>(width) * height;
+
+    switch (m_format)
+    {
+    case DF_24:
+        m_depthHigh.Attach(arena, m_pixelCount);
+        m_depthLow .Attach(arena, m_pixelCount);
+        break;
+    case DF_16:
+        m_depthHigh.Attach(arena, m_pixelCount);
+        break;
+    default:
+        m_depth32f.Attach(arena, m_pixelCount);
+        break;
+    }
+    m_tilePending.Attach(arena, static_cast<size_t>(m_tilesX) * ((height + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE));
+
+    Clear();
+}
+
+size_t DepthTarget::ArenaBytes(int width, int height, DEPTH_FORMAT format)
+{
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    size_t tileCount  = static_cast<size_t>((width + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE) * ((height + FRAME_TILE_SIZE - 1) / FRAME_TILE_SIZE);
+    size_t tileBytes  = AlignedView<uint8_t>::ArenaBytes(tileCount);
+
+    switch (format)
+    {
+    case DF_24: return AlignedView<uint16_t>::ArenaBytes(pixelCount) + AlignedView<uint8_t>::ArenaBytes(pixelCount) + tileBytes;
+    case DF_16: return AlignedView<uint16_t>::ArenaBytes(pixelCount) + tileBytes;
+    default:    return AlignedView<float>::ArenaBytes(pixelCount) + tileBytes;
+    }
+}
+
+size_t DepthTarget::BytesPerPixel(DEPTH_FORMAT format)
+{
+    switch (format)
+    {
+    case DF_24: return sizeof(uint16_t) + sizeof(uint8_t);
+    case DF_16: return sizeof(uint16_t);
+    default:    return sizeof(float);
+    }
+}
+
+size_t DepthTarget::GetBytes() const
+{
+    return m_pixelCount * BytesPerPixel(m_format);
+}
+
+void DepthTarget::Clear()
+{
+    if (m_tilePending.Size())
+    {
+        memset(m_tilePending.Data(), 1, m_tilePending.Size());
+    }
+}
+
+void DepthTarget::materializeTile(size_t tile)
+{
+    int x0 = static_cast<int>(tile % m_tilesX) * FRAME_TILE_SIZE;
+    int y0 = static_cast<int>(tile / m_tilesX) * FRAME_TILE_SIZE;
+    int x1 = MIN(x0 + FRAME_TILE_SIZE, m_width);
+    int y1 = MIN(y0 + FRAME_TILE_SIZE, m_height);
+
+    for (int y = y0; y < y1; y++)
+    {
+        size_t first = Z_BUF_INDEX(m_width, x0, y);
+        size_t count = x1 - x0;
+        switch (m_format)
+        {
+        case DF_24:
+            memset(m_depthLow.Data() + first, 0, count * sizeof(uint8_t));
+            // fallthrough
+        case DF_16:
+            memset(m_depthHigh.Data() + first, 0, count * sizeof(uint16_t));
+            break;
+        default:
+            std::fill(m_depth32f.Data() + first, m_depth32f.Data() + first + count, -std::numeric_limits<float>::infinity());
+            break;
+        }
+    }
+
+    m_tilePending[tile] = 0;
+}
+
+void DepthTarget::Resolve()
+{
+    for (size_t tile = 0; tile < m_tilePending.Size(); tile++)
+    {
+        if (m_tilePending[tile])
+        {
+            materializeTile(tile);
+        }
+    }
+}
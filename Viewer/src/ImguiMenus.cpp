@@ -2,6 +2,7 @@
 #include "ImguiMenus.h"
 #include "Defs.h"
 #include "Face.h"
+#include "VertexCodec.h"
 #include <stdio.h>
 #include <stdlib.h>
 // open file dialog cross platform https://github.com/mlabbe/nativefiledialog
@@ -638,6 +639,30 @@ void DrawImguiMenus(ImGuiIO& io, Scene* scene)
             bModelControlFrame = true;
         }
 
+        if (ImGui::Button("Add 10000 cubes (instancing stress test)"))
+        {
+            scene->AddPrimitiveGrid(PM_CUBE, material, 10000);
+        }
+        if (scene->GetLoadingModelCount() > 0)
+        {
+            ImGui::Text("Loading %u models...", scene->GetLoadingModelCount());
+        }
+        const INSTANCING_STATS& instancing = scene->GetInstancingStats();
+        ImGui::Text("%u instances in %u draw calls, %u materials, %.1f ms/frame (%.0f FPS)", instancing.instances, instancing.drawCalls,
+                    instancing.materials, 1000.0f / io.Framerate, io.Framerate);
+        float lodErrorPixels = scene->GetLodErrorPixels();
+        if (ImGui::SliderFloat("LOD error (pixels, 0 = full detail)", &lodErrorPixels, 0.f, 8.f))
+        {
+            scene->SetLodErrorPixels(lodErrorPixels);
+        }
+        ImGui::Text("%u triangles drawn, %.1f MB vertex data fetched (%.1f MB as floats)", instancing.triangles,
+                    instancing.vertexBytes / (1024.0f * 1024.0f), instancing.vertexBytes * VERTEX_FLOAT_LAYOUT_BYTES / (sizeof(MESH_VERTEX) * 1024.0f * 1024.0f));
+        ImGui::Text("binds: %u program, %u vertex array, %u texture, %u instance ranges; %.1f KB uploaded", instancing.programBinds,
+                    instancing.vertexArrayBinds, instancing.textureBinds, instancing.instanceRebinds, instancing.uploadBytes / 1024.0f);
+        const TEXTURE_STATS textures = scene->GetTextureStats();
+        ImGui::Text("%u textures (%u shared, %u loading): %.1f MB CPU, %.1f MB GPU", textures.textures, textures.shared, textures.pending,
+                    textures.cpuBytes / (1024.0f * 1024.0f), textures.gpuBytes / (1024.0f * 1024.0f));
+
         if(bModelControlFrame)
         {
             ImGui::Text("-------------- Models Control: --------------");
@@ -929,7 +954,7 @@ void DrawImguiMenus(ImGuiIO& io, Scene* scene)
                     nfdresult_t result = NFD_OpenDialog("obj", nullptr, &outPath);
                     if (result == NFD_OKAY) {
                         ImGui::Text("Hello from another window!");
-                        scene->LoadOBJModel(outPath, material);
+                        scene->LoadOBJModelAsync(outPath, material);
                         bModelControlFrame = true;
                         free(outPath);
 
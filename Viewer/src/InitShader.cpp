@@ -4,6 +4,19 @@
 #include <fstream>
 #include <sstream>
 
+static bool isSampler(GLenum type)
+{
+    switch (type)
+    {
+    case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+    case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_BUFFER: case GL_SAMPLER_2D_MULTISAMPLE:
+    case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_BUFFER: case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+        return true;
+    default:
+        return false;
+    }
+}
+
 // get line that takes line endings into account. The stack overflow thread:
 // https://stackoverflow.com/questions/6089231/getting-std-ifstream-to-handle-lf-cr-and-crlf
 std::istream& safeGetline(std::istream& is, std::string& t)
@@ -121,6 +134,24 @@ InitShader(const string& vShaderFile, const string& fShaderFile)
 		exit( EXIT_FAILURE );
     }
 
+    // Samplers all start on unit 0, which fails validation once two of them have different types.
+    // Give each its own unit here, the callers bind the units they actually use before drawing.
+    glUseProgram(program);
+    GLint uniforms;
+    GLint unit = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniforms);
+    for (GLint i = 0; i < uniforms; i++)
+    {
+        char   name[256];
+        GLint  size;
+        GLenum type;
+        glGetActiveUniform(program, (GLuint)i, sizeof(name), nullptr, &size, &type, name);
+        if (isSampler(type))
+        {
+            glUniform1i(glGetUniformLocation(program, name), unit++);
+        }
+    }
+
     glValidateProgram(program);
     glGetProgramiv(program, GL_VALIDATE_STATUS, &linked);
     if (!linked) {
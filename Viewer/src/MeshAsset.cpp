@@ -0,0 +1,774 @@
+#include <algorithm>
+#include <float.h>
+#include <functional>
+#include "MeshAsset.h"
+#include "MeshBuffer.h"
+#include "MeshNormals.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexCodec.h"
+
+using namespace std;
+using namespace glm;
+
+
+// A struct for processing a single line in a wafefront obj file:
+// https://en.wikipedia.org/wiki/Wavefront_.obj_file
+struct FaceIdx
+{
+	// For each of the following
+	// Saves vertex indices
+	int v[FACE_ELEMENTS];
+	// Saves vertex normal indices
+	int vn[FACE_ELEMENTS];
+	// Saves vertex texture indices
+	int vt[FACE_ELEMENTS];
+
+	FaceIdx()
+	{
+		for (int i = 0; i < FACE_ELEMENTS; i++)
+			v[i] = vn[i] = vt[i] = 0;
+	}
+
+	FaceIdx(std::istream& issLine)
+	{
+		for (int i = 0; i < FACE_ELEMENTS; i++)
+			v[i] = vn[i] = vt[i] = 0;
+
+		char c;
+		for(int i = 0; i < FACE_ELEMENTS; i++)
+		{
+			issLine >> std::ws >> v[i] >> std::ws;
+			if (issLine.peek() != '/')
+			{
+				continue;
+			}
+			issLine >> c >> std::ws;
+			if (issLine.peek() == '/')
+			{
+				issLine >> c >> std::ws >> vn[i];
+				continue;
+			}
+			else
+			{
+				issLine >> vt[i];
+			}
+			if (issLine.peek() != '/')
+			{
+				continue;
+			}
+			issLine >> c >> vn[i];
+		}
+	}
+};
+
+vec3 vec3fFromStream(std::istream& issLine)
+{
+	float x, y, z;
+	issLine >> x >> std::ws >> y >> std::ws >> z;
+	return vec3(x, y, z);
+}
+
+vec2 vec2fFromStream(std::istream& issLine)
+{
+	float x, y;
+	issLine >> x >> std::ws >> y;
+	return vec2(x, y);
+}
+
+MeshAsset::MeshAsset() : m_importStats(), m_modelCentroid(ZERO_VEC3), m_minCoords(ZERO_VEC3), m_maxCoords(ZERO_VEC3), m_bUploaded(false), m_range(), m_lodError(0.f)
+{
+}
+
+MeshAsset::~MeshAsset()
+{
+    if (m_bUploaded)
+    {
+        MeshBuffer::Instance().Remove(m_range);
+    }
+}
+
+void MeshAsset::LoadStream(std::istream& ifile, bool bOptimize /*= true*/)
+{
+	vector<FaceIdx> faces;
+	vector<vec3> vertices;
+    vector<vec3> normals;
+
+    vec3 maxCoords = { -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity() };
+    vec3 minCoords = {  std::numeric_limits<float>::infinity(),  std::numeric_limits<float>::infinity(),  std::numeric_limits<float>::infinity() };
+    vec3 normalizedVec = ZERO_VEC3;
+    unsigned int numVertices = 0;
+    vec3 modelCentroid = ZERO_VEC3;
+	// while not end of file
+	while (!ifile.eof())
+	{
+		// get line
+		string curLine;
+		getline(ifile, curLine);
+
+		// read the type of the line
+		istringstream issLine(curLine);
+		string lineType;
+
+		issLine >> std::ws >> lineType;
+
+		// based on the type parse data
+		if (lineType == "v")
+        {
+            vec3 parsedVec = vec3fFromStream(issLine);
+
+            minCoords.x = (minCoords.x > parsedVec.x) ? parsedVec.x : minCoords.x;
+            minCoords.y = (minCoords.y > parsedVec.y) ? parsedVec.y : minCoords.y;
+            minCoords.z = (minCoords.z > parsedVec.z) ? parsedVec.z : minCoords.z;
+
+            maxCoords.x = (maxCoords.x < parsedVec.x) ? parsedVec.x : maxCoords.x;
+            maxCoords.y = (maxCoords.y < parsedVec.y) ? parsedVec.y : maxCoords.y;
+            maxCoords.z = (maxCoords.z < parsedVec.z) ? parsedVec.z : maxCoords.z;
+
+            m_modelCentroid += parsedVec;
+
+            numVertices++;
+
+			vertices.push_back(parsedVec);
+		}
+        else if (lineType == "vn")
+        {
+            normals.push_back(vec3fFromStream(issLine));
+        }
+		else if (lineType == "f")
+		{
+			faces.push_back(issLine);
+		}
+		else if (lineType == "#" || lineType.empty())
+		{
+			// comment / empty line
+		}
+		else
+		{
+			cout << "Found unknown line Type \"" << lineType << "\"\n";
+		}
+	}
+
+    m_modelCentroid /= (float)numVertices;
+    minCoords -= m_modelCentroid;
+    maxCoords -= m_modelCentroid;
+
+    float totalMin = MIN(minCoords.x, MIN(minCoords.y, minCoords.z));
+    float totalMax = MAX(maxCoords.x, MAX(maxCoords.y, maxCoords.z));
+
+    m_vertices.resize(vertices.size());
+    m_vertexNormals = normals;
+
+    for (size_t i = 0; i < m_vertices.size(); i++)
+    {
+        normalizedVec.x = NORMALIZE_COORDS((vertices[i].x - m_modelCentroid.x), totalMin, totalMax);
+        normalizedVec.y = NORMALIZE_COORDS((vertices[i].y - m_modelCentroid.y), totalMin, totalMax);
+        normalizedVec.z = NORMALIZE_COORDS((vertices[i].z - m_modelCentroid.z), totalMin, totalMax);
+
+        m_vertices[i] = normalizedVec;
+    }
+
+    vector<GLuint> triangles(faces.size() * FACE_ELEMENTS);
+    for (size_t f = 0; f < faces.size(); f++)
+    {
+        for (int i = 0; i < FACE_ELEMENTS; i++)
+        {
+            triangles[f * FACE_ELEMENTS + i] = faces[f].v[i] - 1;
+        }
+    }
+    if (bOptimize)
+    {
+        m_importStats = MeshOptimizer::Optimize(m_vertices, m_vertexNormals, triangles);
+    }
+    else
+    {
+        m_importStats = { (unsigned)m_vertices.size(), (unsigned)m_vertices.size(), (unsigned)faces.size(), (unsigned)faces.size() };
+    }
+    build(triangles, !normals.empty());
+
+    m_modelCentroid.x = NORMALIZE_COORDS(modelCentroid.x , totalMin, totalMax);
+    m_modelCentroid.y = NORMALIZE_COORDS(modelCentroid.y , totalMin, totalMax);
+    m_modelCentroid.z = NORMALIZE_COORDS(modelCentroid.z , totalMin, totalMax);
+
+    m_minCoords.x     = NORMALIZE_COORDS(minCoords.x     , totalMin, totalMax);
+    m_minCoords.y     = NORMALIZE_COORDS(minCoords.y     , totalMin, totalMax);
+    m_minCoords.z     = NORMALIZE_COORDS(minCoords.z     , totalMin, totalMax);
+
+    m_maxCoords.x     = NORMALIZE_COORDS(maxCoords.x     , totalMin, totalMax);
+    m_maxCoords.y     = NORMALIZE_COORDS(maxCoords.y     , totalMin, totalMax);
+    m_maxCoords.z     = NORMALIZE_COORDS(maxCoords.z     , totalMin, totalMax);
+
+    // Welding is what lets the simplifier collapse anything, an unwelded mesh is all borders
+    if (bOptimize)
+    {
+        buildLods(triangles);
+    }
+}
+
+void MeshAsset::LoadPreview(std::istream& objStream)
+{
+    objStream.seekg(0, ios::end);
+    streamoff size = objStream.tellg();
+    if (size <= 0)
+    {
+        return;
+    }
+
+    vector<vec3> points;
+    string       line;
+    points.reserve(MESH_PREVIEW_SAMPLES);
+    for (size_t sample = 0; sample < MESH_PREVIEW_SAMPLES; sample++)
+    {
+        objStream.clear();
+        objStream.seekg((streamoff)((double)size * sample / MESH_PREVIEW_SAMPLES));
+        // the rest of the line the place falls into
+        if (sample > 0)
+        {
+            getline(objStream, line);
+        }
+        for (int probe = 0; probe < MESH_PREVIEW_PROBE_LINES && getline(objStream, line); probe++)
+        {
+            if (line.size() > 2 && line[0] == 'v' && isspace((unsigned char)line[1]))
+            {
+                istringstream issLine(line.substr(2));
+                points.push_back(vec3fFromStream(issLine));
+                break;
+            }
+        }
+    }
+    if (points.empty())
+    {
+        return;
+    }
+
+    vec3 minCoords(numeric_limits<float>::infinity()), maxCoords(-numeric_limits<float>::infinity());
+    vec3 centroid = ZERO_VEC3;
+    for (const vec3& point : points)
+    {
+        minCoords = glm::min(minCoords, point);
+        maxCoords = glm::max(maxCoords, point);
+        centroid += point;
+    }
+    centroid  /= (float)points.size();
+    minCoords -= centroid;
+    maxCoords -= centroid;
+    float totalMin = MIN(minCoords.x, MIN(minCoords.y, minCoords.z));
+    float totalMax = MAX(maxCoords.x, MAX(maxCoords.y, maxCoords.z));
+    if (!(totalMax > totalMin))
+    {
+        return;
+    }
+
+    const int    grid = MESH_PREVIEW_GRID;
+    vector<bool> occupied(grid * grid * grid, false);
+    for (const vec3& point : points)
+    {
+        int cell[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float normalized = NORMALIZE_COORDS(point[axis] - centroid[axis], totalMin, totalMax);
+            cell[axis] = MIN(MAX((int)((normalized + 1.f) * 0.5f * grid), 0), grid - 1);
+        }
+        occupied[(cell[2] * grid + cell[1]) * grid + cell[0]] = true;
+    }
+
+    // The samples cover a shell, which is only closed through the edges and corners of its voxels where the
+    // surface runs diagonally. The outside is flooded around the shell grown by a voxel; what it does not reach,
+    // shrunk back by a voxel, is filled, so that only the outer faces of the shell are emitted.
+    auto forNeighbours = [grid](int cell, bool bDiagonal, const function<void(int)>& visit)
+    {
+        int position[3] = { cell % grid, (cell / grid) % grid, cell / (grid * grid) };
+        for (int offset = 0; offset < 27; offset++)
+        {
+            int delta[3] = { offset % 3 - 1, (offset / 3) % 3 - 1, offset / 9 - 1 };
+            int steps    = abs(delta[0]) + abs(delta[1]) + abs(delta[2]);
+            if (steps == 0 || (!bDiagonal && steps > 1))
+            {
+                continue;
+            }
+            int neighbour[3] = { position[0] + delta[0], position[1] + delta[1], position[2] + delta[2] };
+            bool bInside = true;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                bInside = bInside && neighbour[axis] >= 0 && neighbour[axis] < grid;
+            }
+            visit(bInside ? (neighbour[2] * grid + neighbour[1]) * grid + neighbour[0] : -1);
+        }
+    };
+
+    const int    cellCount = grid * grid * grid;
+    vector<bool> grown(occupied);
+    for (int cell = 0; cell < cellCount; cell++)
+    {
+        if (occupied[cell])
+        {
+            forNeighbours(cell, true, [&grown](int neighbour) { if (neighbour >= 0) grown[neighbour] = true; });
+        }
+    }
+
+    vector<bool> outside(cellCount, false);
+    vector<int>  front;
+    for (int cell = 0; cell < cellCount; cell++)
+    {
+        bool bBorder = false;
+        forNeighbours(cell, false, [&bBorder](int neighbour) { bBorder = bBorder || neighbour < 0; });
+        if (bBorder && !grown[cell])
+        {
+            outside[cell] = true;
+            front.push_back(cell);
+        }
+    }
+    while (!front.empty())
+    {
+        int cell = front.back();
+        front.pop_back();
+        forNeighbours(cell, false, [&](int neighbour)
+        {
+            if (neighbour >= 0 && !grown[neighbour] && !outside[neighbour])
+            {
+                outside[neighbour] = true;
+                front.push_back(neighbour);
+            }
+        });
+    }
+    for (int cell = 0; cell < cellCount; cell++)
+    {
+        // a voxel next to the outside only belongs to the grown shell, the sampled ones stay in any case
+        bool bNearOutside = false;
+        forNeighbours(cell, true, [&](int neighbour) { bNearOutside = bNearOutside || neighbour < 0 || outside[neighbour]; });
+        if (!outside[cell] && !bNearOutside)
+        {
+            occupied[cell] = true;
+        }
+    }
+
+    // The faces between covered and empty voxels, wound like the faces of the obj files: cross(p3 - p1, p2 - p1)
+    // points out. Voxel corners are shared, the normals are split along the creases.
+    map<int, GLuint> cornerIndex;
+    vector<GLuint>   triangles;
+    auto corner = [&](int x, int y, int z) -> GLuint
+    {
+        auto inserted = cornerIndex.insert({ (z * (grid + 1) + y) * (grid + 1) + x, (GLuint)m_vertices.size() });
+        if (inserted.second)
+        {
+            m_vertices.push_back(vec3(x, y, z) * (2.f / grid) - vec3(1.f));
+        }
+        return inserted.first->second;
+    };
+    for (int z = 0; z < grid; z++)
+    {
+        for (int y = 0; y < grid; y++)
+        {
+            for (int x = 0; x < grid; x++)
+            {
+                if (!occupied[(z * grid + y) * grid + x])
+                {
+                    continue;
+                }
+                for (int side = 0; side < 6; side++)
+                {
+                    int axis = side / 2, sign = (side % 2) ? 1 : -1;
+                    int cell[3] = { x, y, z };
+                    cell[axis] += sign;
+                    if (cell[axis] >= 0 && cell[axis] < grid && occupied[(cell[2] * grid + cell[1]) * grid + cell[0]])
+                    {
+                        continue;
+                    }
+
+                    // the quad spans the two other axes, u x v is the axis
+                    int base[3] = { x, y, z };
+                    base[axis] += (sign > 0) ? 1 : 0;
+                    int u = (axis + 1) % 3, v = (axis + 2) % 3;
+                    GLuint quad[4];
+                    for (int k = 0; k < 4; k++)
+                    {
+                        int point[3] = { base[0], base[1], base[2] };
+                        point[u] += (k == 1 || k == 2) ? 1 : 0;
+                        point[v] += (k >= 2) ? 1 : 0;
+                        quad[k] = corner(point[0], point[1], point[2]);
+                    }
+                    if (sign > 0)
+                    {
+                        triangles.insert(triangles.end(), { quad[0], quad[2], quad[1], quad[0], quad[3], quad[2] });
+                    }
+                    else
+                    {
+                        triangles.insert(triangles.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+                    }
+                }
+            }
+        }
+    }
+
+    build(triangles, false);
+
+    // as LoadStream has them, the models keep their place when the full mesh replaces the preview
+    for (int axis = 0; axis < 3; axis++)
+    {
+        m_modelCentroid[axis] = NORMALIZE_COORDS(0.f, totalMin, totalMax);
+        m_minCoords[axis]     = NORMALIZE_COORDS(minCoords[axis], totalMin, totalMax);
+        m_maxCoords[axis]     = NORMALIZE_COORDS(maxCoords[axis], totalMin, totalMax);
+    }
+    m_importStats = { (unsigned)points.size(), (unsigned)m_vertices.size(), 0, (unsigned)m_polygons.size() };
+}
+
+// Shared by every mesh that needs normals, the levels of detail of one load alone call Generate up to
+// MESH_LOD_MAX_LEVELS + 1 times
+static ThreadPool& normalsPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void MeshAsset::build(const std::vector<GLuint>& triangles, bool bHasNormals)
+{
+    size_t faceCount = triangles.size() / FACE_ELEMENTS;
+
+    // Files without vn lines get smooth normals, split along creases, instead of zero ones
+    vector<vec3> cornerNormals;
+    if (!bHasNormals && faceCount > 0)
+    {
+        MeshNormals::Generate(m_vertices, triangles, NW_ANGLE, MESH_NORMALS_CREASE_ANGLE, m_vertexNormals, cornerNormals, &normalsPool());
+    }
+
+    m_polygons.resize(faceCount);
+    m_vertexPositions.resize(triangles.size());
+
+    // Edges shared by neighbouring faces are stored once, keyed by their ordered vertex indices
+    vector<unsigned long long> edgeKeys;
+    edgeKeys.reserve(triangles.size());
+
+	// iterate through all triangles and create the polygons
+    for (size_t f = 0; f < faceCount; f++)
+	{
+        const GLuint* face = &triangles[f * FACE_ELEMENTS];
+        for (int i = 0; i < FACE_ELEMENTS; i++)
+        {
+            unsigned int v1 = face[i];
+            unsigned int v2 = face[(i + 1) % FACE_ELEMENTS];
+            edgeKeys.push_back(EDGE_KEY(MIN(v1, v2), MAX(v1, v2)));
+        }
+
+        pair<vec3, vec3> currentFace[FACE_ELEMENTS];
+		for (int i = 0; i < FACE_ELEMENTS; i++)
+		{
+            GLuint vertexIdx = face[i];
+            vec3   normal    = (vertexIdx < m_vertexNormals.size()) ? m_vertexNormals[vertexIdx] : vec3(0.f);
+            currentFace[i] = { m_vertices[vertexIdx], cornerNormals.empty() ? normal : cornerNormals[f * FACE_ELEMENTS + i] };
+            m_vertexPositions[f * FACE_ELEMENTS + i] = m_vertices[vertexIdx];
+		}
+
+        auto nrm1_3 = currentFace[0].first;
+        auto nrm2_3 = currentFace[1].first;
+        auto nrm3_3 = currentFace[2].first;
+
+        auto subs1 = nrm3_3 - nrm1_3;
+        auto subs2 = nrm2_3 - nrm1_3;
+
+        auto faceNormal = cross(subs1, subs2);
+
+        auto faceCenter = (nrm1_3 + nrm2_3 + nrm3_3) / 3.0f;
+
+        auto normalizedFaceNormal = Util::isVecEqual(faceNormal, vec3(0)) ? faceNormal : normalize(faceNormal);
+
+        Face currentPolygon(currentFace[0].first, currentFace[1].first, currentFace[2].first, faceCenter, normalizedFaceNormal, nullptr, currentFace[0].second, currentFace[1].second, currentFace[2].second);
+        m_polygons[f] = currentPolygon;
+	}
+
+    sort(edgeKeys.begin(), edgeKeys.end());
+    edgeKeys.erase(unique(edgeKeys.begin(), edgeKeys.end()), edgeKeys.end());
+    m_edges.resize(edgeKeys.size());
+    for (size_t i = 0; i < edgeKeys.size(); i++)
+    {
+        m_edges[i] = { static_cast<unsigned int>(edgeKeys[i] >> 32), static_cast<unsigned int>(edgeKeys[i] & 0xFFFFFFFF) };
+    }
+}
+
+void MeshAsset::buildLods(const std::vector<GLuint>& triangles)
+{
+    // Each level is simplified from the previous one to about half its triangles; the error estimates add up
+    vector<vec3>   vertices       = m_vertices;
+    vector<GLuint> levelTriangles = triangles;
+    float          error          = 0.f;
+    while (m_lods.size() < MESH_LOD_MAX_LEVELS && levelTriangles.size() / FACE_ELEMENTS >= 2 * MESH_LOD_MIN_TRIANGLES)
+    {
+        size_t         faceCount = levelTriangles.size() / FACE_ELEMENTS;
+        vector<vec3>   simplifiedVertices;
+        vector<GLuint> simplifiedTriangles;
+        error += MeshSimplifier::Simplify(vertices, levelTriangles, faceCount / 2, simplifiedVertices, simplifiedTriangles);
+        // the remaining collapses would all fold the surface, a level this close to the previous one is not worth it
+        if (simplifiedTriangles.size() / FACE_ELEMENTS > faceCount * 3 / 4)
+        {
+            break;
+        }
+
+        unique_ptr<MeshAsset> lod(new MeshAsset());
+        lod->m_vertices      = simplifiedVertices;
+        lod->m_importStats   = { (unsigned)simplifiedVertices.size(), (unsigned)simplifiedVertices.size(),
+                                 (unsigned)(simplifiedTriangles.size() / FACE_ELEMENTS), (unsigned)(simplifiedTriangles.size() / FACE_ELEMENTS) };
+        lod->m_modelCentroid = m_modelCentroid;
+        lod->m_minCoords     = m_minCoords;
+        lod->m_maxCoords     = m_maxCoords;
+        lod->m_lodError      = error;
+        // the simplified vertices have no file normals any more
+        lod->build(simplifiedTriangles, false);
+        m_lods.push_back(move(lod));
+
+        vertices.swap(simplifiedVertices);
+        levelTriangles.swap(simplifiedTriangles);
+    }
+}
+
+void MeshAsset::BuildBufferData(std::vector<MESH_VERTEX>& vertices, std::vector<GLuint>& indices) const
+{
+    // Every triangle corner gets its own vertex, which knows the corner it is: the fragment shader derives the
+    // distance to the nearest edge from the barycentric coordinate for the wireframe overlay.
+    vertices.resize(m_vertexPositions.size());
+    indices.resize(m_vertexPositions.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Face& face = m_polygons[i / FACE_ELEMENTS];
+        int         corner = (int)(i % FACE_ELEMENTS);
+        VertexCodec::EncodePosition(m_vertexPositions[i], vertices[i].position);
+        vertices[i].position[3] = (GLshort)corner;
+        VertexCodec::EncodeNormal((corner == 0) ? face.m_vn1 : (corner == 1) ? face.m_vn2 : face.m_vn3, vertices[i].normal);
+        indices[i] = (GLuint)i;
+    }
+}
+
+void MeshAsset::Upload()
+{
+    vector<MESH_VERTEX> vertices;
+    vector<GLuint>      indices;
+    BuildBufferData(vertices, indices);
+
+    m_range     = MeshBuffer::Instance().Add(vertices, indices);
+    m_bUploaded = true;
+
+    for (auto& lod : m_lods)
+    {
+        lod->Upload();
+    }
+}
+
+const MeshAsset& MeshAsset::SelectLod(const glm::mat4x4& mvp, const glm::vec2& pixelsPerNdc, float errorPixels) const
+{
+    if (m_lods.empty() || errorPixels <= 0.f)
+    {
+        return *this;
+    }
+
+    // Pixels a model space step covers at most, from the derivative of the projection at the corners of the
+    // bounding box (its largest value within the box is at a corner). The length of the per axis derivatives
+    // bounds the step in any direction.
+    float pixelsPerUnit = 0.f;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        vec3 position((corner & 1) ? m_maxCoords.x : m_minCoords.x, (corner & 2) ? m_maxCoords.y : m_minCoords.y,
+                      (corner & 4) ? m_maxCoords.z : m_minCoords.z);
+        vec4 clip = mvp * vec4(position, 1.f);
+        // the box reaches the eye, nothing bounds the error there
+        if (clip.w <= FLT_EPSILON)
+        {
+            return *this;
+        }
+
+        float squaredPixels = 0.f;
+        for (int axis = 0; axis < 3; axis++)
+        {
+            const vec4& column = mvp[axis];
+            float dx = pixelsPerNdc.x * (column.x * clip.w - clip.x * column.w) / (clip.w * clip.w);
+            float dy = pixelsPerNdc.y * (column.y * clip.w - clip.y * column.w) / (clip.w * clip.w);
+            squaredPixels += dx * dx + dy * dy;
+        }
+        pixelsPerUnit = MAX(pixelsPerUnit, sqrt(squaredPixels));
+    }
+
+    const MeshAsset* level = this;
+    for (auto& lod : m_lods)
+    {
+        if (lod->m_lodError * pixelsPerUnit > errorPixels)
+        {
+            break;
+        }
+        level = lod.get();
+    }
+    return *level;
+}
+
+size_t MeshAsset::GetMemoryBytes(bool bLods) const
+{
+    size_t lodBytes = 0;
+    for (auto& lod : m_lods)
+    {
+        lodBytes += bLods ? lod->GetMemoryBytes() : 0;
+    }
+    return (m_vertices.capacity() + m_vertexNormals.capacity() + m_vertexPositions.capacity()) * sizeof(vec3) +
+           m_polygons.capacity() * sizeof(Face) + m_edges.capacity() * sizeof(EDGE) + lodBytes;
+}
+
+MeshAssetRegistry::MeshAssetRegistry() : m_stats(), m_bOptimizeImports(true)
+{
+}
+
+MeshAssetRegistry& MeshAssetRegistry::Instance()
+{
+    static MeshAssetRegistry registry;
+    return registry;
+}
+
+PMeshAsset MeshAssetRegistry::store(const std::string& key, size_t sourceHash, PMeshAsset asset)
+{
+    m_assets[key] = { asset, sourceHash, shared_future<PMeshAsset>() };
+    m_stats.loads++;
+    return asset;
+}
+
+PMeshAsset MeshAssetRegistry::acquire(const std::string& key, size_t sourceHash, GLuint program, const std::function<void(MeshAsset&, bool)>& load)
+{
+    promise<PMeshAsset> loaded;
+    bool                bOptimize;
+    {
+        unique_lock<mutex> lock(m_mutex);
+        for (;;)
+        {
+            auto it = m_assets.find(key);
+            if (it == m_assets.end() || it->second.sourceHash != sourceHash)
+            {
+                break;
+            }
+            if (it->second.loading.valid())
+            {
+                // another thread parses the same source, its asset is published before the future is ready
+                shared_future<PMeshAsset> loading = it->second.loading;
+                lock.unlock();
+                loading.wait();
+                lock.lock();
+                continue;
+            }
+            shared_ptr<const MeshAsset> asset = it->second.asset.lock();
+            // an asset loaded by the headless renderer has no buffers yet
+            if (asset && (program == 0 || asset->m_bUploaded))
+            {
+                m_stats.shared++;
+                return asset;
+            }
+            break;
+        }
+        m_assets[key] = { weak_ptr<const MeshAsset>(), sourceHash, loaded.get_future().share() };
+        bOptimize     = m_bOptimizeImports;
+    }
+
+    shared_ptr<MeshAsset> asset = make_shared<MeshAsset>();
+    try
+    {
+        load(*asset, bOptimize);
+        // Without a shader program there is no GL context (headless rendering), the mesh only feeds the software renderer
+        if (program != 0)
+        {
+            asset->Upload();
+        }
+    }
+    catch (...)
+    {
+        // the threads waiting for it load the source themselves
+        {
+            lock_guard<mutex> lock(m_mutex);
+            auto it = m_assets.find(key);
+            if (it != m_assets.end() && it->second.sourceHash == sourceHash && it->second.asset.expired())
+            {
+                m_assets.erase(it);
+            }
+        }
+        loaded.set_value(nullptr);
+        throw;
+    }
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        store(key, sourceHash, asset);
+    }
+    loaded.set_value(asset);
+    return asset;
+}
+
+PMeshAsset MeshAssetRegistry::Acquire(const std::string& path, GLuint program)
+{
+    return acquire(path, 0, program, [&path](MeshAsset& asset, bool bOptimize)
+    {
+        ifstream ifile(path.c_str());
+        if (ifile.fail())
+        {
+            fprintf(stderr, "Opening file %s failed, goodbye cruel world - harakiri!!!", path.c_str());
+            exit(RC_IO_ERROR);
+        }
+        asset.LoadStream(ifile, bOptimize);
+    });
+}
+
+PMeshAsset MeshAssetRegistry::Acquire(const std::string& key, const std::string& objData, GLuint program)
+{
+    // hashing the text is cheap next to parsing it; 0 is reserved for files
+    size_t sourceHash = MAX(hash<string>()(objData), (size_t)1);
+
+    return acquire(key, sourceHash, program, [&objData](MeshAsset& asset, bool bOptimize)
+    {
+        istringstream objStream(objData);
+        asset.LoadStream(objStream, bOptimize);
+    });
+}
+
+PMeshAsset MeshAssetRegistry::Find(const std::string& path, GLuint program)
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    auto it = m_assets.find(path);
+    if (it == m_assets.end() || it->second.sourceHash != 0)
+    {
+        return nullptr;
+    }
+    shared_ptr<const MeshAsset> asset = it->second.asset.lock();
+    if (asset && (program == 0 || asset->m_bUploaded))
+    {
+        m_stats.shared++;
+        return asset;
+    }
+    return nullptr;
+}
+
+PMeshAsset MeshAssetRegistry::Register(const std::string& path, PMeshAsset asset)
+{
+    lock_guard<mutex> lock(m_mutex);
+    return store(path, 0, asset);
+}
+
+void MeshAssetRegistry::SetImportOptimization(bool bOptimize)
+{
+    lock_guard<mutex> lock(m_mutex);
+    m_bOptimizeImports = bOptimize;
+}
+
+MESH_ASSET_STATS MeshAssetRegistry::GetStats()
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    MESH_ASSET_STATS stats = m_stats;
+    stats.live = 0;
+    for (auto it = m_assets.begin(); it != m_assets.end();)
+    {
+        if (it->second.loading.valid())
+        {
+            ++it;
+        }
+        else if (it->second.asset.expired())
+        {
+            it = m_assets.erase(it);
+        }
+        else
+        {
+            stats.live++;
+            ++it;
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include "MeshBuffer.h"
+
+using namespace std;
+
+MeshBuffer::MeshBuffer() : m_VAO(0), m_vertexBuffer(0), m_indexBuffer(0), m_vertexCapacity(0), m_vertexEnd(0), m_indexCapacity(0), m_indexEnd(0)
+{
+}
+
+MeshBuffer::~MeshBuffer()
+{
+    if (m_VAO != 0)
+    {
+        glDeleteVertexArrays(1, &m_VAO);
+        glDeleteBuffers(1, &m_vertexBuffer);
+        glDeleteBuffers(1, &m_indexBuffer);
+    }
+}
+
+MeshBuffer& MeshBuffer::Instance()
+{
+    static MeshBuffer buffer;
+    return buffer;
+}
+
+void MeshBuffer::create()
+{
+    m_vertexCapacity = MESH_BUFFER_INITIAL_VERTICES;
+    m_indexCapacity  = MESH_BUFFER_INITIAL_INDICES;
+
+    glGenVertexArrays(1, &m_VAO);
+    glBindVertexArray(m_VAO);
+
+    glGenBuffers(1, &m_vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, m_vertexCapacity * sizeof(MESH_VERTEX), nullptr, GL_STATIC_DRAW);
+    bindVertexAttributes();
+
+    // the element buffer binding is part of the VAO
+    glGenBuffers(1, &m_indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_indexCapacity * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MeshBuffer::bindVertexAttributes()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+
+    // integer attributes, the shader does the snorm conversion itself: GL before 4.2 maps 0 to no exact value
+    glVertexAttribIPointer(0, 4, GL_SHORT, sizeof(MESH_VERTEX), (GLvoid*)offsetof(MESH_VERTEX, position));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribIPointer(1, 2, GL_SHORT, sizeof(MESH_VERTEX), (GLvoid*)offsetof(MESH_VERTEX, position));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribIPointer(2, 2, GL_SHORT, sizeof(MESH_VERTEX), (GLvoid*)offsetof(MESH_VERTEX, normal));
+    glEnableVertexAttribArray(2);
+}
+
+size_t MeshBuffer::allocate(std::vector<SPAN>& freeSpans, size_t& end, size_t& capacity, size_t count, GLenum target, size_t elementSize)
+{
+    for (size_t i = 0; i < freeSpans.size(); i++)
+    {
+        if (freeSpans[i].second >= count)
+        {
+            size_t first = freeSpans[i].first;
+            freeSpans[i].first  += count;
+            freeSpans[i].second -= count;
+            if (freeSpans[i].second == 0)
+            {
+                freeSpans.erase(freeSpans.begin() + i);
+            }
+            return first;
+        }
+    }
+
+    if (end + count > capacity)
+    {
+        size_t newCapacity = MAX(2 * capacity, end + count);
+        GLuint oldBuffer   = (target == GL_ARRAY_BUFFER) ? m_vertexBuffer : m_indexBuffer;
+        GLuint newBuffer   = 0;
+
+        glGenBuffers(1, &newBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, newBuffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, newCapacity * elementSize, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, end * elementSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &oldBuffer);
+
+        glBindVertexArray(m_VAO);
+        if (target == GL_ARRAY_BUFFER)
+        {
+            m_vertexBuffer = newBuffer;
+            bindVertexAttributes();
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        else
+        {
+            m_indexBuffer = newBuffer;
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+        }
+        glBindVertexArray(0);
+        capacity = newCapacity;
+    }
+
+    size_t first = end;
+    end += count;
+    return first;
+}
+
+void MeshBuffer::release(std::vector<SPAN>& freeSpans, size_t& end, SPAN span)
+{
+    auto it = lower_bound(freeSpans.begin(), freeSpans.end(), span);
+    it = freeSpans.insert(it, span);
+
+    // merge with the neighbours
+    if (it + 1 != freeSpans.end() && it->first + it->second == (it + 1)->first)
+    {
+        it->second += (it + 1)->second;
+        freeSpans.erase(it + 1);
+    }
+    if (it != freeSpans.begin() && (it - 1)->first + (it - 1)->second == it->first)
+    {
+        (it - 1)->second += it->second;
+        it = freeSpans.erase(it) - 1;
+    }
+
+    // a free span at the end gives the space back to the tail
+    if (it->first + it->second == end)
+    {
+        end = it->first;
+        freeSpans.erase(it);
+    }
+}
+
+MESH_RANGE MeshBuffer::Reserve(size_t vertexCount, size_t indexCount)
+{
+    if (m_VAO == 0)
+    {
+        create();
+    }
+
+    MESH_RANGE range;
+    range.baseVertex  = (GLint)allocate(m_freeVertices, m_vertexEnd, m_vertexCapacity, vertexCount, GL_ARRAY_BUFFER, sizeof(MESH_VERTEX));
+    range.vertexCount = (GLuint)vertexCount;
+    range.firstIndex  = (GLuint)allocate(m_freeIndices, m_indexEnd, m_indexCapacity, indexCount, GL_ELEMENT_ARRAY_BUFFER, sizeof(GLuint));
+    range.indexCount  = (GLuint)indexCount;
+    return range;
+}
+
+// through the copy targets, binding the element buffer would need the VAO
+void MeshBuffer::WriteVertices(const MESH_RANGE& range, size_t first, const MESH_VERTEX* vertices, size_t count)
+{
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vertexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (range.baseVertex + first) * sizeof(MESH_VERTEX), count * sizeof(MESH_VERTEX), vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void MeshBuffer::WriteIndices(const MESH_RANGE& range, size_t first, const GLuint* indices, size_t count)
+{
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_indexBuffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (range.firstIndex + first) * sizeof(GLuint), count * sizeof(GLuint), indices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+MESH_RANGE MeshBuffer::Add(const std::vector<MESH_VERTEX>& vertices, const std::vector<GLuint>& indices)
+{
+    MESH_RANGE range = Reserve(vertices.size(), indices.size());
+    WriteVertices(range, 0, vertices.data(), vertices.size());
+    WriteIndices(range, 0, indices.data(), indices.size());
+    return range;
+}
+
+void MeshBuffer::Remove(const MESH_RANGE& range)
+{
+    if (range.vertexCount > 0)
+    {
+        release(m_freeVertices, m_vertexEnd, SPAN(range.baseVertex, range.vertexCount));
+    }
+    if (range.indexCount > 0)
+    {
+        release(m_freeIndices, m_indexEnd, SPAN(range.firstIndex, range.indexCount));
+    }
+}
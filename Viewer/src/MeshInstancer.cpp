@@ -0,0 +1,250 @@
+#include <string.h>
+#include "MeshInstancer.h"
+#include "MeshBuffer.h"
+
+using namespace std;
+using namespace glm;
+
+#define INSTANCE_ATTRIB_MODEL            3   // mat4, one vec4 column per location 3..6
+#define INSTANCE_ATTRIB_MATERIAL         7
+#define MATERIAL_TEXTURE_UNIT            1
+#define MODEL_TEXTURE_UNIT               0   // the model textures are bound while unit 0 is active
+
+MeshInstancer::MeshInstancer() : m_lastKey(0, nullptr), m_lastGroup(nullptr), m_instanceBuffer(0), m_instanceCapacity(0),
+                                 m_materialBuffer(0), m_materialTexture(0), m_stats()
+{
+}
+
+MeshInstancer::~MeshInstancer()
+{
+    if (m_instanceBuffer != 0)
+    {
+        glDeleteBuffers(1, &m_instanceBuffer);
+    }
+    if (m_materialTexture != 0)
+    {
+        glDeleteTextures(1, &m_materialTexture);
+    }
+    if (m_materialBuffer != 0)
+    {
+        glDeleteBuffers(1, &m_materialBuffer);
+    }
+}
+
+GLuint MeshInstancer::materialIndex(const Surface& surface)
+{
+    vec4 ambient = vec4(vec3(surface.m_ambientColor) * surface.m_ambientReflectionRate, 1.f);
+    if (!m_materials.empty() && m_materials.back() == ambient)
+    {
+        return (GLuint)m_materials.size() - 1;
+    }
+
+    auto inserted = m_materialIndex.insert({ MATERIAL_KEY(ambient.x, ambient.y, ambient.z, ambient.w), (GLuint)m_materials.size() });
+    if (inserted.second)
+    {
+        m_materials.push_back(ambient);
+    }
+    return inserted.first->second;
+}
+
+void MeshInstancer::Begin()
+{
+    for (auto& entry : m_groups)
+    {
+        entry.second.instances.clear();
+    }
+    m_materials.clear();
+    m_materialIndex.clear();
+    m_lastGroup = nullptr;
+    m_stats     = INSTANCING_STATS();
+}
+
+void MeshInstancer::Add(const MeshModel& model, const glm::mat4x4& transformation, const MeshAsset* level /*= nullptr*/)
+{
+    const PMeshAsset& asset = model.GetAsset();
+    // meshes loaded without a GL context are not in the MeshBuffer
+    if (!asset || !asset->m_bUploaded)
+    {
+        return;
+    }
+    const MeshAsset* mesh = (level != nullptr && level->m_bUploaded) ? level : asset.get();
+
+    GROUP_KEY key(model.GetTexture(), mesh);
+    if (m_lastGroup == nullptr || key != m_lastKey)
+    {
+        Group& group = m_groups[key];
+        group.asset  = asset;
+        group.mesh   = mesh;
+        m_lastKey    = key;
+        m_lastGroup  = &group;
+    }
+
+    m_lastGroup->instances.push_back({ transformation, materialIndex(model.m_surface) });
+}
+
+void MeshInstancer::uploadInstances()
+{
+    size_t count = m_instances.size();
+    if (count == 0)
+    {
+        return;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    if (count > m_instanceCapacity || count != m_uploadedInstances.size())
+    {
+        if (count > m_instanceCapacity)
+        {
+            m_instanceCapacity = count + count / 2;
+            glBufferData(GL_ARRAY_BUFFER, m_instanceCapacity * sizeof(MESH_INSTANCE), nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(MESH_INSTANCE), m_instances.data());
+        m_stats.uploadBytes += count * sizeof(MESH_INSTANCE);
+    }
+    else
+    {
+        // typically one model moves, only its part of the buffer is sent
+        size_t first = 0, last = count;
+        while (first < count && memcmp(&m_instances[first], &m_uploadedInstances[first], sizeof(MESH_INSTANCE)) == 0)
+        {
+            first++;
+        }
+        while (last > first && memcmp(&m_instances[last - 1], &m_uploadedInstances[last - 1], sizeof(MESH_INSTANCE)) == 0)
+        {
+            last--;
+        }
+        if (first < last)
+        {
+            glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(MESH_INSTANCE), (last - first) * sizeof(MESH_INSTANCE), &m_instances[first]);
+            m_stats.uploadBytes += (last - first) * sizeof(MESH_INSTANCE);
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_uploadedInstances = m_instances;
+}
+
+void MeshInstancer::uploadMaterials()
+{
+    if (m_materials == m_uploadedMaterials || m_materials.empty())
+    {
+        return;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, m_materialBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, m_materials.size() * sizeof(vec4), m_materials.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_BUFFER, m_materialTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_materialBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    m_uploadedMaterials = m_materials;
+    m_stats.uploadBytes += m_materials.size() * sizeof(vec4);
+}
+
+void MeshInstancer::pointInstanceAttributes(size_t firstInstance)
+{
+    size_t offset = firstInstance * sizeof(MESH_INSTANCE);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glVertexAttribPointer(INSTANCE_ATTRIB_MODEL + column, 4, GL_FLOAT, GL_FALSE, sizeof(MESH_INSTANCE),
+                              (GLvoid*)(offset + offsetof(MESH_INSTANCE, model) + sizeof(vec4) * column));
+    }
+    glVertexAttribIPointer(INSTANCE_ATTRIB_MATERIAL, 1, GL_UNSIGNED_INT, sizeof(MESH_INSTANCE),
+                           (GLvoid*)(offset + offsetof(MESH_INSTANCE, material)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_stats.instanceRebinds++;
+}
+
+void MeshInstancer::Draw(GLuint program)
+{
+    MeshBuffer& meshBuffer = MeshBuffer::Instance();
+
+    // the groups without instances go, the others are laid out in draw order
+    m_instances.clear();
+    for (auto it = m_groups.begin(); it != m_groups.end();)
+    {
+        if (it->second.instances.empty())
+        {
+            it = m_groups.erase(it);
+            continue;
+        }
+        m_instances.insert(m_instances.end(), it->second.instances.begin(), it->second.instances.end());
+        ++it;
+    }
+    m_lastGroup = nullptr;
+    if (m_instances.empty())
+    {
+        return;
+    }
+
+    if (m_instanceBuffer == 0)
+    {
+        glGenBuffers(1, &m_instanceBuffer);
+        glGenBuffers(1, &m_materialBuffer);
+        glGenTextures(1, &m_materialTexture);
+    }
+    uploadInstances();
+    uploadMaterials();
+    m_stats.materials = (unsigned)m_materials.size();
+
+    GLint currentProgram = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+    if ((GLuint)currentProgram != program)
+    {
+        glUseProgram(program);
+        m_stats.programBinds++;
+    }
+    glActiveTexture(GL_TEXTURE0 + MATERIAL_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_materialTexture);
+    glActiveTexture(GL_TEXTURE0);
+    m_stats.textureBinds++;
+    // both samplers are set, InitShader hands out units in whatever order the driver lists the uniforms
+    glUniform1i(glGetUniformLocation(program, "textureSampler"), MODEL_TEXTURE_UNIT);
+    glUniform1i(glGetUniformLocation(program, "materials"), MATERIAL_TEXTURE_UNIT);
+    GLint useTexture = glGetUniformLocation(program, "useTexture");
+
+    glBindVertexArray(meshBuffer.GetVAO());
+    m_stats.vertexArrayBinds++;
+    for (GLuint column = 0; column < 4; column++)
+    {
+        glEnableVertexAttribArray(INSTANCE_ATTRIB_MODEL + column);
+        glVertexAttribDivisor(INSTANCE_ATTRIB_MODEL + column, 1);
+    }
+    glEnableVertexAttribArray(INSTANCE_ATTRIB_MATERIAL);
+    glVertexAttribDivisor(INSTANCE_ATTRIB_MATERIAL, 1);
+
+    GLuint boundTexture = 0;
+    bool   bFirst       = true;
+    size_t firstInstance = 0;
+    for (auto& entry : m_groups)
+    {
+        GLuint           texture = entry.first.first;
+        const Group&     group   = entry.second;
+        const MESH_RANGE& range  = group.mesh->m_range;
+
+        if (bFirst || texture != boundTexture)
+        {
+            if (texture != 0)
+            {
+                glBindTexture(GL_TEXTURE_2D, texture);
+                m_stats.textureBinds++;
+            }
+            glUniform1i(useTexture, texture != 0 ? GL_TRUE : GL_FALSE);
+            boundTexture = texture;
+            bFirst       = false;
+        }
+
+        pointInstanceAttributes(firstInstance);
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT, (GLvoid*)(range.firstIndex * sizeof(GLuint)),
+                                          (GLsizei)group.instances.size(), range.baseVertex);
+
+        firstInstance += group.instances.size();
+        m_stats.drawCalls++;
+        m_stats.instances += (unsigned)group.instances.size();
+        m_stats.triangles += (unsigned)(group.instances.size() * group.mesh->m_polygons.size());
+        m_stats.vertexBytes += group.instances.size() * range.vertexCount * sizeof(MESH_VERTEX);
+    }
+    glBindVertexArray(0);
+}
@@ -0,0 +1,152 @@
+#include <float.h>
+#include <functional>
+#include "MeshNormals.h"
+
+using namespace std;
+using namespace glm;
+
+// Splits [0, count) in a few pieces per worker, runs inline without a pool. Waits for its own pieces only,
+// ThreadPool::Wait would also wait for whatever other users of a shared pool queued.
+static void parallelFor(ThreadPool* pool, size_t count, const function<void(size_t, size_t)>& body)
+{
+    if (pool == nullptr)
+    {
+        body(0, count);
+        return;
+    }
+
+    size_t pieces = (size_t)pool->GetThreadCount() * 4;
+    size_t step   = MAX((count + pieces - 1) / pieces, (size_t)1);
+
+    mutex              doneMutex;
+    condition_variable done;
+    size_t             remaining = (count + step - 1) / step;
+    for (size_t first = 0; first < count; first += step)
+    {
+        size_t last = MIN(first + step, count);
+        pool->Submit([&, first, last](unsigned)
+        {
+            body(first, last);
+            // notified under the lock, the waiter may return and destroy the condition right after
+            lock_guard<mutex> lock(doneMutex);
+            if (--remaining == 0)
+            {
+                done.notify_one();
+            }
+        });
+    }
+
+    unique_lock<mutex> lock(doneMutex);
+    done.wait(lock, [&] { return remaining == 0; });
+}
+
+void MeshNormals::Generate(const std::vector<glm::vec3>& vertices, const std::vector<GLuint>& triangles, NORMAL_WEIGHTING weighting,
+                           float creaseAngle, std::vector<glm::vec3>& vertexNormals, std::vector<glm::vec3>& cornerNormals,
+                           ThreadPool* pPool /*= nullptr*/)
+{
+    size_t faceCount   = triangles.size() / FACE_ELEMENTS;
+    size_t cornerCount = faceCount * FACE_ELEMENTS;
+    float  cosCrease   = cos(radians(creaseAngle));
+
+    ThreadPool* pool = (faceCount >= MESH_NORMALS_MIN_PARALLEL_FACES) ? pPool : nullptr;
+
+    // 1. Unit normal of every face and the weight of each of its corners, degenerate faces weigh nothing.
+    //    Same orientation as Face::m_normal.
+    vector<vec3>  faceNormals(faceCount);
+    vector<float> cornerWeights(cornerCount);
+    parallelFor(pool, faceCount, [&](size_t first, size_t last)
+    {
+        for (size_t f = first; f < last; f++)
+        {
+            const GLuint* corners = &triangles[f * FACE_ELEMENTS];
+            vec3 p[FACE_ELEMENTS] = { vertices[corners[0]], vertices[corners[1]], vertices[corners[2]] };
+            vec3 normal = cross(p[2] - p[0], p[1] - p[0]);
+            float length2 = dot(normal, normal);
+            if (length2 <= FLT_MIN)
+            {
+                faceNormals[f] = vec3(0.f);
+                cornerWeights[f * FACE_ELEMENTS] = cornerWeights[f * FACE_ELEMENTS + 1] = cornerWeights[f * FACE_ELEMENTS + 2] = 0.f;
+                continue;
+            }
+
+            float length = sqrt(length2);
+            faceNormals[f] = normal / length;
+            for (int k = 0; k < FACE_ELEMENTS; k++)
+            {
+                if (weighting == NW_AREA)
+                {
+                    cornerWeights[f * FACE_ELEMENTS + k] = 0.5f * length;
+                    continue;
+                }
+                vec3 edge1 = normalize(p[(k + 1) % FACE_ELEMENTS] - p[k]);
+                vec3 edge2 = normalize(p[(k + 2) % FACE_ELEMENTS] - p[k]);
+                cornerWeights[f * FACE_ELEMENTS + k] = acos(clamp(dot(edge1, edge2), -1.f, 1.f));
+            }
+        }
+    });
+
+    // 2. The corners around every vertex, in ascending order. A counting sort, two linear passes.
+    vector<GLuint> firstCorner(vertices.size() + 1, 0);
+    for (size_t c = 0; c < cornerCount; c++)
+    {
+        firstCorner[triangles[c] + 1]++;
+    }
+    for (size_t v = 0; v < vertices.size(); v++)
+    {
+        firstCorner[v + 1] += firstCorner[v];
+    }
+    vector<GLuint> vertexCorners(cornerCount);
+    vector<GLuint> nextSlot(firstCorner.begin(), firstCorner.end() - 1);
+    for (size_t c = 0; c < cornerCount; c++)
+    {
+        vertexCorners[nextSlot[triangles[c]]++] = (GLuint)c;
+    }
+
+    // 3. Vertex normals over all faces around the vertex
+    vertexNormals.resize(vertices.size());
+    parallelFor(pool, vertices.size(), [&](size_t first, size_t last)
+    {
+        for (size_t v = first; v < last; v++)
+        {
+            vec3 sum(0.f);
+            for (GLuint i = firstCorner[v]; i < firstCorner[v + 1]; i++)
+            {
+                GLuint c = vertexCorners[i];
+                sum += faceNormals[c / FACE_ELEMENTS] * cornerWeights[c];
+            }
+            vertexNormals[v] = (dot(sum, sum) > FLT_MIN) ? normalize(sum) : vec3(0.f);
+        }
+    });
+
+    // 4. Corner normals over the faces around the vertex within the crease angle of the corner's face
+    cornerNormals.resize(cornerCount);
+    parallelFor(pool, faceCount, [&](size_t first, size_t last)
+    {
+        for (size_t f = first; f < last; f++)
+        {
+            const vec3& normal = faceNormals[f];
+            for (int k = 0; k < FACE_ELEMENTS; k++)
+            {
+                size_t c = f * FACE_ELEMENTS + k;
+                GLuint v = triangles[c];
+                if (normal == vec3(0.f))
+                {
+                    cornerNormals[c] = vertexNormals[v];
+                    continue;
+                }
+
+                vec3 sum(0.f);
+                for (GLuint i = firstCorner[v]; i < firstCorner[v + 1]; i++)
+                {
+                    GLuint neighbour = vertexCorners[i];
+                    const vec3& neighbourNormal = faceNormals[neighbour / FACE_ELEMENTS];
+                    if (dot(neighbourNormal, normal) >= cosCrease)
+                    {
+                        sum += neighbourNormal * cornerWeights[neighbour];
+                    }
+                }
+                cornerNormals[c] = (dot(sum, sum) > FLT_MIN) ? normalize(sum) : normal;
+            }
+        }
+    });
+}
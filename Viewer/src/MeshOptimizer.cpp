@@ -0,0 +1,151 @@
+#include <math.h>
+#include <unordered_map>
+#include "MeshOptimizer.h"
+
+using namespace std;
+using namespace glm;
+
+#define NO_VERTEX                        0xFFFFFFFFu
+
+static vec3 normalAt(const vector<vec3>& normals, size_t vertexIdx)
+{
+    return (vertexIdx < normals.size()) ? normals[vertexIdx] : vec3(0.f);
+}
+
+// 21 bits per axis; cells far apart may share a key, they only cost a few distance checks more
+static uint64_t cellKey(int x, int y, int z)
+{
+    return ((uint64_t)(x & 0x1FFFFF) << 42) | ((uint64_t)(y & 0x1FFFFF) << 21) | (uint64_t)(z & 0x1FFFFF);
+}
+
+void MeshOptimizer::weld(const std::vector<glm::vec3>& vertices, const std::vector<glm::vec3>& normals, std::vector<GLuint>& remap)
+{
+    // With cells twice the tolerance, everything within the tolerance of a point lies in the 2x2x2 cells
+    // nearest to it. Each cell chains the vertices that were kept, in the order they were kept.
+    const float                     cellSize   = 2.f * MESH_WELD_TOLERANCE;
+    const float                     tolerance2 = MESH_WELD_TOLERANCE * MESH_WELD_TOLERANCE;
+    unordered_map<uint64_t, GLuint> cellHeads;
+    vector<GLuint>                  next(vertices.size(), NO_VERTEX);
+
+    cellHeads.reserve(vertices.size());
+    remap.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const vec3& position = vertices[i];
+        remap[i] = (GLuint)i;
+        if (!isfinite(position.x) || !isfinite(position.y) || !isfinite(position.z))
+        {
+            continue;
+        }
+
+        // the cell of the vertex, and per axis the neighbour on the side the vertex is closer to
+        int  cell[3], side[3];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float scaled = position[axis] / cellSize;
+            cell[axis]   = (int)floor(scaled);
+            side[axis]   = (scaled - cell[axis] < 0.5f) ? -1 : 1;
+        }
+        vec3 normal = normalAt(normals, i);
+
+        GLuint found = NO_VERTEX;
+        for (int corner = 0; corner < 8 && found == NO_VERTEX; corner++)
+        {
+            auto head = cellHeads.find(cellKey(cell[0] + (corner & 1) * side[0], cell[1] + ((corner >> 1) & 1) * side[1],
+                                               cell[2] + ((corner >> 2) & 1) * side[2]));
+            for (GLuint kept = (head != cellHeads.end()) ? head->second : NO_VERTEX; kept != NO_VERTEX; kept = next[kept])
+            {
+                vec3 offset      = vertices[kept] - position;
+                vec3 normalDelta = normalAt(normals, kept) - normal;
+                if (dot(offset, offset) <= tolerance2 && dot(normalDelta, normalDelta) <= MESH_WELD_NORMAL_TOLERANCE * MESH_WELD_NORMAL_TOLERANCE)
+                {
+                    found = kept;
+                    break;
+                }
+            }
+        }
+
+        if (found != NO_VERTEX)
+        {
+            remap[i] = found;
+            continue;
+        }
+
+        // appended at the chain's end, the first vertex kept at a spot wins
+        auto inserted = cellHeads.insert({ cellKey(cell[0], cell[1], cell[2]), (GLuint)i });
+        if (!inserted.second)
+        {
+            GLuint last = inserted.first->second;
+            while (next[last] != NO_VERTEX)
+            {
+                last = next[last];
+            }
+            next[last] = (GLuint)i;
+        }
+    }
+}
+
+MESH_IMPORT_STATS MeshOptimizer::Optimize(std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& normals, std::vector<GLuint>& triangles)
+{
+    MESH_IMPORT_STATS stats;
+    stats.verticesIn  = (unsigned)vertices.size();
+    stats.trianglesIn = (unsigned)(triangles.size() / FACE_ELEMENTS);
+
+    vector<GLuint> remap;
+    weld(vertices, normals, remap);
+
+    // Triangles collapsed by the welding, or without area to begin with. NaN areas fail the test as well.
+    vector<GLuint> kept;
+    kept.reserve(triangles.size());
+    for (size_t f = 0; f + FACE_ELEMENTS <= triangles.size(); f += FACE_ELEMENTS)
+    {
+        GLuint a = remap[triangles[f]], b = remap[triangles[f + 1]], c = remap[triangles[f + 2]];
+        if (a == b || b == c || a == c)
+        {
+            continue;
+        }
+        float doubleArea = length(cross(vertices[b] - vertices[a], vertices[c] - vertices[a]));
+        if (!(doubleArea > MESH_DEGENERATE_AREA))
+        {
+            continue;
+        }
+        kept.insert(kept.end(), { a, b, c });
+    }
+    // nothing but degenerate triangles is a line drawing (e.g. PrimModels/2tri.obj), its edges are the content
+    if (kept.empty())
+    {
+        stats.verticesOut  = stats.verticesIn;
+        stats.trianglesOut = stats.trianglesIn;
+        return stats;
+    }
+    triangles.swap(kept);
+
+    // Vertices in the order the triangles first use them, welded away and unused ones are dropped
+    vector<GLuint> newIndex(vertices.size(), NO_VERTEX);
+    vector<vec3>   newVertices, newNormals;
+    newVertices.reserve(vertices.size());
+    for (GLuint& vertexIdx : triangles)
+    {
+        if (newIndex[vertexIdx] == NO_VERTEX)
+        {
+            newIndex[vertexIdx] = (GLuint)newVertices.size();
+            newVertices.push_back(vertices[vertexIdx]);
+            if (!normals.empty())
+            {
+                newNormals.push_back(normalAt(normals, vertexIdx));
+            }
+        }
+        vertexIdx = newIndex[vertexIdx];
+    }
+    newVertices.shrink_to_fit();
+    vertices.swap(newVertices);
+    if (!normals.empty())
+    {
+        newNormals.shrink_to_fit();
+        normals.swap(newNormals);
+    }
+
+    stats.verticesOut  = (unsigned)vertices.size();
+    stats.trianglesOut = (unsigned)(triangles.size() / FACE_ELEMENTS);
+    return stats;
+}
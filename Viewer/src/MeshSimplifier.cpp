@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <queue>
+#include "MeshSimplifier.h"
+
+using namespace std;
+using namespace glm;
+
+// Symmetric 4x4 matrix of the summed squared plane distances: a2 ab ac ad b2 bc bd c2 cd d2
+struct Quadric
+{
+    double q[10];
+
+    Quadric() { fill(q, q + 10, 0.0); }
+
+    // plane n.p + d = 0 with a unit normal
+    Quadric(const dvec3& n, double d, double weight)
+    {
+        q[0] = n.x * n.x; q[1] = n.x * n.y; q[2] = n.x * n.z; q[3] = n.x * d;
+        q[4] = n.y * n.y; q[5] = n.y * n.z; q[6] = n.y * d;
+        q[7] = n.z * n.z; q[8] = n.z * d;
+        q[9] = d * d;
+        for (double& value : q)
+        {
+            value *= weight;
+        }
+    }
+
+    Quadric& operator+=(const Quadric& other)
+    {
+        for (int i = 0; i < 10; i++)
+        {
+            q[i] += other.q[i];
+        }
+        return *this;
+    }
+
+    double Evaluate(const dvec3& p) const
+    {
+        return q[0] * p.x * p.x + 2 * q[1] * p.x * p.y + 2 * q[2] * p.x * p.z + 2 * q[3] * p.x
+             + q[4] * p.y * p.y + 2 * q[5] * p.y * p.z + 2 * q[6] * p.y
+             + q[7] * p.z * p.z + 2 * q[8] * p.z
+             + q[9];
+    }
+
+    // The point of the smallest error, false if the planes do not pin one down (e.g. all parallel)
+    bool Minimum(dvec3& p) const
+    {
+        double det = q[0] * (q[4] * q[7] - q[5] * q[5]) - q[1] * (q[1] * q[7] - q[5] * q[2]) + q[2] * (q[1] * q[5] - q[4] * q[2]);
+        if (fabs(det) < 1e-12)
+        {
+            return false;
+        }
+        // Cramer's rule on A p = -b
+        dvec3 b(-q[3], -q[6], -q[8]);
+        p.x = (b.x * (q[4] * q[7] - q[5] * q[5]) - q[1] * (b.y * q[7] - q[5] * b.z) + q[2] * (b.y * q[5] - q[4] * b.z)) / det;
+        p.y = (q[0] * (b.y * q[7] - b.z * q[5]) - b.x * (q[1] * q[7] - q[5] * q[2]) + q[2] * (q[1] * b.z - b.y * q[2])) / det;
+        p.z = (q[0] * (q[4] * b.z - q[5] * b.y) - q[1] * (q[1] * b.z - b.y * q[2]) + b.x * (q[1] * q[5] - q[4] * q[2])) / det;
+        return true;
+    }
+};
+
+struct Collapse
+{
+    double cost;
+    GLuint v1, v2;          // v2 goes into v1
+    GLuint stamp1, stamp2;  // versions of the vertices the cost was computed for
+    vec3   target;
+
+    bool operator>(const Collapse& other) const { return cost > other.cost; }
+};
+
+class QemSimplifier
+{
+private:
+    vector<vec3>            m_positions;
+    vector<GLuint>          m_triangles;
+    vector<Quadric>         m_quadrics;
+    vector<vector<GLuint> > m_vertexFaces;
+    vector<GLuint>          m_versions;
+    vector<bool>            m_vertexAlive;
+    vector<bool>            m_faceAlive;
+    size_t                  m_liveFaces;
+    priority_queue<Collapse, vector<Collapse>, greater<Collapse> > m_queue;
+
+    vec3 faceNormal(GLuint face, GLuint moved, const vec3& target) const
+    {
+        vec3 p[FACE_ELEMENTS];
+        for (int k = 0; k < FACE_ELEMENTS; k++)
+        {
+            GLuint v = m_triangles[face * FACE_ELEMENTS + k];
+            p[k] = (v == moved) ? target : m_positions[v];
+        }
+        return cross(p[1] - p[0], p[2] - p[0]);
+    }
+
+    bool hasVertex(GLuint face, GLuint v) const
+    {
+        const GLuint* corners = &m_triangles[face * FACE_ELEMENTS];
+        return corners[0] == v || corners[1] == v || corners[2] == v;
+    }
+
+    void neighbours(GLuint v, vector<GLuint>& result) const
+    {
+        result.clear();
+        for (GLuint face : m_vertexFaces[v])
+        {
+            if (!m_faceAlive[face])
+            {
+                continue;
+            }
+            for (int k = 0; k < FACE_ELEMENTS; k++)
+            {
+                GLuint other = m_triangles[face * FACE_ELEMENTS + k];
+                if (other != v)
+                {
+                    result.push_back(other);
+                }
+            }
+        }
+        sort(result.begin(), result.end());
+        result.erase(unique(result.begin(), result.end()), result.end());
+    }
+
+    void push(GLuint v1, GLuint v2)
+    {
+        Quadric quadric = m_quadrics[v1];
+        quadric += m_quadrics[v2];
+
+        dvec3  candidates[4] = { dvec3(m_positions[v1]), dvec3(m_positions[v2]), dvec3(m_positions[v1] + m_positions[v2]) * 0.5, dvec3(0.0) };
+        int    count         = quadric.Minimum(candidates[3]) ? 4 : 3;
+        double bestCost      = DBL_MAX;
+        dvec3  best          = candidates[0];
+        for (int i = 0; i < count; i++)
+        {
+            double cost = quadric.Evaluate(candidates[i]);
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                best     = candidates[i];
+            }
+        }
+        m_queue.push({ MAX(bestCost, 0.0), v1, v2, m_versions[v1], m_versions[v2], vec3(best) });
+    }
+
+    // A collapse must keep the surface a manifold and must not fold any remaining face over
+    bool isValid(const Collapse& collapse, vector<GLuint>& scratch1, vector<GLuint>& scratch2) const
+    {
+        neighbours(collapse.v1, scratch1);
+        neighbours(collapse.v2, scratch2);
+        size_t shared = 0;
+        for (size_t i = 0, j = 0; i < scratch1.size() && j < scratch2.size();)
+        {
+            if (scratch1[i] < scratch2[j])      i++;
+            else if (scratch1[i] > scratch2[j]) j++;
+            else { shared++; i++; j++; }
+        }
+        if (shared > 2)
+        {
+            return false;
+        }
+
+        for (GLuint v : { collapse.v1, collapse.v2 })
+        {
+            for (GLuint face : m_vertexFaces[v])
+            {
+                if (!m_faceAlive[face] || (hasVertex(face, collapse.v1) && hasVertex(face, collapse.v2)))
+                {
+                    continue;
+                }
+                vec3 before = faceNormal(face, v, m_positions[v]);
+                vec3 after  = faceNormal(face, v, collapse.target);
+                float lengths = length(before) * length(after);
+                if (lengths <= FLT_MIN || dot(before, after) < MESH_SIMPLIFY_MIN_FLIP_DOT * lengths)
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void apply(const Collapse& collapse)
+    {
+        GLuint v1 = collapse.v1, v2 = collapse.v2;
+
+        m_positions[v1] = collapse.target;
+        m_quadrics[v1] += m_quadrics[v2];
+        for (GLuint face : m_vertexFaces[v2])
+        {
+            // faces removed by an earlier collapse stay in the lists of their other corners
+            if (!m_faceAlive[face])
+            {
+                continue;
+            }
+            if (hasVertex(face, v1))
+            {
+                m_faceAlive[face] = false;
+                m_liveFaces--;
+                continue;
+            }
+            GLuint* corners = &m_triangles[face * FACE_ELEMENTS];
+            replace(corners, corners + FACE_ELEMENTS, v2, v1);
+            m_vertexFaces[v1].push_back(face);
+        }
+        vector<GLuint>& faces = m_vertexFaces[v1];
+        faces.erase(remove_if(faces.begin(), faces.end(), [this](GLuint face) { return !m_faceAlive[face]; }), faces.end());
+
+        m_vertexFaces[v2].clear();
+        m_vertexAlive[v2] = false;
+        m_versions[v1]++;
+    }
+
+public:
+    QemSimplifier(const vector<vec3>& vertices, const vector<GLuint>& triangles) :
+        m_positions(vertices), m_triangles(triangles), m_quadrics(vertices.size()), m_vertexFaces(vertices.size()),
+        m_versions(vertices.size(), 0), m_vertexAlive(vertices.size(), true), m_faceAlive(triangles.size() / FACE_ELEMENTS, true),
+        m_liveFaces(triangles.size() / FACE_ELEMENTS)
+    {
+        size_t faceCount = m_liveFaces;
+
+        // face planes, and every directed edge with its face to find the borders
+        vector<pair<unsigned long long, GLuint> > edges;
+        edges.reserve(m_triangles.size());
+        for (GLuint face = 0; face < faceCount; face++)
+        {
+            const GLuint* corners = &m_triangles[face * FACE_ELEMENTS];
+            vec3  normal = faceNormal(face, 0xFFFFFFFFu, vec3(0.f));
+            float length = glm::length(normal);
+            for (int k = 0; k < FACE_ELEMENTS; k++)
+            {
+                m_vertexFaces[corners[k]].push_back(face);
+                GLuint a = corners[k], b = corners[(k + 1) % FACE_ELEMENTS];
+                edges.push_back({ EDGE_KEY(MIN(a, b), MAX(a, b)), face });
+            }
+            if (length <= FLT_MIN)
+            {
+                continue;
+            }
+            dvec3   n     = dvec3(normal / length);
+            Quadric plane(n, -dot(n, dvec3(m_positions[corners[0]])), 1.0);
+            for (int k = 0; k < FACE_ELEMENTS; k++)
+            {
+                m_quadrics[corners[k]] += plane;
+            }
+        }
+
+        sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size(); i++)
+        {
+            bool bFirst = (i == 0 || edges[i - 1].first != edges[i].first);
+            bool bLast  = (i + 1 == edges.size() || edges[i + 1].first != edges[i].first);
+            GLuint a = (GLuint)(edges[i].first >> 32), b = (GLuint)(edges[i].first & 0xFFFFFFFF);
+            if (bFirst && bLast)
+            {
+                // a border: a plane through the edge, perpendicular to its face
+                vec3  edge   = m_positions[b] - m_positions[a];
+                vec3  normal = cross(edge, faceNormal(edges[i].second, 0xFFFFFFFFu, vec3(0.f)));
+                float length = glm::length(normal);
+                if (length > FLT_MIN)
+                {
+                    dvec3   n = dvec3(normal / length);
+                    Quadric plane(n, -dot(n, dvec3(m_positions[a])), MESH_SIMPLIFY_BOUNDARY_WEIGHT);
+                    m_quadrics[a] += plane;
+                    m_quadrics[b] += plane;
+                }
+            }
+            if (bFirst)
+            {
+                push(a, b);
+            }
+        }
+    }
+
+    float Run(size_t targetTriangles)
+    {
+        vector<GLuint> scratch1, scratch2;
+        double         maxCost = 0;
+
+        while (m_liveFaces > targetTriangles && !m_queue.empty())
+        {
+            Collapse collapse = m_queue.top();
+            m_queue.pop();
+            if (!m_vertexAlive[collapse.v1] || !m_vertexAlive[collapse.v2] ||
+                m_versions[collapse.v1] != collapse.stamp1 || m_versions[collapse.v2] != collapse.stamp2)
+            {
+                continue;
+            }
+            if (!isValid(collapse, scratch1, scratch2))
+            {
+                continue;
+            }
+
+            apply(collapse);
+            maxCost = MAX(maxCost, collapse.cost);
+
+            neighbours(collapse.v1, scratch1);
+            for (GLuint neighbour : scratch1)
+            {
+                push(collapse.v1, neighbour);
+            }
+        }
+        // the root of the summed squared distances is at least the distance to any single one of the planes; it
+        // measures the vertices only, so it is an estimate of the surface deviation rather than a bound
+        return (float)sqrt(maxCost);
+    }
+
+    void Output(vector<vec3>& outVertices, vector<GLuint>& outTriangles) const
+    {
+        vector<GLuint> newIndex(m_positions.size(), 0xFFFFFFFFu);
+        outVertices.clear();
+        outTriangles.clear();
+        outTriangles.reserve(m_liveFaces * FACE_ELEMENTS);
+        for (size_t face = 0; face < m_faceAlive.size(); face++)
+        {
+            if (!m_faceAlive[face])
+            {
+                continue;
+            }
+            for (int k = 0; k < FACE_ELEMENTS; k++)
+            {
+                GLuint v = m_triangles[face * FACE_ELEMENTS + k];
+                if (newIndex[v] == 0xFFFFFFFFu)
+                {
+                    newIndex[v] = (GLuint)outVertices.size();
+                    outVertices.push_back(m_positions[v]);
+                }
+                outTriangles.push_back(newIndex[v]);
+            }
+        }
+    }
+};
+
+float MeshSimplifier::Simplify(const std::vector<glm::vec3>& vertices, const std::vector<GLuint>& triangles, size_t targetTriangles,
+                               std::vector<glm::vec3>& outVertices, std::vector<GLuint>& outTriangles)
+{
+    QemSimplifier simplifier(vertices, triangles);
+    float error = simplifier.Run(targetTriangles);
+    simplifier.Output(outVertices, outTriangles);
+    return error;
+}
@@ -0,0 +1,130 @@
+#include <cmath>
+#include "PostProcess.h"
+
+using namespace std;
+using namespace glm;
+
+PostProcess::PostProcess() : m_effect(NONE), m_kernelSizeX(1), m_kernelSizeY(1), m_sigma(1.f), m_bloomIntensity(1.f), m_bloomWeights(1.f), m_bloomThreshold(1.f), m_traffic{ 0, 0, 0 } {}
+
+void PostProcess::makeKernel(vector<float>& kernel, int kernelSize, float sigma)
+{
+    // the 2D gaussian is separable, so one normalized 1D kernel per axis gives the same weights
+    int   half = kernelSize / 2;
+    float sum  = 0.f;
+
+    kernel.resize(2 * half + 1);
+    for (int i = -half; i <= half; i++)
+    {
+        kernel[i + half] = exp(-0.5f * (i / sigma) * (i / sigma));
+        sum += kernel[i + half];
+    }
+    for (float& weight : kernel)
+    {
+        weight /= sum;
+    }
+}
+
+void PostProcess::Configure(POST_EFFECT effect, int kernelSizeX, int kernelSizeY, float sigma, float bloomIntensity, const vec3& bloomWeights, float bloomThreshold)
+{
+    m_bloomIntensity = bloomIntensity;
+    m_bloomWeights   = bloomWeights;
+    m_bloomThreshold = bloomThreshold;
+
+    if (effect == m_effect && kernelSizeX == m_kernelSizeX && kernelSizeY == m_kernelSizeY && sigma == m_sigma)
+    {
+        return;
+    }
+    m_effect      = effect;
+    m_kernelSizeX = kernelSizeX;
+    m_kernelSizeY = kernelSizeY;
+    m_sigma       = sigma;
+
+    m_fetchStages.clear();
+    switch (m_effect)
+    {
+    case BLUR_SCENE:
+        m_fetchStages.push_back(PS_CLAMP);
+        break;
+    case BLOOM:
+        // blur(clamp(c)) + intensity * blur(bright(c)) == blur(clamp(c) + intensity * bright(c)), so bloom needs one blur
+        m_fetchStages.push_back(PS_BLOOM_SOURCE);
+        break;
+    default:
+        break;
+    }
+
+    makeKernel(m_kernelX, m_kernelSizeX, m_sigma);
+    makeKernel(m_kernelY, m_kernelSizeY, m_sigma);
+}
+
+void PostProcess::blurRow(const ColorTarget& source, int y, vec3* out)
+{
+    int width = source.GetWidth();
+    int halfX = static_cast<int>(m_kernelX.size()) / 2;
+
+    // clamp to edge by replicating the outermost pixels into the padding
+    source.ReadRow(y, &m_fetchRow[halfX]);
+    for (int x = 0; x < width; x++)
+    {
+        m_fetchRow[halfX + x] = applyFetchStages(m_fetchRow[halfX + x]);
+    }
+    for (int i = 0; i < halfX; i++)
+    {
+        m_fetchRow[i]                 = m_fetchRow[halfX];
+        m_fetchRow[halfX + width + i] = m_fetchRow[halfX + width - 1];
+    }
+
+    for (int x = 0; x < width; x++)
+    {
+        const vec3* taps = &m_fetchRow[x];
+        vec3        sum  = ZERO_VEC3;
+        for (size_t k = 0; k < m_kernelX.size(); k++)
+        {
+            sum += m_kernelX[k] * taps[k];
+        }
+        out[x] = sum;
+    }
+}
+
+void PostProcess::Apply(const ColorTarget& source, ColorTarget& destination)
+{
+    int    width      = source.GetWidth();
+    int    height     = source.GetHeight();
+    int    taps       = static_cast<int>(m_kernelY.size());
+    int    halfY      = taps / 2;
+    size_t frameBytes = source.GetBytes();
+
+    m_fetchRow.resize(width + m_kernelX.size() - 1);
+    m_rowRing .resize(static_cast<size_t>(width) * taps);
+    m_outRow  .resize(width);
+
+    int nextRow = 0;
+    for (int y = 0; y < height; y++)
+    {
+        // horizontally blur every source row once, as soon as the vertical kernel reaches it
+        int lastNeeded = MIN(y + halfY, height - 1);
+        for (; nextRow <= lastNeeded; nextRow++)
+        {
+            blurRow(source, nextRow, &m_rowRing[static_cast<size_t>(nextRow % taps) * width]);
+        }
+
+        for (int x = 0; x < width; x++)
+        {
+            vec3 sum = ZERO_VEC3;
+            for (int k = -halfY; k <= halfY; k++)
+            {
+                int row = MIN(MAX(y + k, 0), height - 1);
+                sum += m_kernelY[k + halfY] * m_rowRing[static_cast<size_t>(row % taps) * width + x];
+            }
+            m_outRow[x] = sum;
+        }
+        destination.WriteRow(y, m_outRow.data());
+    }
+
+    m_traffic.fullFrameBytes = frameBytes + destination.GetBytes();
+    m_traffic.scratchBytes   = (m_rowRing.size() + m_fetchRow.size() + m_outRow.size()) * sizeof(vec3);
+    // blur: clear + write of its target, one read of the scene.
+    // bloom: clear of two targets, read of the scene and the bright buffer, write of two blurred targets,
+    //        then a composite reading both and writing one.
+    m_traffic.legacyBytes    = (m_effect == BLOOM ? 9 : 3) * frameBytes;
+}
@@ -0,0 +1,316 @@
+#include "QoiImage.h"
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <functional>
+#include <thread>
+#include "lodepng.h"
+
+using namespace std;
+
+#define QOI_OP_INDEX    0x00    // 00xxxxxx
+#define QOI_OP_DIFF     0x40    // 01xxxxxx
+#define QOI_OP_LUMA     0x80    // 10xxxxxx
+#define QOI_OP_RUN      0xC0    // 11xxxxxx
+#define QOI_OP_RGB      0xFE
+#define QOI_OP_RGBA     0xFF
+#define QOI_MASK_2      0xC0
+#define QOI_MAX_RUN     62
+
+static const unsigned char qoiMagic[4]                  = { 'q', 'o', 'i', 'f' };
+static const unsigned char qoiPadding[QOI_PADDING_SIZE] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+
+static inline unsigned qoiHash(const unsigned char* px)
+{
+    return (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+}
+
+static inline bool samePixel(const unsigned char* a, const unsigned char* b)
+{
+    uint32_t pa, pb;
+    memcpy(&pa, a, 4);
+    memcpy(&pb, b, 4);
+    return pa == pb;
+}
+
+static inline void writeBE32(unsigned char* out, uint32_t value)
+{
+    out[0] = (unsigned char)(value >> 24);
+    out[1] = (unsigned char)(value >> 16);
+    out[2] = (unsigned char)(value >> 8);
+    out[3] = (unsigned char)value;
+}
+
+static inline uint32_t readBE32(const unsigned char* in)
+{
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) | ((uint32_t)in[2] << 8) | in[3];
+}
+
+void QoiImage::Encode(const unsigned char* rgba, unsigned width, unsigned height, std::vector<unsigned char>& out, bool bBottomUp /*= false*/)
+{
+    size_t        rowBytes  = static_cast<size_t>(width) * 4;
+    unsigned char index[64 * 4] = {};
+    unsigned char prev[4]   = { 0, 0, 0, 255 };
+    unsigned      run       = 0;
+
+    // worst case every pixel is a QOI_OP_RGBA
+    out.resize(QOI_HEADER_SIZE + static_cast<size_t>(width) * height * 5 + QOI_PADDING_SIZE);
+    unsigned char* p = out.data();
+
+    memcpy(p, qoiMagic, 4);
+    writeBE32(p + 4, width);
+    writeBE32(p + 8, height);
+    p[12] = 4;  // channels
+    p[13] = 0;  // sRGB with linear alpha
+    p += QOI_HEADER_SIZE;
+
+    for (unsigned y = 0; y < height; y++)
+    {
+        const unsigned char* row = rgba + (bBottomUp ? height - 1 - y : y) * rowBytes;
+        for (unsigned x = 0; x < width; x++)
+        {
+            const unsigned char* px = row + x * 4;
+
+            if (samePixel(px, prev))
+            {
+                run++;
+                if (run == QOI_MAX_RUN)
+                {
+                    *p++ = (unsigned char)(QOI_OP_RUN | (run - 1));
+                    run  = 0;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                *p++ = (unsigned char)(QOI_OP_RUN | (run - 1));
+                run  = 0;
+            }
+
+            unsigned hash = qoiHash(px);
+            if (samePixel(index + hash * 4, px))
+            {
+                *p++ = (unsigned char)(QOI_OP_INDEX | hash);
+            }
+            else
+            {
+                memcpy(index + hash * 4, px, 4);
+
+                if (px[3] == prev[3])
+                {
+                    // channel differences wrap around like the decoder's unsigned char arithmetic
+                    signed char dr = (signed char)(px[0] - prev[0]);
+                    signed char dg = (signed char)(px[1] - prev[1]);
+                    signed char db = (signed char)(px[2] - prev[2]);
+                    signed char drDg = (signed char)(dr - dg);
+                    signed char dbDg = (signed char)(db - dg);
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    {
+                        *p++ = (unsigned char)(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    }
+                    else if (dg >= -32 && dg <= 31 && drDg >= -8 && drDg <= 7 && dbDg >= -8 && dbDg <= 7)
+                    {
+                        *p++ = (unsigned char)(QOI_OP_LUMA | (dg + 32));
+                        *p++ = (unsigned char)((drDg + 8) << 4 | (dbDg + 8));
+                    }
+                    else
+                    {
+                        *p++ = QOI_OP_RGB;
+                        *p++ = px[0];
+                        *p++ = px[1];
+                        *p++ = px[2];
+                    }
+                }
+                else
+                {
+                    *p++ = QOI_OP_RGBA;
+                    memcpy(p, px, 4);
+                    p += 4;
+                }
+            }
+            memcpy(prev, px, 4);
+        }
+    }
+
+    if (run > 0)
+    {
+        *p++ = (unsigned char)(QOI_OP_RUN | (run - 1));
+    }
+    memcpy(p, qoiPadding, QOI_PADDING_SIZE);
+    p += QOI_PADDING_SIZE;
+
+    out.resize(p - out.data());
+}
+
+RETURN_CODE QoiImage::Decode(const unsigned char* data, size_t size, std::vector<unsigned char>& rgba, unsigned& width, unsigned& height)
+{
+    if (size < QOI_HEADER_SIZE + QOI_PADDING_SIZE || memcmp(data, qoiMagic, 4) != 0)
+    {
+        return RC_FAILURE;
+    }
+
+    width  = readBE32(data + 4);
+    height = readBE32(data + 8);
+    unsigned channels = data[12];
+    if (width == 0 || height == 0 || (channels != 3 && channels != 4) || static_cast<uint64_t>(width) * height > QOI_MAX_PIXELS)
+    {
+        return RC_FAILURE;
+    }
+
+    size_t pixelBytes = static_cast<size_t>(width) * height * 4;
+    rgba.resize(pixelBytes);
+
+    unsigned char        index[64 * 4] = {};
+    unsigned char        px[4]         = { 0, 0, 0, 255 };
+    unsigned             run           = 0;
+    const unsigned char* p             = data + QOI_HEADER_SIZE;
+    // ops must not read into the end marker
+    const unsigned char* chunksEnd     = data + size - QOI_PADDING_SIZE;
+    unsigned char*       out           = rgba.data();
+    unsigned char*       outEnd        = out + pixelBytes;
+
+    for (; out < outEnd; out += 4)
+    {
+        if (run > 0)
+        {
+            run--;
+        }
+        else
+        {
+            // the chunks ran out before the pixels did
+            if (p >= chunksEnd)
+            {
+                return RC_FAILURE;
+            }
+            unsigned op      = *p++;
+            size_t   payload = (op == QOI_OP_RGB) ? 3 : (op == QOI_OP_RGBA) ? 4 : ((op & QOI_MASK_2) == QOI_OP_LUMA) ? 1 : 0;
+            if (payload > static_cast<size_t>(chunksEnd - p))
+            {
+                return RC_FAILURE;
+            }
+
+            if (op == QOI_OP_RGB)
+            {
+                px[0] = p[0];
+                px[1] = p[1];
+                px[2] = p[2];
+                p += 3;
+            }
+            else if (op == QOI_OP_RGBA)
+            {
+                memcpy(px, p, 4);
+                p += 4;
+            }
+            else if ((op & QOI_MASK_2) == QOI_OP_INDEX)
+            {
+                memcpy(px, index + op * 4, 4);
+            }
+            else if ((op & QOI_MASK_2) == QOI_OP_DIFF)
+            {
+                px[0] += ((op >> 4) & 0x03) - 2;
+                px[1] += ((op >> 2) & 0x03) - 2;
+                px[2] += ( op       & 0x03) - 2;
+            }
+            else if ((op & QOI_MASK_2) == QOI_OP_LUMA)
+            {
+                unsigned second = *p++;
+                int      dg     = (int)(op & 0x3F) - 32;
+                px[0] += dg - 8 + ((second >> 4) & 0x0F);
+                px[1] += dg;
+                px[2] += dg - 8 + (second & 0x0F);
+            }
+            else
+            {
+                run = op & 0x3F;
+            }
+
+            memcpy(index + qoiHash(px) * 4, px, 4);
+        }
+        memcpy(out, px, 4);
+    }
+
+    return (memcmp(chunksEnd, qoiPadding, QOI_PADDING_SIZE) == 0) ? RC_SUCCESS : RC_FAILURE;
+}
+
+RETURN_CODE QoiImage::WriteFile(const std::string& fileName, const unsigned char* rgba, unsigned width, unsigned height,
+                                bool bBottomUp /*= false*/)
+{
+    vector<unsigned char> encoded;
+    Encode(rgba, width, height, encoded, bBottomUp);
+
+    // written next to the target and renamed over it, so a reader never sees a partial file.
+    // The thread id keeps two loaders caching the same PNG from sharing a temporary.
+    string tempName = fileName + ".tmp" + to_string(hash<thread::id>()(this_thread::get_id()));
+    FILE*  file     = fopen(tempName.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return RC_IO_ERROR;
+    }
+    bool bWritten = fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size();
+    bWritten      = (fclose(file) == 0) && bWritten;
+
+#ifdef _WIN32
+    // rename does not replace an existing file on Windows
+    if (bWritten)
+    {
+        remove(fileName.c_str());
+    }
+#endif
+    if (!bWritten || rename(tempName.c_str(), fileName.c_str()) != 0)
+    {
+        remove(tempName.c_str());
+        return RC_IO_ERROR;
+    }
+    return RC_SUCCESS;
+}
+
+RETURN_CODE QoiImage::ReadFile(const std::string& fileName, std::vector<unsigned char>& rgba, unsigned& width, unsigned& height)
+{
+    ifstream file(fileName.c_str(), ios::binary | ios::ate);
+    if (file.fail())
+    {
+        return RC_IO_ERROR;
+    }
+
+    vector<unsigned char> data(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(data.data()), data.size()))
+    {
+        return RC_IO_ERROR;
+    }
+    return Decode(data.data(), data.size(), rgba, width, height);
+}
+
+RETURN_CODE QoiImage::LoadPngCached(const std::string& pngPath, std::vector<unsigned char>& rgba, unsigned& width, unsigned& height)
+{
+    string      cachePath = pngPath + QOI_CACHE_EXTENSION;
+    struct stat pngInfo, cacheInfo;
+
+    bool bHavePng = stat(pngPath.c_str(), &pngInfo) == 0;
+    if (stat(cachePath.c_str(), &cacheInfo) == 0 && (!bHavePng || cacheInfo.st_mtime >= pngInfo.st_mtime))
+    {
+        if (ReadFile(cachePath, rgba, width, height) == RC_SUCCESS)
+        {
+            return RC_SUCCESS;
+        }
+        // a truncated or corrupt copy is decoded from the PNG again and replaced below
+        fprintf(stderr, "Ignoring the invalid cache %s\n", cachePath.c_str());
+    }
+
+    unsigned char* pixels = nullptr;
+    unsigned       error  = lodepng_decode_file(&pixels, &width, &height, pngPath.c_str(), LCT_RGBA, 8);
+    if (error)
+    {
+        fprintf(stderr, "Loading %s failed: %s\n", pngPath.c_str(), lodepng_error_text(error));
+        free(pixels);
+        return RC_IO_ERROR;
+    }
+    rgba.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+    free(pixels);
+
+    // the next load skips the PNG decode; the cache is only an optimization, e.g. a read-only directory is fine
+    WriteFile(cachePath, rgba.data(), width, height);
+    return RC_SUCCESS;
+}
@@ -8,26 +8,26 @@
 using namespace std;
 using namespace glm;
 
-Renderer::Renderer() : m_width(DEFAULT_WIDTH), m_height(DEFAULT_HEIGHT)
-{
-
-    initOpenGLRendering();
-    createBuffers(DEFAULT_WIDTH, DEFAULT_HEIGHT);
-}
+Renderer::Renderer() : Renderer(DEFAULT_WIDTH, DEFAULT_HEIGHT) {}
 
-Renderer::Renderer(int w, int h) : m_width(w), m_height(h), m_normalTransform(I_MATRIX), m_cameraTransform(I_MATRIX), m_objectTransform(I_MATRIX), m_cameraProjection(I_MATRIX), m_worldTransformation(I_MATRIX), m_bgColor(Util::getColor(CLEAR)), m_polygonColor(Util::getColor(BLACK)), m_wireframeColor(Util::getColor(WHITE)), m_ePostEffect(NONE), m_bloomIntensity(1.f), m_bloomThreshold(1.f)
+Renderer::Renderer(int w, int h, bool bHeadless /*= false*/) : m_bHeadless(bHeadless), m_colorFormat(CF_RGB32F), m_depthFormat(DF_32F), m_width(w), m_height(h), m_worldTransformation(I_MATRIX), m_cameraTransform(I_MATRIX), m_cameraProjection(I_MATRIX), m_objectTransform(I_MATRIX), m_normalTransform(I_MATRIX), m_fullTransform(I_MATRIX), m_bgColor(Util::getColor(CLEAR)), m_polygonColor(Util::getColor(BLACK)), m_wireframeColor(Util::getColor(WHITE)), m_ePostEffect(NONE), m_bloomIntensity(1.f), m_blurX(1), m_blurY(1), m_bloomThreshold(1.f)
 {
-    initOpenGLRendering();
+    if (!m_bHeadless)
+    {
+        initOpenGLRendering();
+    }
     createBuffers(w, h);
 }
 
 Renderer::~Renderer()
 {
-    delete[] colorBuffer;
-    delete[] bloomBuffer;
-    delete[] bloomDestBuff;
-    delete[] blurredBuffer;
-    delete[] zBuffer;
+    if (m_bHeadless)
+    {
+        return;
+    }
+    glDeleteTextures(1, &glScreenTex);
+    glDeleteVertexArrays(1, &glScreenVtc);
+    glDeleteProgram(glScreenProgram);
 }
 
 vec3 Renderer::processPipeline(vec3 point, PIPE_TYPE pipeType /*= FULL*/, glm::mat4x4* lightTransform /*= nullptr*/)
@@ -38,7 +38,7 @@ vec3 Renderer::processPipeline(vec3 point, PIPE_TYPE pipeType /*= FULL*/, glm::m
     switch (pipeType)
     {
     case FULL:
-        piped = m_cameraProjection * m_cameraTransform * m_worldTransformation * m_objectTransform * homogPoint;
+        piped = m_fullTransform * homogPoint;
         break;
     case AXIS:
         piped = m_cameraProjection * m_cameraTransform * homogPoint;
@@ -71,9 +71,11 @@ void Renderer::Init()
 
 }
 
-void Renderer::DrawTriangles(const std::vector<Face>& vertices, const glm::vec3* modelCentroid /*= nullptr*/, const glm::vec3 eye /*= ZERO_VEC3*/)
+void Renderer::DrawTriangles(const std::vector<Face>& vertices, const glm::vec3* modelCentroid /*= nullptr*/, const glm::vec3 eye /*= ZERO_VEC3*/,
+                             const std::vector<glm::vec3>* meshVertices /*= nullptr*/, const std::vector<EDGE>* edges /*= nullptr*/)
 {
-    
+    bool bEdgeList = (meshVertices != nullptr && edges != nullptr);
+
     for (auto it = vertices.begin(); it != vertices.end(); it++)
     {
         auto polygon = *it;
@@ -87,11 +89,41 @@ void Renderer::DrawTriangles(const std::vector<Face>& vertices, const glm::vec3*
         {
             PolygonScanConversion(viewPolygon);
         }
-        if (m_bDrawWireframe)
+        if (m_bDrawWireframe && !bEdgeList)
         {
             DrawPolygonLines(viewPolygon);
         }
+    }
+
+    if (bEdgeList && m_bDrawWireframe)
+    {
+        TransformVertices(*meshVertices, m_viewVertices);
+        DrawEdges(m_viewVertices, *edges);
+    }
+}
 
+void Renderer::TransformVertices(const std::vector<glm::vec3>& vertices, std::vector<glm::vec3>& viewVertices)
+{
+    viewVertices.resize(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        viewVertices[i] = projectToViewPlane(vertices[i]);
+    }
+}
+
+void Renderer::DrawEdges(const std::vector<glm::vec3>& viewVertices, const std::vector<EDGE>& edges)
+{
+    if (!m_bDrawWireframe)
+    {
+        return;
+    }
+
+    for (const EDGE& edge : edges)
+    {
+        if (edge.v1 < viewVertices.size() && edge.v2 < viewVertices.size())
+        {
+            DrawLine(viewVertices[edge.v1], viewVertices[edge.v2], m_wireframeColor);
+        }
     }
 }
 
@@ -155,7 +187,8 @@ void Renderer::CalculateLights(Face &polygon, Face &viewPolygon, const glm::vec3
         glm::vec3 reflection2 = normalize(PipedFaceP2 + (2.f * dot(normAndPipedNormalP2, lightCoord2)) * normAndPipedNormalP2 - lightCoord2);
         glm::vec3 reflection3 = normalize(PipedFaceP3 + (2.f * dot(normAndPipedNormalP3, lightCoord3)) * normAndPipedNormalP3 - lightCoord3);
 
-        glm::vec3 pipedEye = processPipeline(eye, LIGHT, &(inverse(m_cameraTransform)));
+        glm::mat4x4 eyeTransform = inverse(m_cameraTransform);
+        glm::vec3   pipedEye     = processPipeline(eye, LIGHT, &eyeTransform);
 
         glm::vec3 curr_eye1 = normalize(PipedFaceP1 + pipedEye);
         glm::vec3 curr_eye2 = normalize(PipedFaceP2 + pipedEye);
@@ -180,19 +213,15 @@ void Renderer::DrawPolygonLines(const Face& polygon)
 
 void Renderer::DrawFaceNormal(Face& face)
 {
-    auto faceCenter = face.m_faceCenter;
-    auto normalizedFaceNormal = face.m_normal;
-
-    normalizedFaceNormal.x *= m_faceNormScaleFactor;
-    normalizedFaceNormal.y *= m_faceNormScaleFactor;
-    normalizedFaceNormal.z *= m_faceNormScaleFactor;
-
-    auto nP1 = processPipeline(faceCenter);
-    auto nP2 = processPipeline(faceCenter + normalizedFaceNormal);
-    if (m_bDrawFaceNormals)
+    if (!m_bDrawFaceNormals)
     {
-        DrawLine(toViewPlane(nP1), toViewPlane(nP2), COLOR(LIME));
+        return;
     }
+
+    auto faceCenter = face.m_faceCenter;
+    auto scaledFaceNormal = face.m_normal * m_faceNormScaleFactor;
+
+    DrawLine(projectToViewPlane(faceCenter), projectToViewPlane(faceCenter + scaledFaceNormal), COLOR(LIME));
 }
 
 
@@ -204,11 +233,11 @@ void Renderer::PolygonScanConversion(Face& polygon)
     lowerLeft  = { MIN3(polygon.m_p1.x, polygon.m_p2.x, polygon.m_p3.x), MIN3(polygon.m_p1.y, polygon.m_p2.y, polygon.m_p3.y) };
     float maxZ = MAX3(polygon.m_p1.z, polygon.m_p2.z, polygon.m_p3.z);
 
-    upperRight.x = upperRight.x > m_width  ? m_width  : upperRight.x;
-    upperRight.y = upperRight.y > m_height ? m_height : upperRight.y;
+    upperRight.x = upperRight.x >= m_scissorX1 ? m_scissorX1 - 1 : upperRight.x;
+    upperRight.y = upperRight.y >= m_scissorY1 ? m_scissorY1 - 1 : upperRight.y;
 
-    lowerLeft.x  = lowerLeft .x > m_width  ? m_width  : lowerLeft.x;
-    lowerLeft.y  = lowerLeft .y > m_height ? m_height : lowerLeft.y;
+    lowerLeft.x  = lowerLeft .x < m_scissorX0 ? m_scissorX0 : lowerLeft.x;
+    lowerLeft.y  = lowerLeft .y < m_scissorY0 ? m_scissorY0 : lowerLeft.y;
 
 
     for (int x = lowerLeft.x; x <= upperRight.x; x++)
@@ -255,7 +284,7 @@ void Renderer::PolygonScanConversion(Face& polygon)
                     } break;
                 }
 
-                putPixel(x, y, maxZ, actualColor, &polygon);
+                putPixel(x, y, maxZ, actualColor);
             }
         }
     }
@@ -311,6 +340,57 @@ glm::vec3 Renderer::toViewPlane(const glm::vec3& point)
 
 }
 
+glm::vec3 Renderer::projectToViewPlane(const glm::vec3& point)
+{
+    return toViewPlane(Util::toCartesianForm(m_fullTransform * Util::toHomogeneousForm(point)));
+}
+
+void Renderer::updateFullTransform()
+{
+    m_fullTransform = m_cameraProjection * m_cameraTransform * m_worldTransformation * m_objectTransform;
+}
+
+bool Renderer::clipLine(glm::vec3& p1, glm::vec3& p2)
+{
+    float xMax  = static_cast<float>(m_width  - 1);
+    float yMax  = static_cast<float>(m_height - 1);
+    vec3  delta = p2 - p1;
+
+    // Liang-Barsky: p[k] * t <= q[k] for the left, right, bottom and top boundaries
+    float p[4] = { -delta.x, delta.x, -delta.y, delta.y };
+    float q[4] = { p1.x, xMax - p1.x, p1.y, yMax - p1.y };
+
+    float tEnter = 0.f;
+    float tExit  = 1.f;
+
+    for (int k = 0; k < 4; k++)
+    {
+        if (p[k] == 0.f)
+        {
+            // Parallel to this boundary
+            if (q[k] < 0.f) return false;
+            continue;
+        }
+
+        float t = q[k] / p[k];
+        if (p[k] < 0.f)
+        {
+            if (t > tExit) return false;
+            tEnter = MAX(tEnter, t);
+        }
+        else
+        {
+            if (t < tEnter) return false;
+            tExit = MIN(tExit, t);
+        }
+    }
+
+    vec3 start = p1;
+    p1 = start + tEnter * delta;
+    p2 = start + tExit  * delta;
+    return true;
+}
+
 Face Renderer::toViewPlane(Face polygon)
 {
     polygon.m_p1 = toViewPlane(polygon.m_p1);
@@ -358,77 +438,59 @@ PROJ_PARAMS Renderer::getProjectionParams()
 void Renderer::SetCameraTransform(const mat4x4 & cTransform)
 {
     m_cameraTransform = cTransform;
+    updateFullTransform();
 }
 
 void Renderer::SetProjection(const mat4x4 & projection)
 {
     m_cameraProjection = projection;
+    updateFullTransform();
 }
 
 void Renderer::SetObjectMatrices(const mat4x4 & oTransform, const mat4x4 & nTransform)
 {
     m_objectTransform = oTransform;
     m_normalTransform = nTransform;
+    updateFullTransform();
 }
 
 
-void Renderer::putPixel(int i, int j, float d, const vec4& color, Face* face)
+void Renderer::putPixel(int i, int j, float d, const vec4& color)
 {
-    if (i < 0) return; if (i >= m_width) return;
-    if (j < 0) return; if (j >= m_height) return;
-    if (putZ(i, j, d))
-    {
-        colorBuffer[COLOR_BUF_INDEX(m_width, i, j, 0)] = color.x;
-        colorBuffer[COLOR_BUF_INDEX(m_width, i, j, 1)] = color.y;
-        colorBuffer[COLOR_BUF_INDEX(m_width, i, j, 2)] = color.z;
-        
-        if (face)
-        {
-            float brightness = glm::dot({ color.x,color.y,color.z }, vec3(m_bloomThreshold.x, m_bloomThreshold.y, m_bloomThreshold.z));
-
-//             float dotIntensity = sqrt(color.x*color.x / 3 + color.y*color.y / 3 + color.z*color.z / 3);
-            if (brightness > m_bloomThresh)
-            {
-                vec3 color3Vec = { color.x,color.y,color.z };
-                bloomBuffer[COLOR_BUF_INDEX(m_width, i, j, 0)] = color.x;
-                bloomBuffer[COLOR_BUF_INDEX(m_width, i, j, 1)] = color.y;
-                bloomBuffer[COLOR_BUF_INDEX(m_width, i, j, 2)] = color.z;
-            }
-        }
-        }
+    if (i < m_scissorX0) return; if (i >= m_scissorX1) return;
+    if (j < m_scissorY0) return; if (j >= m_scissorY1) return;
 
-    else if(color.x == 0 && color.y == 0 && color.z == 0 && zBuffer[Z_BUF_INDEX(m_width, i, j)] == numeric_limits<float>::lowest())
+    if (zBuffer.TestAndSet(i, j, d))
     {
-//        printf("i = %d, j = %d, d = %f\n");
+        colorBuffer.Write(i, j, vec3(color));
     }
-
 }
 
 bool Renderer::putZ(int x, int y, float d)
 {
-    if (x < 0 || x >= m_width || y < 0 || y >= m_height)
+    if (x < m_scissorX0 || x >= m_scissorX1 || y < m_scissorY0 || y >= m_scissorY1)
     {
         return false;
     }
     
-    if (d < zBuffer[Z_BUF_INDEX(m_width, x, y)])
-    {
-//     fprintf(stderr, "FALSE - x,y:%d,%d Index is %d, zBuffer value is %f, depth value is %f\n", x, y, Z_BUF_INDEX(m_width, x, y), zBuffer[Z_BUF_INDEX(m_width, x, y)], d);
-//     printf("zBuffer for (%d,%d) = %f, and depth is %f\n", x, y, zBuffer[Z_BUF_INDEX(m_width, x, y)], d);
-        return false;
-    }
-    zBuffer[Z_BUF_INDEX(m_width, x, y)] = d;
-//     fprintf(stderr, "TRUE - x,y:%d,%d Index is %d, zBuffer value is %f, depth value is %f\n", x, y, Z_BUF_INDEX(m_width, x, y), zBuffer[Z_BUF_INDEX(m_width, x, y)], d);
-    return true;
+    return zBuffer.TestAndSet(x, y, d);
 }
 
 void Renderer::DrawLine(const glm::vec3& p1, const glm::vec3& p2, const glm::vec4& color)
 {
+    float depth = MAX(p1.z, p2.z);
+    vec3  clippedP1 = p1;
+    vec3  clippedP2 = p2;
 
-    int x0 = static_cast<int>(round(p1.x));
-    int y0 = static_cast<int>(round(p1.y));
-    int x1 = static_cast<int>(round(p2.x));
-    int y1 = static_cast<int>(round(p2.y));
+    if (!clipLine(clippedP1, clippedP2))
+    {
+        return;
+    }
+
+    int x0 = static_cast<int>(round(clippedP1.x));
+    int y0 = static_cast<int>(round(clippedP1.y));
+    int x1 = static_cast<int>(round(clippedP2.x));
+    int y1 = static_cast<int>(round(clippedP2.y));
 
 
     int resSize = 1;
@@ -441,7 +503,7 @@ void Renderer::DrawLine(const glm::vec3& p1, const glm::vec3& p2, const glm::vec
 
     for (; ; )
     {
-        putPixel(x0, y0, MAX(p1.z,p2.z), color); //Printing points here
+        putPixel(x0, y0, depth, color); //Printing points here
         if (i <= 0) break;
         x1 -= dx; if (x1 < 0) { x1 += dm; x0 += sx; }
         y1 -= dy; if (y1 < 0) { y1 += dm; y0 += sy; }
@@ -463,23 +525,45 @@ void Renderer::putPixel(int x, int y, bool steep, float d, const vec4& color)
 
 void Renderer::createBuffers(int w, int h)
 {
-    colorBuffer   = new float[3 * w * h];
-    blurredBuffer = new float[3 * w * h];
-    bloomBuffer   = new float[3 * w * h];
-    bloomDestBuff = new float[3 * w * h];
-    zBuffer       = new float[1 * w * h];
+    // the arena only reallocates when the new frame does not fit, so resizing back and forth is allocation free
+    m_frameArena.Reset(2 * ColorTarget::ArenaBytes(w, h, m_colorFormat) + DepthTarget::ArenaBytes(w, h, m_depthFormat));
 
-    memset(colorBuffer  ,                  0.f                   , sizeof(float) * 3 * w * h);
-    memset(blurredBuffer,                  0.f                   , sizeof(float) * 3 * w * h);
-    memset(bloomBuffer  ,                  0.f                   , sizeof(float) * 3 * w * h);
-    memset(bloomDestBuff,                  0.f                   , sizeof(float) * 3 * w * h);
-    memset(zBuffer      , -std::numeric_limits<float>::infinity(), sizeof(float) * 1 * w * h);
+    colorBuffer  .Attach(m_frameArena, w, h, m_colorFormat);
+    blurredBuffer.Attach(m_frameArena, w, h, m_colorFormat);
+    zBuffer      .Attach(m_frameArena, w, h, m_depthFormat);
 
+    pDispBuffer = &colorBuffer;
+    SetScissor(0, 0, w, h);
+}
+
+void Renderer::SetScissor(int x0, int y0, int x1, int y1)
+{
+    m_scissorX0 = MAX(x0, 0);
+    m_scissorY0 = MAX(y0, 0);
+    m_scissorX1 = MIN(x1, m_width);
+    m_scissorY1 = MIN(y1, m_height);
+}
+
+void Renderer::SetFrameBufferFormat(COLOR_FORMAT colorFormat, DEPTH_FORMAT depthFormat)
+{
+    if (colorFormat == m_colorFormat && depthFormat == m_depthFormat)
+    {
+        return;
+    }
+    m_colorFormat = colorFormat;
+    m_depthFormat = depthFormat;
+    createBuffers(m_width, m_height);
+}
+
+size_t Renderer::GetFrameBufferBytes()
+{
+    return colorBuffer.GetBytes() + blurredBuffer.GetBytes() + zBuffer.GetBytes();
 }
 
 void Renderer::SetWorldTransformation(mat4x4 worldTransformation)
 {
     m_worldTransformation = worldTransformation;
+    updateFullTransform();
 }
 
 // void Renderer::SetSolidColor(bool bShowSolidColor)
@@ -597,7 +681,24 @@ GENERATED_TEXTURE Renderer::GetGeneratedTexture()
 // don't linger here for now, we will have a few tutorials about opengl later.
 void Renderer::initOpenGLRendering()
 {
+    // InitShader makes the new program current, the scene keeps using its own.
+    GLint prevProgram = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &prevProgram);
+    glScreenProgram = InitShader("screen_vshader.glsl", "screen_fshader.glsl");
+    glUseProgram(prevProgram);
+
+    // The fullscreen triangle is generated from gl_VertexID, the VAO holds no attributes.
+    glGenVertexArrays(1, &glScreenVtc);
+
+    glGenTextures(1, &glScreenTex);
+    glBindTexture(GL_TEXTURE_2D, glScreenTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
+    createOpenGLBuffer();
 }
 
 void Renderer::getDeltas(IN float x1, IN float x2, IN float y1, IN float y2, IN float d1, IN float d2, OUT float* pDx, OUT float* pDy, OUT float* pDd)
@@ -633,147 +734,52 @@ void Renderer::ProjectPolygon(Face& polygon)
 
 void Renderer::createOpenGLBuffer()
 {
-
-
-
+    glBindTexture(GL_TEXTURE_2D, glScreenTex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_width, m_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_screenPixels.resize(static_cast<size_t>(m_width) * m_height * 4);
 }
 
 void Renderer::SwapBuffers()
-{    
-    // Same for vertex array object (VAO). VAO is a set of buffers that describe a renderable object.
-    glGenVertexArrays(1, &glScreenVtc);
-    // Makes this VAO the current one.
-    glBindVertexArray(glScreenVtc);
-//     // Creates a unique identifier for an opengl texture.
-//     glGenTextures(1, &glScreenTex);
-//     // Makes glScreenTex (which was allocated earlier) the current texture.
-//     glBindTexture(GL_TEXTURE_2D, glScreenTex);
-//     // Makes GL_TEXTURE0 the current active texture unit
-//     glActiveTexture(GL_TEXTURE0);
-//     // malloc for a texture on the gpu.
-//     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, m_width, m_height, 0, GL_RGB, GL_FLOAT, nullptr);
-
-    //     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    //     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-
-    glClearColor(m_bgColor.x, m_bgColor.y, m_bgColor.z, 1.f);
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-//     glGenBuffers(1, &glVertices);
-//     glBindBuffer(GL_ARRAY_BUFFER, glVertices);
-// 
-//         // This is the opengl way for doing malloc on the gpu. 
-//         glBufferData(GL_ARRAY_BUFFER, mVerticesPositionsSize*sizeof(GLfloat), mVerticesPositions, GL_STATIC_DRAW);
-
-    // memcopy vtc to buffer[0,sizeof(vtc)-1]
-//     glBufferSubData(GL_ARRAY_BUFFER, 0, mVerticesPositionsSize * sizeof(GLfloat), mVerticesPositions);
-// //     // memcopy tex to buffer[sizeof(vtc),sizeof(vtc)+sizeof(tex)]
-//     glBufferSubData(GL_ARRAY_BUFFER, mVerticesPositionsSize * sizeof(GLfloat), mVerticesColorsSize * sizeof(GLfloat), mVerticesColors);
-    // Loads and compiles a shader.
-
-//         GLuint program = InitShader("vshader.glsl", "fshader.glsl");
-//         // Make this program the current one.
-//         glUseProgram(program);
-//         // Tells the shader where to look for the vertex position data, and the data dimensions.
-//         GLint  vPosition = glGetAttribLocation(program, "vPosition");
-//         glEnableVertexAttribArray(vPosition);
-//         glVertexAttribPointer(vPosition, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
-// 
-
-    // Makes glScreenTex (which was allocated earlier) the current texture.
-    //glBindTexture(GL_COLOR_BUFFER_BIT, glScreenTex);
-    //     // memcopy's colorBuffer into the gpu.
-    //glfwLoadTexture2D(imagepath, 0);
-    //glBufferData(GL_COLOR_BUFFER_BIT, mVerticesColorsSize * sizeof(GLfloat), mVerticesColors, GL_STATIC_DRAW);
-
-    //glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_RGB, GL_FLOAT, mVerticesColors/*mvTexturesBuffer*/);
-    //     // Tells opengl to use mipmapping
-    //glGenerateMipmap(GL_TEXTURE_2D);
-
-        // Same for texture coordinates data.
-//         GLint  vTexCoord = glGetAttribLocation(Util::program, "vTexCoord");
-//         glEnableVertexAttribArray(vTexCoord);
-//         glVertexAttribPointer(vTexCoord, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+{
+    if (m_bHeadless)
+    {
+        return;
+    }
 
-        //glProgramUniform1i( program, glGetUniformLocation(program, "texture"), 0 );
+    GLint     prevProgram = 0;
+    GLboolean depthTest   = glIsEnabled(GL_DEPTH_TEST);
 
-        // Tells the shader to use GL_TEXTURE0 as the texture id.
+    glGetIntegerv(GL_CURRENT_PROGRAM, &prevProgram);
 
-//         glm::mat4 Projection = glm::perspective(glm::radians(45.0f), (float)m_width / (float)m_height, 0.1f, 100.0f);
+    pDispBuffer->PackRGBA8(m_screenPixels.data());
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, glScreenTex);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, m_screenPixels.data());
 
-        //glm::mat4 Projection = glm::ortho(-10.0f,10.0f,-10.0f,10.0f,0.0f,100.0f); // In world coordinates
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(glScreenProgram);
+    glUniform1i(glGetUniformLocation(glScreenProgram, "screenTexture"), 0);
 
-//         glm::mat4 View = glm::lookAt(
-//             glm::vec3(4, 3, 3), // Camera is at (4,3,3), in World Space
-//             glm::vec3(0, 0, 0), // and looks at the origin
-//             glm::vec3(0, 1, 0)  // Head is up (set to 0,-1,0 to look upside-down)
-//         );
-//         GLuint ModelMatrixID = glGetUniformLocation(Util::program, "Model");
-//         glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &m_objectTransform[0][0]);
-// 
-//         GLuint ViewMatrixID = glGetUniformLocation(Util::program, "View");
-//         glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &m_cameraTransform[0][0]);
-// 
-//         GLuint ProjectionMatrixID = glGetUniformLocation(Util::program, "Projection");
-//         glUniformMatrix4fv(ProjectionMatrixID, 1, GL_FALSE, &m_cameraProjection[0][0]);
-
-//     pDispBuffer = colorBuffer;
-//     
-//     if (m_blurX > 1 || m_blurY > 1)
-//     {
-//         switch (m_ePostEffect)
-//         {
-//         case BLUR_SCENE:
-//             pDispBuffer = blurredBuffer;
-//             break;
-//         case BLOOM:
-//             pDispBuffer = blurredBuffer;
-//             break;
-//         default:
-//             pDispBuffer = colorBuffer;
-//             break;
-//         }
-//     }
-
-
-    // 
-    //     // Finally renders the data.
-
-//         glBindVertexArray(glScreenVtc);
-//         glBindBuffer(GL_ARRAY_BUFFER, glVertices);
-// 
-//         glDrawArrays(GL_TRIANGLES, 0, mVerticesPositionsSize);
-// 
-//         glBindVertexArray(0);
-//         glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(glScreenVtc);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
 
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(prevProgram);
+    if (depthTest)
+    {
+        glEnable(GL_DEPTH_TEST);
+    }
 }
 
 void Renderer::ClearColorBuffer()
 {
   //  glClear(GL_COLOR_BUFFER_BIT);
-    for (int i = 0; i < m_width; i++)
-    {
-        for (int j = 0; j < m_height; j++)
-        {
-            colorBuffer[COLOR_BUF_INDEX(m_width, i, j, 0)] = m_bgColor.x;
-            colorBuffer[COLOR_BUF_INDEX(m_width, i, j, 1)] = m_bgColor.y;
-            colorBuffer[COLOR_BUF_INDEX(m_width, i, j, 2)] = m_bgColor.z;
-        }
-    }
-
-    if (m_ePostEffect == BLUR_SCENE)
-    {
-        memset(blurredBuffer, 0.f, sizeof(float) * m_width * m_height * 3);
-
-    }
-    else if (m_ePostEffect == BLOOM)
-    {
-        memset(bloomDestBuff, 0.f, sizeof(float) * m_width * m_height * 3);
-        memset(bloomBuffer  , 0.f, sizeof(float) * m_width * m_height * 3);
-    }
+    pDispBuffer = &colorBuffer;
 
+    // lazy clear, only the tile flags are touched here. blurredBuffer is fully rewritten by the post effect.
+    colorBuffer.Clear(vec3(m_bgColor));
 }
 
 void Renderer::Viewport(int w, int h)
@@ -784,16 +790,21 @@ void Renderer::Viewport(int w, int h)
     }
     m_width       = w;
     m_height      = h;
-    delete[] colorBuffer;
-    delete[] blurredBuffer;
-    delete[] bloomDestBuff;
-    delete[] zBuffer;
-    colorBuffer   = new float[3 * h*w];
-    blurredBuffer = new float[3 * h*w];
-    bloomBuffer   = new float[3 * h*w];
-    bloomDestBuff = new float[3 * h*w];
-    zBuffer       = new float[h*w];
-    createOpenGLBuffer();
+    createBuffers(w, h);
+    if (!m_bHeadless)
+    {
+        createOpenGLBuffer();
+    }
+}
+
+void Renderer::ReadPixels(unsigned char* rgba)
+{
+    pDispBuffer->PackRGBA8(rgba);
+}
+
+void Renderer::ReadPixels(unsigned char* rgba, int x0, int y0, int x1, int y1)
+{
+    pDispBuffer->PackRGBA8(rgba, x0, y0, x1, y1);
 }
 
 
@@ -830,131 +841,22 @@ void Renderer::SetWireframeColor(const glm::vec4& newWireframeColor)
 void Renderer::ClearDepthBuffer()
 {
    // glClear(GL_DEPTH_BUFFER_BIT);
-
-    for (int i = 0; i < m_width; i++)
-    {
-        for (int j = 0; j < m_height; j++)
-        {
-            zBuffer[Z_BUF_INDEX(m_width, i, j)] = -std::numeric_limits<float>::infinity();
-        }
-    }
+    zBuffer.Clear();
 }
 
 
 void Renderer::applyPostEffect(int kernelSizeX, int kernelSizeY, float sigma, POST_EFFECT postEffect /*= NONE*/)
 {
-    static int kerSizeX = -1;
-    static int kerSizeY = -1;
-
-    float* source;
-    float* destination;
-
-    static float kernel[29][29] = { 0 };
-
-    if (kernelSizeX <= 2 && kernelSizeY <= 2 || postEffect == NONE)
-    {
-        pDispBuffer = colorBuffer;
-        return;
-    }
-
-
-    if (kerSizeX != kernelSizeX || kerSizeY != kernelSizeY || sigma != m_sigma)
-    {
-        kerSizeX = kernelSizeX;
-        kerSizeY = kernelSizeY;
-        m_sigma = sigma;
-
-        Renderer::makeKernel(kernel, kernelSizeX, kernelSizeY, sigma);
-
-        static int counter = 0;
-        printf("%d: kernel size is x,y:%d,%d with sigma %f\n", ++counter, kernelSizeX, kernelSizeY, sigma);
-        for (int kX = 0; kX < kernelSizeX; ++kX)
-        {
-            for (int kY = 0; kY < kernelSizeY; ++kY)
-            {
-                printf("%f\t\t", kernel[kX][kY]);
-            }
-            printf("\n\n");
-        }
-    }
+    m_postProcess.Configure(postEffect, kernelSizeX, kernelSizeY, sigma, m_bloomIntensity, vec3(m_bloomThreshold), m_bloomThresh);
 
-    switch (postEffect)
+    if (!m_postProcess.IsActive())
     {
-    case NONE:
+        pDispBuffer = &colorBuffer;
         return;
-        break;
-    case BLUR_SCENE:
-        source = colorBuffer;
-        destination = blurredBuffer;
-        break;
-    case BLOOM:
-        source = bloomBuffer;
-        destination = bloomDestBuff;
-        break;
-    default:
-        return;
-        break;
-    }
-
-    int halfX = kernelSizeX / 2;
-    int halfY = kernelSizeY / 2;
-
-    for (int x = halfX; x < m_width - halfX; x++)
-    {
-        for (int y = halfY; y < m_height - halfY; y++)
-        {
-            for (int color = 0; color < 3; color++)
-            {
-                float sum = 0.0f;
-                float sumBloom = 0.0f;
-                for (int kX = -halfX; kX <= halfX; kX++)
-                {
-                    for (int kY = -halfY; kY <= halfY; kY++)
-                    {
-                        sum += kernel[kX + halfX][kY + halfY] * colorTruncate(source[COLOR_BUF_INDEX(m_width, x + kX, y + kY, color)]);
-                        if (postEffect == BLOOM)
-                        {
-                            sumBloom += kernel[kX + halfX][kY + halfY] * colorTruncate(colorBuffer[COLOR_BUF_INDEX(m_width, x + kX, y + kY, color)]);
-                        }
-                    }
-                }
-                destination[COLOR_BUF_INDEX(m_width, x, y, color)] = sum;
-                if (postEffect == BLOOM)
-                {
-                    blurredBuffer[COLOR_BUF_INDEX(m_width, x, y, color)] = sumBloom;
-                }
-            }
-        }
     }
 
-
-    if (postEffect == BLOOM)
-    {   
-        for (int x = 0; x < m_width; x++)
-        {
-            for (int y = 0; y < m_height; y++)
-            {
-                for (int color = 0; color < 3; color++)
-                    blurredBuffer[COLOR_BUF_INDEX(m_width, x, y, color)] += m_bloomIntensity * bloomDestBuff[COLOR_BUF_INDEX(m_width, x, y, color)];
-            }
-        }
-    }
-}
-
-float Renderer::colorTruncate(float color)
-{
-    if (color >= 0 && color <= 1)
-    {
-        return color;
-    }
-    else if (color < 0)
-    {
-        return 0;
-    }
-    else
-    {
-        return 1; 
-    }
+    m_postProcess.Apply(colorBuffer, blurredBuffer);
+    pDispBuffer = &blurredBuffer;
 }
 
 void Renderer::configPostEffect(POST_EFFECT postEffect, int blurX, int blurY, float sigma, float bloomIntensity, glm::vec4 bloomThreshold, float bloomThresh)
@@ -965,29 +867,4 @@ void Renderer::configPostEffect(POST_EFFECT postEffect, int blurX, int blurY, fl
     m_bloomIntensity = bloomIntensity;
     m_bloomThreshold = bloomThreshold;
     m_bloomThresh = bloomThresh;
-}
-
-void Renderer::makeKernel(float gaussianKernel[][29], int kernelSizeX, int kernelSizeY, float sigma)
-{
-    float meanX = kernelSizeX / 2;
-    float meanY = kernelSizeY / 2;
-    float sum = 0.0; // For accumulating the kernel values
-
-    for (int x = 0; x < kernelSizeX; ++x)
-    {
-        for (int y = 0; y < kernelSizeY; ++y)
-        {
-            gaussianKernel[x][y] = exp(-0.5 * (pow((x - meanX) / sigma, 2.0) + pow((y - meanY) / sigma, 2.0))) / (2 * PI * pow(sigma, 2));
-            sum += gaussianKernel[x][y];
-        }
-    }
-
-    // Normalize the kernel
-    for (int x = 0; x < kernelSizeX ; x++)
-    {
-        for (int y = 0; y < kernelSizeY; y++)
-        {
-            gaussianKernel[x][y] /= sum;
-        }
-    }
 }
\ No newline at end of file
@@ -1,15 +1,18 @@
+#include <algorithm>
+#include <fstream>
 #include "Scene.h"
 #include "MeshModel.h"
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "InitShader.h"
+#include "MeshSimplifier.h"
 using namespace std;
 using namespace glm;
 
 #define IS_CAMERA true
 
 
-Scene::Scene() : m_activeModel(DISABLED), m_activeLight(DISABLED), m_activeCamera(DISABLED), m_bDrawVecNormal(false), m_vnScaleFactor(2.f), m_fnScaleFactor(2.f), m_bgColor(COLOR(YURI_BG)), m_polygonColor(COLOR(YURI_POLYGON)), m_wireframeColor(COLOR(YURI_WIRE)), m_bDrawWireframe(true), m_bBlurX(1), m_bBlurY(1), m_sigma(1.f), m_ePostEffect(NONE)
+Scene::Scene() : m_activeModel(DISABLED), m_activeLight(DISABLED), m_activeCamera(DISABLED), m_bDrawVecNormal(false), m_vnScaleFactor(2.f), m_fnScaleFactor(2.f), m_bgColor(COLOR(YURI_BG)), m_polygonColor(COLOR(YURI_POLYGON)), m_wireframeColor(COLOR(YURI_WIRE)), m_bDrawWireframe(true), m_bBlurX(1), m_bBlurY(1), m_sigma(1.f), m_ePostEffect(NONE), m_nextLoadTicket(0), m_lodErrorPixels(MESH_LOD_ERROR_PIXELS)
 {
     m_program = InitShader("vshader.glsl", "fshader.glsl");
     // Make this program the current one.
@@ -29,18 +32,107 @@ void Scene::LoadOBJModel(std::string fileName, const Surface& material)
     }
 }
 
+void Scene::LoadOBJModelAsync(const std::string& fileName, const Surface& material)
+{
+    PMeshAsset asset = MeshAssetRegistry::Instance().Find(fileName, m_program);
+    if (asset)
+    {
+        m_models.push_back(new MeshModel(asset, material, m_program));
+        m_activeModel++;
+        return;
+    }
+
+    if (!m_placeholderMesh)
+    {
+        // the [-1,1] cube every mesh is normalized into
+        static const char placeholderObj[] =
+            "v -1 -1 -1\nv 1 -1 -1\nv 1 1 -1\nv -1 1 -1\nv -1 -1 1\nv 1 -1 1\nv 1 1 1\nv -1 1 1\n"
+            "f 1 3 2\nf 1 4 3\nf 5 6 7\nf 5 7 8\nf 1 2 6\nf 1 6 5\nf 4 8 7\nf 4 7 3\nf 1 5 8\nf 1 8 4\nf 2 3 7\nf 2 7 6\n";
+        m_placeholderMesh = MeshAssetRegistry::Instance().Acquire("<loading placeholder>", placeholderObj, m_program);
+    }
+
+    MeshModel* model = new MeshModel(m_placeholderMesh, material, m_program);
+    m_models.push_back(model);
+    m_activeModel++;
+
+    // several models of the same file wait for one load; large files show a preview and coarse levels meanwhile
+    if (m_loadingModels.find(fileName) == m_loadingModels.end())
+    {
+        ifstream  file(fileName.c_str(), ios::binary | ios::ate);
+        streamoff size = file ? (streamoff)file.tellg() : 0;
+        m_meshLoader.Load(fileName, size >= ASYNC_PROGRESSIVE_MIN_BYTES);
+    }
+    m_loadTickets[m_nextLoadTicket] = model;
+    m_loadingModels.insert({ fileName, m_nextLoadTicket++ });
+}
+
+void Scene::updateLoadingModels()
+{
+    vector<AsyncMeshLoader::Result> finished;
+    m_meshLoader.Update(ASYNC_UPLOAD_BUDGET_BYTES, finished);
+
+    for (AsyncMeshLoader::Result& result : finished)
+    {
+        auto waiting = m_loadingModels.equal_range(result.path);
+
+        // a stand-in of a progressive load, the models keep waiting for the next one
+        if (!result.bFinal)
+        {
+            for (auto it = waiting.first; it != waiting.second; ++it)
+            {
+                auto ticket = m_loadTickets.find(it->second);
+                if (ticket != m_loadTickets.end())
+                {
+                    ticket->second->SetAsset(result.asset);
+                }
+            }
+            continue;
+        }
+
+        PMeshAsset asset;
+        if (result.asset)
+        {
+            asset = MeshAssetRegistry::Instance().Register(result.path, result.asset);
+        }
+        else
+        {
+            fprintf(stderr, "Opening file %s failed\n", result.path.c_str());
+        }
+
+        for (auto it = waiting.first; it != waiting.second; ++it)
+        {
+            // the model may have been deleted meanwhile
+            auto ticket = m_loadTickets.find(it->second);
+            if (ticket == m_loadTickets.end())
+            {
+                continue;
+            }
+            MeshModel* model = ticket->second;
+            m_loadTickets.erase(ticket);
+            if (asset)
+            {
+                model->SetAsset(asset);
+            }
+            else
+            {
+                m_models.erase(find(m_models.begin(), m_models.end(), (Model*)model));
+                delete model;
+                m_activeModel = (int)m_models.size() - 1;
+            }
+        }
+        m_loadingModels.erase(waiting.first, waiting.second);
+    }
+}
+
 void Scene::Draw()
 {
+    updateLoadingModels();
+    TextureManager::Instance().Update(TEXTURE_UPLOAD_BUDGET_BYTES);
+
     // 1. Send the renderer the current camera transform and the projection
     // 2. Tell all models to draw themselves
     Camera* activeCamera = nullptr;
 
-    vector<Face> vPolygons;//TODO: RESERVE
-    vector<vec3> vVertices;
-    vector<vec3> vVerticesNormals;
-    vector<vec3> vVerticesPositions;
-
-
     glClearColor(m_bgColor.x, m_bgColor.y, m_bgColor.z, 1.f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -58,6 +150,11 @@ void Scene::Draw()
     mat4x4 View = activeCamera->GetTransformation();
     mat4x4 Projection = activeCamera->GetProjection();
 
+    // Wireframe is overlaid by the fragment shader in the same draw as the solid mesh
+    glUniform1i(glGetUniformLocation(m_program, "drawWireframe"), m_bDrawWireframe ? GL_TRUE : GL_FALSE);
+    glUniform3f(glGetUniformLocation(m_program, "wireframeColour"), m_wireframeColor.x, m_wireframeColor.y, m_wireframeColor.z);
+    glUniform1f(glGetUniformLocation(m_program, "wireframeWidth"), WIREFRAME_WIDTH);
+
 //     for each(Light* light in m_lights)
 //     {
 //         LightMeshModel& lightModel = light->GetLightModel();
@@ -71,71 +168,61 @@ void Scene::Draw()
 //         }
 //     }
 
-    for each (Model* model in m_models)
+    // the last light is the one the shader sees, as a directional light shining from its position towards the origin
+    for each(Light* light in m_lights)
     {
+        GLuint uniformAmbientColour = glGetUniformLocation(m_program, "directionalLight.colour");
+        GLuint uniformAmbientIntensity = glGetUniformLocation(m_program, "directionalLight.ambientIntensity");
+        GLuint uniformDiffuseColour = glGetUniformLocation(m_program, "directionalLight.diffuseColour");
+        GLuint uniformDiffuseIntensity = glGetUniformLocation(m_program, "directionalLight.diffuseIntensity");
+        GLuint uniformDirection = glGetUniformLocation(m_program, "directionalLight.direction");
 
-        tuple modelData(vPolygons, vVertices, vVerticesNormals, vVerticesPositions);
+        LightMeshModel& lightModel = light->GetLightModel();
+        vec3 position  = vec3(lightModel.GetModelTransformation() * vec4(lightModel.getCentroid(), 1.f));
+        vec3 direction = length(position) > 0.f ? normalize(position) : vec3(0.f, 0.f, 1.f);
 
-        vector<Face>& polygonsToLight = get<TUPLE_POLYGONS>(modelData);
-        for each(Light* light in m_lights)
-        {
-            if (/*light->isOn()*/ true)
-            {
+        glUniform3f(uniformAmbientColour, light->GetAmbientColor().x, light->GetAmbientColor().y, light->GetAmbientColor().z);
+        glUniform1f(uniformAmbientIntensity, light->GetAmbientIntensity());
+        glUniform3f(uniformDiffuseColour, light->GetDiffusiveColor().x, light->GetDiffusiveColor().y, light->GetDiffusiveColor().z);
+        glUniform1f(uniformDiffuseIntensity, light->GetDiffusiveIntensity());
+        glUniform3f(uniformDirection, direction.x, direction.y, direction.z);
+    }
 
-                GLuint uniformAmbientColour = glGetUniformLocation(m_program, "directionalLight.colour");
-                GLuint uniformAmbientIntensity = glGetUniformLocation(m_program, "directionalLight.ambientIntensity");
+    GLuint ViewMatrixID = glGetUniformLocation(m_program, "View");
+    glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &View[0][0]);
 
-                glUniform3f(uniformAmbientColour, light->GetAmbientColor().x, light->GetAmbientColor().y, light->GetAmbientColor().z);
-                glUniform1f(uniformAmbientIntensity, light->GetAmbientIntensity());
+    GLuint ProjectionMatrixID = glGetUniformLocation(m_program, "Projection");
+    glUniformMatrix4fv(ProjectionMatrixID, 1, GL_FALSE, &Projection[0][0]);
 
+    // The levels of detail are chosen by their error in pixels of the current viewport
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    vec2   pixelsPerNdc(viewport[2] / 2.f, viewport[3] / 2.f);
+    mat4x4 viewProjection = Projection * View;
 
-//                 for(Face& faceIt : polygonsToLight)
-//                 {
-//                     light->Illuminate(faceIt, light->GetLightModel().GetModelTransformation());
-//                 }
-            }
+    // Models sharing a mesh are drawn together, one instanced draw per mesh and texture
+    m_instancer.Begin();
+    for each (Model* model in m_models)
+    {
+        mat4x4     objTransformation = model->GetTranslateTransformation() * model->GetRotateTransformation() * model->GetScaleTransformation();
+        MeshModel* meshModel         = static_cast<MeshModel*>(model);
+        if (!meshModel->GetAsset())
+        {
+            continue;
         }
-        tie(vPolygons, vVertices, vVerticesNormals, vVerticesPositions) = modelData;
-
-        mat4x4 objTransformation = model->GetTranslateTransformation() * model->GetRotateTransformation() * model->GetScaleTransformation();
-
-
-        GLuint ModelMatrixID = glGetUniformLocation(m_program, "Model");
-        glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &objTransformation[0][0]);
-
-        GLuint ViewMatrixID = glGetUniformLocation(m_program, "View");
-        glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &View[0][0]);
-
-        GLuint ProjectionMatrixID = glGetUniformLocation(m_program, "Projection");
-        glUniformMatrix4fv(ProjectionMatrixID, 1, GL_FALSE, &Projection[0][0]);
-
-        model->Draw(modelData);
-
-     }
+        const MeshAsset& level = meshModel->GetAsset()->SelectLod(viewProjection * objTransformation, pixelsPerNdc, m_lodErrorPixels);
+        m_instancer.Add(*meshModel, objTransformation, &level);
+    }
 
     for each(Camera* camera in m_cameras)
     {
         auto camModel = (CamMeshModel*) camera->getCameraModel();
         if (camModel->isModelRenderingActive() && camera != activeCamera)
         {
-            vVerticesNormals.reserve(0);
-            tuple camModelData(vPolygons, vVertices, vVerticesNormals, vVerticesPositions);
-            mat4x4 cameraModelTransformation = camModel->GetModelTransformation();
-            GLuint ModelMatrixID = glGetUniformLocation(m_program, "Model");
-
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &cameraModelTransformation[0][0]);
-
-            GLuint ViewMatrixID = glGetUniformLocation(m_program, "View");
-            glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &View[0][0]);
-
-            GLuint ProjectionMatrixID = glGetUniformLocation(m_program, "Projection");
-            glUniformMatrix4fv(ProjectionMatrixID, 1, GL_FALSE, &Projection[0][0]);
-
-
-            camModel->Draw(camModelData);
-
+            m_instancer.Add(*camModel, camModel->GetModelTransformation());
         }
     }
+    m_instancer.Draw(m_program);
 
 //     renderer->applyPostEffect(m_bBlurX, m_bBlurY, m_sigma, m_ePostEffect);
 
@@ -805,6 +892,21 @@ unsigned int Scene::AddPrimitiveModel(PRIM_MODEL primitiveModel, const Surface&
     return (unsigned)m_models.size() - 1;
 }
 
+void Scene::AddPrimitiveGrid(PRIM_MODEL primitiveModel, const Surface& material, unsigned int count)
+{
+    unsigned int side    = (unsigned int)ceil(sqrt((double)count));
+    float        spacing = 2.5f;
+    float        origin  = -0.5f * spacing * (side - 1);
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        Model* newModel = new PrimMeshModel(primitiveModel, material, m_program);
+        mat4x4 translation = translate(mat4x4(I_MATRIX), vec3(origin + spacing * (i % side), 0.f, origin + spacing * (i / side)));
+        newModel->SetTranslateTransformation(translation);
+        m_models.push_back(newModel);
+    }
+}
+
 void Scene::NextModel()
 {
     if (m_activeModel != DISABLED)
@@ -817,6 +919,11 @@ void Scene::DeleteActiveModel()
 {
     if (m_activeModel != DISABLED)
     {
+        Model* model = m_models[m_activeModel];
+        for (auto ticket = m_loadTickets.begin(); ticket != m_loadTickets.end();)
+        {
+            ticket = ((Model*)ticket->second == model) ? m_loadTickets.erase(ticket) : next(ticket);
+        }
         m_models.erase(m_models.begin() + m_activeModel);
         m_activeModel = (unsigned)m_models.size() - 1;
     }
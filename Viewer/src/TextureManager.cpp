@@ -0,0 +1,214 @@
+#include <string.h>
+#include "TextureManager.h"
+#include "QoiImage.h"
+
+using namespace std;
+
+Texture::~Texture()
+{
+    if (m_name != 0)
+    {
+        glDeleteTextures(1, &m_name);
+    }
+}
+
+TextureManager::TextureManager() : m_pending(0), m_shared(0), m_decodedBytes(0), m_unpackBuffer(0), m_pool(TEXTURE_DECODE_THREADS)
+{
+}
+
+TextureManager::~TextureManager()
+{
+    // no GL here, the context is gone by the time statics are destroyed (see ReleaseGL)
+    m_pool.Wait();
+}
+
+TextureManager& TextureManager::Instance()
+{
+    static TextureManager manager;
+    return manager;
+}
+
+void TextureManager::decode(Job* job)
+{
+    // nobody holds the texture anymore, skip the work
+    if (!job->texture.expired())
+    {
+        job->bFailed = QoiImage::LoadPngCached(job->path, job->texels, job->width, job->height) != RC_SUCCESS;
+    }
+
+    lock_guard<mutex> lock(m_mutex);
+    m_decodedBytes += job->texels.size();
+    m_decoded.emplace_back(job);
+}
+
+PTexture TextureManager::Acquire(const std::string& path)
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    PTexture texture = m_textures[path].lock();
+    if (texture)
+    {
+        m_shared++;
+        return texture;
+    }
+
+    texture          = make_shared<Texture>();
+    m_textures[path] = texture;
+
+    Job* job     = new Job();
+    job->path    = path;
+    job->texture = texture;
+    job->bFailed = false;
+    job->width   = 0;
+    job->height  = 0;
+    m_pending++;
+    m_pool.Submit([this, job](unsigned) { decode(job); });
+    return texture;
+}
+
+void TextureManager::upload(Texture& texture, const Job& job)
+{
+    GLsizeiptr bytes = (GLsizeiptr)job.texels.size();
+
+    if (m_unpackBuffer == 0)
+    {
+        glGenBuffers(1, &m_unpackBuffer);
+    }
+
+    // Fresh storage each time: the driver may still be reading the previous texture out of the buffer.
+    // Sourced from the bound buffer glTexImage2D returns at once, the transfer runs while the frame is drawn.
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_unpackBuffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+    void* pixels  = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    bool  bMapped = false;
+    if (pixels)
+    {
+        memcpy(pixels, job.texels.data(), bytes);
+        // false when the buffer contents got lost meanwhile, e.g. on a mode switch
+        bMapped = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+    }
+    if (!bMapped)
+    {
+        // the texture must not stay at name 0, take the slower synchronous copy from the texels instead
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &texture.m_name);
+    glBindTexture(GL_TEXTURE_2D, texture.m_name);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, job.width, job.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, bMapped ? nullptr : job.texels.data());
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // complete without mipmaps until generateMipmaps got to it
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    texture.m_width  = job.width;
+    texture.m_height = job.height;
+
+    // glGenerateMipmap right away would wait for the transfer to finish
+    m_mipmaps.push_back({ job.texture, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) });
+}
+
+void TextureManager::generateMipmaps()
+{
+    while (!m_mipmaps.empty())
+    {
+        PendingMipmaps& pending = m_mipmaps.front();
+        if (glClientWaitSync(pending.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            // the later uploads were queued after this one
+            break;
+        }
+        glDeleteSync(pending.fence);
+
+        PTexture texture = pending.texture.lock();
+        if (texture)
+        {
+            glBindTexture(GL_TEXTURE_2D, texture->m_name);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        m_mipmaps.pop_front();
+    }
+}
+
+void TextureManager::ReleaseGL()
+{
+    for (PendingMipmaps& pending : m_mipmaps)
+    {
+        glDeleteSync(pending.fence);
+    }
+    m_mipmaps.clear();
+    if (m_unpackBuffer != 0)
+    {
+        glDeleteBuffers(1, &m_unpackBuffer);
+        m_unpackBuffer = 0;
+    }
+}
+
+void TextureManager::Update(size_t budgetBytes)
+{
+    size_t spent = 0;
+
+    generateMipmaps();
+
+    while (spent < budgetBytes)
+    {
+        unique_ptr<Job> job;
+        {
+            lock_guard<mutex> lock(m_mutex);
+            if (m_decoded.empty())
+            {
+                break;
+            }
+            job = move(m_decoded.front());
+            m_decoded.pop_front();
+        }
+
+        // the last holder may be gone by now; locked here so the texture dies on the render thread
+        PTexture texture = job->texture.lock();
+        if (texture && !job->bFailed)
+        {
+            upload(*texture, *job);
+            spent += job->texels.size();
+        }
+
+        lock_guard<mutex> lock(m_mutex);
+        // a failed path is forgotten, applying it again retries
+        auto it = m_textures.find(job->path);
+        if (job->bFailed && it != m_textures.end() && it->second.lock() == texture)
+        {
+            m_textures.erase(it);
+        }
+        m_decodedBytes -= job->texels.size();
+        m_pending--;
+    }
+}
+
+TEXTURE_STATS TextureManager::GetStats()
+{
+    lock_guard<mutex> lock(m_mutex);
+
+    TEXTURE_STATS stats = TEXTURE_STATS();
+    for (auto it = m_textures.begin(); it != m_textures.end();)
+    {
+        PTexture texture = it->second.lock();
+        if (!texture)
+        {
+            it = m_textures.erase(it);
+            continue;
+        }
+        stats.textures++;
+        stats.gpuBytes += texture->GetGpuBytes();
+        ++it;
+    }
+    stats.pending  = m_pending;
+    stats.shared   = m_shared;
+    stats.cpuBytes = m_decodedBytes;
+    return stats;
+}
@@ -0,0 +1,79 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(unsigned threadCount /*= 0*/) : m_running(0), m_bStopping(false)
+{
+    if (threadCount == 0)
+    {
+        threadCount = thread::hardware_concurrency();
+    }
+    if (threadCount == 0)
+    {
+        threadCount = 1;
+    }
+
+    m_workers.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; i++)
+    {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_bStopping = true;
+    }
+    m_taskReady.notify_all();
+
+    for (thread& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void(unsigned workerIdx)> task)
+{
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_tasks.push_back(move(task));
+    }
+    m_taskReady.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+    unique_lock<mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return m_tasks.empty() && m_running == 0; });
+}
+
+void ThreadPool::workerLoop(unsigned workerIdx)
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_taskReady.wait(lock, [this] { return m_bStopping || !m_tasks.empty(); });
+        if (m_tasks.empty())
+        {
+            // stopping and nothing left to run
+            return;
+        }
+
+        function<void(unsigned)> task = move(m_tasks.front());
+        m_tasks.pop_front();
+        m_running++;
+
+        lock.unlock();
+        task(workerIdx);
+        lock.lock();
+
+        m_running--;
+        if (m_running == 0 && m_tasks.empty())
+        {
+            m_idle.notify_all();
+        }
+    }
+}
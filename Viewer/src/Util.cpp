@@ -1,6 +1,12 @@
 #include "Util.h"
+#include <assert.h>
 #include <limits>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTIL_SSE2
+#endif
+
 using namespace std;
 using namespace glm;
 
@@ -69,6 +75,43 @@ bool Util::isInRange(float x, float min, float max)
     return min <= x && x <= max;
 }
 
+void Util::packRGBA8(const float* r, const float* g, const float* b, unsigned char* rgba, size_t pixelCount)
+{
+    size_t i = 0;
+
+#ifdef UTIL_SSE2
+    const __m128  zero  = _mm_setzero_ps();
+    const __m128  one   = _mm_set1_ps(1.f);
+    const __m128  scale = _mm_set1_ps(255.f);
+    const __m128  half  = _mm_set1_ps(0.5f);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+    // 4 pixels per iteration: clamp, scale and round each plane, then shift the channels into place
+    for (; i + 4 <= pixelCount; i += 4)
+    {
+        __m128 cr = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(r + i), zero), one), scale), half);
+        __m128 cg = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(g + i), zero), one), scale), half);
+        __m128 cb = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(b + i), zero), one), scale), half);
+
+        __m128i packed = _mm_or_si128(_mm_cvttps_epi32(cr), _mm_slli_epi32(_mm_cvttps_epi32(cg), 8));
+        packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvttps_epi32(cb), 16));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i * 4), _mm_or_si128(packed, alpha));
+    }
+#endif
+
+    const float* planes[3] = { r, g, b };
+    for (; i < pixelCount; i++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            float channel = planes[c][i];
+            channel = channel > 0.f ? (channel < 1.f ? channel : 1.f) : 0.f;
+            rgba[i * 4 + c] = static_cast<unsigned char>(channel * 255.f + 0.5f);
+        }
+        rgba[i * 4 + 3] = 255;
+    }
+}
+
 vec4 Util::getColor(R_COLOR color)
 {
     switch (color)
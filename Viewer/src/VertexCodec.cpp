@@ -0,0 +1,66 @@
+#include <math.h>
+#include "VertexCodec.h"
+
+using namespace glm;
+
+static GLshort toSnorm16(float value)
+{
+    return (GLshort)lroundf(MIN(MAX(value, -1.f), 1.f) * VERTEX_SNORM16_MAX);
+}
+
+static float fromSnorm16(GLshort value)
+{
+    return MAX((float)value / VERTEX_SNORM16_MAX, -1.f);
+}
+
+// 1 for +0 as well, the lower half of the octahedron must not fold onto an axis
+static float signNotZero(float value)
+{
+    return (value >= 0.f) ? 1.f : -1.f;
+}
+
+void VertexCodec::EncodePosition(const glm::vec3& position, GLshort encoded[3])
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        encoded[axis] = toSnorm16(position[axis]);
+    }
+}
+
+glm::vec3 VertexCodec::DecodePosition(const GLshort encoded[3])
+{
+    return vec3(fromSnorm16(encoded[0]), fromSnorm16(encoded[1]), fromSnorm16(encoded[2]));
+}
+
+void VertexCodec::EncodeNormal(const glm::vec3& normal, GLshort encoded[2])
+{
+    float l1 = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+    if (!(l1 > 0.f))
+    {
+        encoded[0] = encoded[1] = 0;
+        return;
+    }
+
+    float x = normal.x / l1, y = normal.y / l1;
+    if (normal.z < 0.f)
+    {
+        float foldedX = (1.f - fabsf(y)) * signNotZero(x);
+        float foldedY = (1.f - fabsf(x)) * signNotZero(y);
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[0] = toSnorm16(x);
+    encoded[1] = toSnorm16(y);
+}
+
+glm::vec3 VertexCodec::DecodeNormal(const GLshort encoded[2])
+{
+    float x = fromSnorm16(encoded[0]), y = fromSnorm16(encoded[1]);
+    vec3  normal(x, y, 1.f - fabsf(x) - fabsf(y));
+    if (normal.z < 0.f)
+    {
+        normal.x = (1.f - fabsf(y)) * signNotZero(x);
+        normal.y = (1.f - fabsf(x)) * signNotZero(y);
+    }
+    return normalize(normal);
+}
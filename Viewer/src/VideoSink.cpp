@@ -0,0 +1,353 @@
+#include "VideoSink.h"
+#include <chrono>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <signal.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VIDEO_SSE2
+#endif
+
+using namespace std;
+
+typedef chrono::steady_clock VIDEO_CLOCK;
+
+static inline double secondsSince(VIDEO_CLOCK::time_point start)
+{
+    return chrono::duration<double>(VIDEO_CLOCK::now() - start).count();
+}
+
+// Full range BT.601 in 8 bit fixed point. The SIMD path below computes exactly the same values.
+static inline unsigned char lumaOf(int r, int g, int b)
+{
+    return static_cast<unsigned char>((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+// (t + 128) >> 8 without leaving 16 bits, for the signed chroma sums
+static inline unsigned char chromaOf(int t)
+{
+    return static_cast<unsigned char>(MIN((((t >> 1) + 64) >> 7) + 128, 255));
+}
+
+#ifdef VIDEO_SSE2
+// 8 RGBA8 pixels to 16 bit R, G and B lanes
+static inline void splitRGB(const unsigned char* rgba, __m128i& r, __m128i& g, __m128i& b)
+{
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba));
+    __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + 16));
+
+    r = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+    g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+// The weighted sum stays below 2^16, so the wrapping 16 bit multiplies give the exact luma
+static inline __m128i luma8(__m128i r, __m128i g, __m128i b)
+{
+    __m128i sum = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(77)), _mm_mullo_epi16(g, _mm_set1_epi16(150)));
+    sum = _mm_add_epi16(sum, _mm_mullo_epi16(b, _mm_set1_epi16(29)));
+    return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+}
+
+// Averages of the 2x2 blocks of two rows of 16 pixels (a: pixels 0-7, b: pixels 8-15)
+static inline __m128i average2x2(__m128i a0, __m128i a1, __m128i b0, __m128i b1)
+{
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i pairsA = _mm_madd_epi16(_mm_add_epi16(a0, a1), ones);
+    __m128i pairsB = _mm_madd_epi16(_mm_add_epi16(b0, b1), ones);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(pairsA, pairsB), _mm_set1_epi16(2)), 2);
+}
+
+static inline __m128i chroma8(__m128i r, __m128i g, __m128i b, short cr, short cg, short cb)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(cr)), _mm_mullo_epi16(g, _mm_set1_epi16(cg)));
+    t = _mm_add_epi16(t, _mm_mullo_epi16(b, _mm_set1_epi16(cb)));
+    t = _mm_srai_epi16(_mm_add_epi16(_mm_srai_epi16(t, 1), _mm_set1_epi16(64)), 7);
+    return _mm_add_epi16(t, _mm_set1_epi16(128));
+}
+#endif
+
+void VideoSink::ConvertToI420(const unsigned char* rgba, int width, int height, unsigned char* yPlane, unsigned char* uPlane,
+                              unsigned char* vPlane)
+{
+    int    chromaWidth = (width + 1) / 2;
+    size_t rowBytes    = static_cast<size_t>(width) * 4;
+
+    for (int cy = 0; cy < (height + 1) / 2; cy++)
+    {
+        // output rows are top-down, the source rows bottom-up; an odd last row pairs with itself
+        int                  y0    = cy * 2;
+        int                  y1    = MIN(y0 + 1, height - 1);
+        const unsigned char* src0  = rgba + (height - 1 - y0) * rowBytes;
+        const unsigned char* src1  = rgba + (height - 1 - y1) * rowBytes;
+        unsigned char*       luma0 = yPlane + static_cast<size_t>(y0) * width;
+        unsigned char*       luma1 = yPlane + static_cast<size_t>(y1) * width;
+        unsigned char*       u     = uPlane + static_cast<size_t>(cy) * chromaWidth;
+        unsigned char*       v     = vPlane + static_cast<size_t>(cy) * chromaWidth;
+        int                  x     = 0;
+
+#ifdef VIDEO_SSE2
+        for (; x + 16 <= width; x += 16)
+        {
+            __m128i rA0, gA0, bA0, rB0, gB0, bB0, rA1, gA1, bA1, rB1, gB1, bB1;
+            splitRGB(src0 + x * 4,      rA0, gA0, bA0);
+            splitRGB(src0 + x * 4 + 32, rB0, gB0, bB0);
+            splitRGB(src1 + x * 4,      rA1, gA1, bA1);
+            splitRGB(src1 + x * 4 + 32, rB1, gB1, bB1);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(luma0 + x), _mm_packus_epi16(luma8(rA0, gA0, bA0), luma8(rB0, gB0, bB0)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(luma1 + x), _mm_packus_epi16(luma8(rA1, gA1, bA1), luma8(rB1, gB1, bB1)));
+
+            __m128i r = average2x2(rA0, rA1, rB0, rB1);
+            __m128i g = average2x2(gA0, gA1, gB0, gB1);
+            __m128i b = average2x2(bA0, bA1, bB0, bB1);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(u + x / 2), _mm_packus_epi16(chroma8(r, g, b, -43, -85, 128), _mm_setzero_si128()));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(v + x / 2), _mm_packus_epi16(chroma8(r, g, b, 128, -107, -21), _mm_setzero_si128()));
+        }
+#endif
+
+        for (; x < width; x += 2)
+        {
+            // an odd last column pairs with itself as well
+            int x1 = MIN(x + 1, width - 1);
+            const unsigned char* p00 = src0 + x * 4;
+            const unsigned char* p01 = src0 + x1 * 4;
+            const unsigned char* p10 = src1 + x * 4;
+            const unsigned char* p11 = src1 + x1 * 4;
+
+            luma0[x]  = lumaOf(p00[0], p00[1], p00[2]);
+            luma0[x1] = lumaOf(p01[0], p01[1], p01[2]);
+            luma1[x]  = lumaOf(p10[0], p10[1], p10[2]);
+            luma1[x1] = lumaOf(p11[0], p11[1], p11[2]);
+
+            int r = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+            int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+            int b = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+            u[x / 2] = chromaOf(-43 * r - 85 * g + 128 * b);
+            v[x / 2] = chromaOf(128 * r - 107 * g - 21 * b);
+        }
+    }
+}
+
+void VideoSink::ConvertToRGB24(const unsigned char* rgba, int width, int height, unsigned char* rgb)
+{
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+
+    for (int y = 0; y < height; y++)
+    {
+        const unsigned char* src = rgba + (height - 1 - y) * rowBytes;
+        unsigned char*       dst = rgb + static_cast<size_t>(y) * width * 3;
+        for (int x = 0; x < width; x++, src += 4, dst += 3)
+        {
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+    }
+}
+
+VideoSink::VideoSink() : m_file(nullptr), m_bOwnsFile(false), m_format(VF_Y4M), m_width(0), m_height(0), m_frameBytes(0), m_stats(),
+                         m_bClosing(false), m_bWriteFailed(false)
+{
+}
+
+VideoSink::~VideoSink()
+{
+    Close();
+}
+
+RETURN_CODE VideoSink::Open(const std::string& path, VIDEO_FORMAT format, int width, int height, unsigned fps)
+{
+    Close();
+
+    // Y4M stores the rate as F<fps>:1, a zero rate is not a video
+    if (fps == 0 || width <= 0 || height <= 0)
+    {
+        fprintf(stderr, "Invalid video parameters %dx%d at %u fps\n", width, height, fps);
+        return RC_INVALID_PARAM;
+    }
+
+    if (path == "-")
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        m_file      = stdout;
+        m_bOwnsFile = false;
+    }
+    else
+    {
+        m_file      = fopen(path.c_str(), "wb");
+        m_bOwnsFile = true;
+        if (m_file == nullptr)
+        {
+            fprintf(stderr, "Opening %s failed\n", path.c_str());
+            return RC_IO_ERROR;
+        }
+    }
+
+#ifndef _WIN32
+    // a reader closing the pipe early (e.g. ffmpeg failing) would kill the process with SIGPIPE,
+    // ignoring it turns that into a write error the render loop sees
+    struct stat fileStat;
+    if (fstat(fileno(m_file), &fileStat) == 0 && S_ISFIFO(fileStat.st_mode))
+    {
+        signal(SIGPIPE, SIG_IGN);
+    }
+#endif
+
+    m_format = format;
+    m_width  = width;
+    m_height = height;
+    m_stats  = VIDEO_SINK_STATS();
+
+    if (format == VF_Y4M)
+    {
+        size_t chromaBytes = static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+        // every buffer starts with the frame marker, a frame is a single write
+        m_frameBytes = strlen("FRAME\n") + static_cast<size_t>(width) * height + chromaBytes * 2;
+        fprintf(m_file, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg\n", width, height, fps);
+    }
+    else
+    {
+        m_frameBytes = static_cast<size_t>(width) * height * 3;
+    }
+
+    m_buffers.clear();
+    m_free.clear();
+    m_queue.clear();
+    for (size_t i = 0; i < VIDEO_SINK_BUFFERS; i++)
+    {
+        m_buffers.emplace_back(new vector<unsigned char>(m_frameBytes));
+        m_free.push_back(i);
+    }
+
+    m_bClosing     = false;
+    m_bWriteFailed = false;
+    m_writer       = thread(&VideoSink::writerLoop, this);
+    return RC_SUCCESS;
+}
+
+RETURN_CODE VideoSink::WriteFrame(const unsigned char* rgba)
+{
+    if (m_file == nullptr)
+    {
+        return RC_FAILURE;
+    }
+
+    unique_lock<mutex> lock(m_mutex);
+    if (m_free.empty() && m_buffers.size() < VIDEO_SINK_MAX_BUFFERS)
+    {
+        // the writer lags behind, buffer more frames rather than waiting for it
+        m_buffers.emplace_back(new vector<unsigned char>(m_frameBytes));
+        m_free.push_back(m_buffers.size() - 1);
+    }
+    if (m_free.empty())
+    {
+        VIDEO_CLOCK::time_point start = VIDEO_CLOCK::now();
+        m_bufferFree.wait(lock, [this] { return !m_free.empty() || m_bWriteFailed; });
+        m_stats.stallSeconds += secondsSince(start);
+    }
+    if (m_bWriteFailed)
+    {
+        return RC_IO_ERROR;
+    }
+
+    size_t         bufferIdx = m_free.back();
+    unsigned char* data      = m_buffers[bufferIdx]->data();
+    m_free.pop_back();
+    lock.unlock();
+
+    VIDEO_CLOCK::time_point start = VIDEO_CLOCK::now();
+    if (m_format == VF_Y4M)
+    {
+        size_t lumaBytes   = static_cast<size_t>(m_width) * m_height;
+        size_t chromaBytes = static_cast<size_t>((m_width + 1) / 2) * ((m_height + 1) / 2);
+        memcpy(data, "FRAME\n", strlen("FRAME\n"));
+        data += strlen("FRAME\n");
+        ConvertToI420(rgba, m_width, m_height, data, data + lumaBytes, data + lumaBytes + chromaBytes);
+    }
+    else
+    {
+        ConvertToRGB24(rgba, m_width, m_height, data);
+    }
+    double convertSeconds = secondsSince(start);
+
+    lock.lock();
+    m_stats.convertSeconds += convertSeconds;
+    m_stats.frames++;
+    m_stats.bytes += m_frameBytes;
+    m_queue.push_back(bufferIdx);
+    lock.unlock();
+    m_frameQueued.notify_one();
+
+    return RC_SUCCESS;
+}
+
+RETURN_CODE VideoSink::Close()
+{
+    if (m_file == nullptr)
+    {
+        return RC_SUCCESS;
+    }
+
+    {
+        lock_guard<mutex> lock(m_mutex);
+        m_bClosing = true;
+    }
+    m_frameQueued.notify_one();
+    m_writer.join();
+
+    bool bFailed = m_bWriteFailed || fflush(m_file) != 0;
+    if (m_bOwnsFile && fclose(m_file) != 0)
+    {
+        bFailed = true;
+    }
+    m_file          = nullptr;
+    m_stats.buffers = (unsigned)m_buffers.size();
+    m_buffers.clear();
+
+    return bFailed ? RC_IO_ERROR : RC_SUCCESS;
+}
+
+void VideoSink::writerLoop()
+{
+    unique_lock<mutex> lock(m_mutex);
+
+    while (true)
+    {
+        m_frameQueued.wait(lock, [this] { return m_bClosing || !m_queue.empty(); });
+        if (m_queue.empty())
+        {
+            // closing and everything written
+            return;
+        }
+
+        size_t               bufferIdx = m_queue.front();
+        const unsigned char* data      = m_buffers[bufferIdx]->data();
+        m_queue.pop_front();
+        lock.unlock();
+
+        VIDEO_CLOCK::time_point start = VIDEO_CLOCK::now();
+        bool bWritten = m_bWriteFailed || fwrite(data, 1, m_frameBytes, m_file) == m_frameBytes;
+        double writeSeconds = secondsSince(start);
+
+        lock.lock();
+        m_stats.writeSeconds += writeSeconds;
+        if (!bWritten)
+        {
+            // e.g. the encoder at the other end of the pipe went away
+            m_bWriteFailed = true;
+        }
+        m_free.push_back(bufferIdx);
+        m_bufferFree.notify_one();
+    }
+}
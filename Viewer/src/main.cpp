@@ -75,6 +75,8 @@ int main(int argc, char **argv)
 		RenderFrame(window);// --> go to line 137
     }
     glUseProgram(0);
+    // the texture manager is a static and outlives the context
+    TextureManager::Instance().ReleaseGL();
     // Cleanup
 	Cleanup(window);
     return RC_SUCCESS;